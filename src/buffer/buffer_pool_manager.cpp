@@ -14,6 +14,9 @@
 
 #include <list>
 #include <unordered_map>
+#include <vector>
+
+#include "recovery/log_recovery.h"
 
 namespace bustub {
 
@@ -42,83 +45,72 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
   // 2.     If R is dirty, write it back to the disk.
   // 3.     Delete R from the page table and insert P.
   // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
-
-  //1.
-  std::unordered_map<page_id_t,frame_id_t>::iterator it = page_table_.find(page_id);
-  Page *page = nullptr;
-  if (free_list_.empty() && replacer_->Size() == 0)
-  {
-    return nullptr;
-  }
-  if (it != page_table_.end())
-  {
-    //1.1
-    
-    page = &pages_[page_id];
-    page->pin_count_ ++;
-    replacer_->Pin(page_id);
-    return page;
-  }
-
-  return getPage(page_id, false);
-}
-
-Page* BufferPoolManager::getPage(page_id_t page_id, bool new_page)
-{
-
-  Page *page = nullptr;
-  Page *R = nullptr;
-
-  //1.2
-  page_id_t id;
-  if (free_list_.size() > 0){
-    id = *(free_list_.begin());
-    free_list_.pop_front();
-    if (!new_page) disk_manager_->ReadPage(page_id, page->data_);  
-  }
-  else if (replacer_->Size() != 0){
-    bool ans = replacer_->Victim(&id);
-    assert (ans);
+  std::unique_lock<std::mutex> lock(latch_);
+  auto it = page_table_.find(page_id);
+  if (it == page_table_.end()) {
+    frame_id_t frame_id;
+    if (!FindVictimFrame(&frame_id, &lock)) {
+      return nullptr;
+    }
+    // Finding a victim may wait for the log without the latch, while another thread reads the page in.
+    it = page_table_.find(page_id);
+    if (it == page_table_.end()) {
+      Page *page = &pages_[frame_id];
+      page_table_[page_id] = frame_id;
+      page->page_id_ = page_id;
+      page->pin_count_ = 1;
+      page->is_dirty_ = false;
+      page->rec_lsn_ = CurrentRecLSN();
+      disk_manager_->ReadPage(page_id, page->data_);
+      if (redo_on_demand_ != nullptr) {
+        lsn_t first_lsn = redo_on_demand_->RedoPage(page);
+        if (first_lsn != INVALID_LSN) {
+          // The redone changes are only in memory, and as old as the first record applied.
+          page->is_dirty_ = true;
+          page->rec_lsn_ = first_lsn;
+        }
+      }
+      return page;
+    }
+    free_list_.push_back(frame_id);
   }
-  R = &pages_[id];
 
-  if (R->IsDirty()){
-    disk_manager_->WritePage(id,R->data_);
+  Page *page = &pages_[it->second];
+  if (page->pin_count_++ == 0 && !page->is_dirty_) {
+    page->rec_lsn_ = CurrentRecLSN();
   }
-  
-  //3
-  if (page_table_.find(id) != page_table_.end())page_table_.erase(id);
-  page_table_.insert(std::make_pair(page_id , id));
-
-
-  page = &pages_[page_id];
-
-  //disk_manager_->ReadPage(page_id, page->data_);
-  page->page_id_ = page_id;
-  page->pin_count_ = 1;
-
+  replacer_->Pin(it->second);
   return page;
 }
 
-bool BufferPoolManager::UnpinPageImpl(page_id_t page_id, bool is_dirty) { 
-  Page* p = &pages_[page_id];
-  if (p->pin_count_ <= 0) return false;
-
+bool BufferPoolManager::UnpinPageImpl(page_id_t page_id, bool is_dirty) {
+  std::lock_guard<std::mutex> guard(latch_);
   auto it = page_table_.find(page_id);
-  replacer_->Unpin(it->second);
-
+  if (it == page_table_.end()) {
+    return false;
+  }
+  Page *page = &pages_[it->second];
+  if (page->pin_count_ <= 0) {
+    return false;
+  }
+  page->is_dirty_ |= is_dirty;
+  if (--page->pin_count_ == 0) {
+    replacer_->Unpin(it->second);
+  }
   return true;
 }
 
 bool BufferPoolManager::FlushPageImpl(page_id_t page_id) {
   // Make sure you call DiskManager::WritePage!
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  std::unique_lock<std::mutex> lock(latch_);
   auto it = page_table_.find(page_id);
-  if (page_id == INVALID_PAGE_ID) return false;
-  if (it == page_table_.end()) return false;
-
-  Page* page_ = &pages_[page_id];
-  disk_manager_->WritePage(page_id, page_->GetData());
-
+  if (it == page_table_.end()) {
+    return false;
+  }
+  FlushFrame(it->second, &lock);
   return true;
 }
 
@@ -128,19 +120,20 @@ Page *BufferPoolManager::NewPageImpl(page_id_t *page_id) {
   // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
   // 3.   Update P's metadata, zero out memory and add P to the page table.
   // 4.   Set the page ID output parameter. Return a pointer to P.
-
-  page_id_t pid = disk_manager_->AllocatePage();
-
-
-  if (free_list_.empty() && (replacer_->Size() == 0))
-  {
+  std::unique_lock<std::mutex> lock(latch_);
+  frame_id_t frame_id;
+  if (!FindVictimFrame(&frame_id, &lock)) {
     *page_id = INVALID_PAGE_ID;
     return nullptr;
   }
-
-  *page_id = pid;
-  Page* page = getPage(pid, true);
-
+  *page_id = disk_manager_->AllocatePage();
+  Page *page = &pages_[frame_id];
+  page_table_[*page_id] = frame_id;
+  page->page_id_ = *page_id;
+  page->pin_count_ = 1;
+  page->is_dirty_ = false;
+  page->rec_lsn_ = CurrentRecLSN();
+  page->ResetMemory();
   return page;
 }
 
@@ -150,27 +143,170 @@ bool BufferPoolManager::DeletePageImpl(page_id_t page_id) {
   // 1.   If P does not exist, return true.
   // 2.   If P exists, but has a non-zero pin-count, return false. Someone is using the page.
   // 3.   Otherwise, P can be deleted. Remove P from the page table, reset its metadata and return it to the free list.
+  std::lock_guard<std::mutex> guard(latch_);
+  auto it = page_table_.find(page_id);
+  if (it == page_table_.end()) {
+    disk_manager_->DeallocatePage(page_id);
+    return true;
+  }
+  frame_id_t frame_id = it->second;
+  Page *page = &pages_[frame_id];
+  if (page->pin_count_ != 0) {
+    return false;
+  }
   disk_manager_->DeallocatePage(page_id);
-  if (page_table_.find(page_id) == page_table_.end()) return false;
-  Page* p = &pages_[page_id];
+  page_table_.erase(it);
+  replacer_->Pin(frame_id);
+  page->page_id_ = INVALID_PAGE_ID;
+  page->is_dirty_ = false;
+  page->ResetMemory();
+  free_list_.emplace_back(frame_id);
+  return true;
+}
+
+void BufferPoolManager::FlushAllPagesImpl() {
+  std::unique_lock<std::mutex> lock(latch_);
+  // The latch is released while each page is written, so the page table may change in between.
+  std::vector<page_id_t> page_ids;
+  for (auto &entry : page_table_) {
+    page_ids.push_back(entry.first);
+  }
+  for (page_id_t page_id : page_ids) {
+    auto it = page_table_.find(page_id);
+    if (it != page_table_.end()) {
+      FlushFrame(it->second, &lock);
+    }
+  }
+}
+
+void BufferPoolManager::FlushFrame(frame_id_t frame_id, std::unique_lock<std::mutex> *lock) {
+  Page *page = &pages_[frame_id];
+  // Pin the page so that it stays in its frame while the latch is released. Writers latch the page before they call
+  // into the buffer pool, so its latch has to be taken without ours.
+  page->pin_count_++;
+  replacer_->Pin(frame_id);
+  lock->unlock();
+  page->WLatch();
+  // With the page latched nobody can log another change to it, so the log can be forced without our latch.
+  bool forced = false;
+  if (enable_logging && log_manager_ != nullptr) {
+    lsn_t lsn = PublishPageLog(page);
+    forced = lsn > log_manager_->GetPersistentLSN();
+    if (forced) {
+      log_manager_->Flush(lsn);
+    }
+  }
+  lock->lock();
+  stats_.wal_forced_flushes_ += forced ? 1 : 0;
+  WritePageBack(page);
+  page->WUnlatch();
+  if (--page->pin_count_ == 0) {
+    replacer_->Unpin(frame_id);
+  }
+}
+
+bool BufferPoolManager::FindVictimFrame(frame_id_t *frame_id, std::unique_lock<std::mutex> *lock) {
+  if (!free_list_.empty()) {
+    *frame_id = free_list_.front();
+    free_list_.pop_front();
+    return true;
+  }
+  while (true) {
+    // Prefer a victim that can be written back without forcing the log under the latch.
+    bool passed_over = false;
+    bool found = replacer_->PreferredVictim(frame_id, [&](frame_id_t candidate) {
+      bool durable = !NeedsLogFlush(&pages_[candidate]);
+      passed_over = passed_over || !durable;
+      return durable;
+    });
+    if (passed_over) {
+      // Have the log of the frames passed over written in the background, so that they are ready next time.
+      log_manager_->RequestFlush();
+      stats_.async_flush_requests_++;
+    }
+    if (found) {
+      break;
+    }
+    if (!replacer_->Victim(frame_id)) {
+      return false;
+    }
+    // Every candidate waits for the log. Put this one back and wait for its log without holding the latch.
+    Page *victim = &pages_[*frame_id];
+    replacer_->Unpin(*frame_id);
+    lsn_t lsn = PublishPageLog(victim);
+    stats_.wal_forced_flushes_++;
+    lock->unlock();
+    log_manager_->Flush(lsn);
+    lock->lock();
+  }
+  Page *victim = &pages_[*frame_id];
+  stats_.evictions_++;
+  if (victim->IsDirty()) {
+    stats_.dirty_evictions_++;
+    WritePageBack(victim);
+  }
+  page_table_.erase(victim->page_id_);
+  return true;
+}
+
+bool BufferPoolManager::NeedsLogFlush(Page *page) {
+  return page->is_dirty_ && enable_logging && log_manager_ != nullptr &&
+         !log_manager_->IsPageLogDurable(page->page_id_, page->GetLSN());
+}
 
-  if (p->pin_count_ != 0) return false;
-  page_table_.erase(page_id);
-  p->pin_count_ = 0;
-  p->page_id_ = INVALID_PAGE_ID;
+lsn_t BufferPoolManager::PublishPageLog(Page *page) {
+  // Write-ahead rule: every record describing this page must be durable first, including the ones still sitting
+  // in the private log buffers of running transactions, which do not show up in the page LSN.
+  lsn_t lsn = log_manager_->PublishPageWriters(page->page_id_);
+  if (lsn > page->GetLSN()) {
+    // Those records are reflected in the page, so its LSN can cover them and redo can keep comparing LSNs.
+    page->SetLSN(lsn);
+  }
+  return page->GetLSN();
+}
 
-  free_list_.emplace_back(page_id);
+void BufferPoolManager::WritePageBack(Page *page) {
+  if (enable_logging && log_manager_ != nullptr) {
+    // The records of the page are durable by now, but its writers may have logged more to other pages since, which
+    // the LSN just published covers too. The page must not claim an LSN that is not on disk.
+    lsn_t persistent_lsn = log_manager_->GetPersistentLSN();
+    if (PublishPageLog(page) > persistent_lsn) {
+      page->SetLSN(persistent_lsn);
+    }
+  }
+  disk_manager_->WritePage(page->page_id_, page->GetData());
+  page->is_dirty_ = false;
+  page->rec_lsn_ = CurrentRecLSN();
+}
 
-  return false;
+lsn_t BufferPoolManager::CurrentRecLSN() {
+  // The next LSN can run ahead while an appender waits for a full buffer, the persistent LSN never does.
+  return log_manager_ != nullptr ? log_manager_->GetPersistentLSN() + 1 : INVALID_LSN;
 }
 
-void BufferPoolManager::FlushAllPagesImpl() {
-  // You can do it!
-  for(size_t i = 0 ; i < pool_size_; i++)
-  {
-    FlushPageImpl(i);
+std::vector<DirtyPageEntry> BufferPoolManager::GetDirtyPageTable() {
+  std::lock_guard<std::mutex> guard(latch_);
+  std::vector<DirtyPageEntry> dirty_pages;
+  for (auto &entry : page_table_) {
+    Page *page = &pages_[entry.second];
+    if (page->is_dirty_ || page->pin_count_ > 0) {
+      dirty_pages.emplace_back(entry.first, page->rec_lsn_);
+    }
   }
+  if (redo_on_demand_ != nullptr) {
+    redo_on_demand_->GetPendingPages(&dirty_pages);
+  }
+  return dirty_pages;
+}
+
+BufferPoolStats BufferPoolManager::GetStats() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return stats_;
+}
 
+void BufferPoolManager::SetRedoOnDemand(LogRecovery *log_recovery) {
+  std::lock_guard<std::mutex> guard(latch_);
+  redo_on_demand_ = log_recovery;
 }
 
 }  // namespace bustub
@@ -14,42 +14,68 @@
 
 namespace bustub {
 
-ClockReplacer::ClockReplacer(size_t num_pages) {
-
-    clock = new Clock(num_pages);
-}
+ClockReplacer::ClockReplacer(size_t num_pages) : slots_(num_pages) {}
 
 ClockReplacer::~ClockReplacer() = default;
 
-bool ClockReplacer::Victim(frame_id_t *frame_id) { 
-    m.lock();
-    clock->findVictim(frame_id);
-    //clock->remove(*frame_id);
-    m.unlock();
+bool ClockReplacer::Victim(frame_id_t *frame_id) {
+  return PreferredVictim(frame_id, [](frame_id_t) { return true; });
+}
+
+bool ClockReplacer::PreferredVictim(frame_id_t *frame_id, const std::function<bool(frame_id_t)> &prefer) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (size_ == 0) {
+    return false;
+  }
+  // The first sweep clears every reference bit, so every frame in the replacer is offered within two sweeps.
+  for (size_t step = 0; step < 2 * slots_.size(); step++) {
+    ClockSlot &slot = slots_[hand_];
+    auto current = static_cast<frame_id_t>(hand_);
+    hand_ = (hand_ + 1) % slots_.size();
+    if (!slot.in_replacer_) {
+      continue;
+    }
+    if (slot.ref_) {
+      slot.ref_ = false;
+      continue;
+    }
+    // A frame passed over keeps its cleared reference bit, so it comes first once it is acceptable.
+    if (!prefer(current)) {
+      continue;
+    }
+    slot.in_replacer_ = false;
+    size_--;
+    *frame_id = current;
     return true;
+  }
+  return false;
 }
 
 void ClockReplacer::Pin(frame_id_t frame_id) {
-    m.lock();
-    if (clock->already_present(frame_id, 0))clock->remove(frame_id);
-    m.unlock();
+  std::lock_guard<std::mutex> guard(latch_);
+  auto index = static_cast<size_t>(frame_id);
+  if (index < slots_.size() && slots_[index].in_replacer_) {
+    slots_[index].in_replacer_ = false;
+    size_--;
+  }
 }
 
 void ClockReplacer::Unpin(frame_id_t frame_id) {
-    
-    m.lock();
-    if(!clock->already_present(frame_id,1))
-    {clock->add(frame_id);
-    }
-    m.unlock();
-    
+  std::lock_guard<std::mutex> guard(latch_);
+  auto index = static_cast<size_t>(frame_id);
+  if (index >= slots_.size()) {
+    slots_.resize(index + 1);
+  }
+  if (!slots_[index].in_replacer_) {
+    slots_[index].in_replacer_ = true;
+    size_++;
+  }
+  slots_[index].ref_ = true;
 }
 
 size_t ClockReplacer::Size() {
-    m.lock(); 
-    size_t size_= clock->size();
-    m.unlock();
-    return size_;
-}  // namespace bustub
-
+  std::lock_guard<std::mutex> guard(latch_);
+  return size_;
 }
+
+}  // namespace bustub
@@ -16,8 +16,20 @@ namespace bustub {
 
 std::atomic<bool> enable_logging(false);
 
-std::chrono::duration<int64_t> log_timeout = std::chrono::seconds(1);
+std::chrono::milliseconds log_timeout = std::chrono::seconds(1);
 
-std::chrono::milliseconds cycle_detection_interval = std::chrono::milliseconds(50);
+std::atomic<bool> enable_async_commit(false);
+
+std::atomic<bool> enable_private_log(true);
+
+std::atomic<bool> enable_delta_update(true);
+
+std::atomic<bool> enable_log_compression(false);
+
+std::atomic<int> redo_threads(1);
+
+std::chrono::milliseconds cycle_detection_interval = std::chrono::milliseconds(10);
+
+std::atomic<size_t> lock_escalation_threshold(5000);
 
 }  // namespace bustub
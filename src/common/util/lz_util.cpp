@@ -0,0 +1,162 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lz_util.cpp
+//
+// Identification: src/common/util/lz_util.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/util/lz_util.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bustub {
+
+namespace {
+
+inline uint32_t Read32(const char *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(uint32_t));
+  return value;
+}
+
+/** Writes the bytes that continue a length nibble of 15. Returns false if they do not fit. */
+inline bool WriteLength(uint32_t length, char *dst, uint32_t capacity, uint32_t *op) {
+  for (; length >= UINT8_MAX; length -= UINT8_MAX) {
+    if (*op >= capacity) {
+      return false;
+    }
+    dst[(*op)++] = static_cast<char>(UINT8_MAX);
+  }
+  if (*op >= capacity) {
+    return false;
+  }
+  dst[(*op)++] = static_cast<char>(length);
+  return true;
+}
+
+/** Reads the bytes that continue a length nibble of 15. Returns false on a truncated block. */
+inline bool ReadLength(const uint8_t *src, uint32_t size, uint32_t *ip, uint32_t *length) {
+  uint8_t byte;
+  do {
+    if (*ip >= size) {
+      return false;
+    }
+    byte = src[(*ip)++];
+    *length += byte;
+  } while (byte == UINT8_MAX);
+  return true;
+}
+
+/** Writes one sequence; match_length is 0 for the trailing literals. Returns false if it does not fit. */
+inline bool WriteSequence(const char *literals, uint32_t literal_length, uint32_t offset, uint32_t match_length,
+                          char *dst, uint32_t capacity, uint32_t *op) {
+  uint32_t match_code = match_length == 0 ? 0 : match_length - 4;
+  if (*op >= capacity) {
+    return false;
+  }
+  dst[(*op)++] = static_cast<char>((std::min<uint32_t>(literal_length, 15) << 4) | std::min<uint32_t>(match_code, 15));
+  if (literal_length >= 15 && !WriteLength(literal_length - 15, dst, capacity, op)) {
+    return false;
+  }
+  if (*op + literal_length > capacity) {
+    return false;
+  }
+  memcpy(dst + *op, literals, literal_length);
+  *op += literal_length;
+  if (match_length == 0) {
+    return true;
+  }
+  if (*op + sizeof(uint16_t) > capacity) {
+    return false;
+  }
+  dst[(*op)++] = static_cast<char>(offset & 0xff);
+  dst[(*op)++] = static_cast<char>(offset >> 8);
+  return match_code < 15 || WriteLength(match_code - 15, dst, capacity, op);
+}
+
+}  // namespace
+
+uint32_t LZUtil::Compress(const char *src, uint32_t size, char *dst, uint32_t capacity) {
+  // Positions of the last occurrence of each hashed 4-byte sequence. Stale entries are caught by the comparison.
+  uint32_t table[1 << HASH_BITS] = {};
+  uint32_t ip = 0;
+  uint32_t anchor = 0;
+  uint32_t op = 0;
+
+  while (ip + MIN_MATCH <= size) {
+    uint32_t sequence = Read32(src + ip);
+    uint32_t hash = (sequence * 2654435761U) >> (32 - HASH_BITS);
+    uint32_t candidate = table[hash];
+    table[hash] = ip;
+    if (candidate >= ip || ip - candidate > MAX_OFFSET || Read32(src + candidate) != sequence) {
+      ip++;
+      continue;
+    }
+
+    uint32_t match_length = MIN_MATCH;
+    while (ip + match_length < size && src[candidate + match_length] == src[ip + match_length]) {
+      match_length++;
+    }
+    if (!WriteSequence(src + anchor, ip - anchor, ip - candidate, match_length, dst, capacity, &op)) {
+      return 0;
+    }
+    ip += match_length;
+    anchor = ip;
+  }
+
+  if (!WriteSequence(src + anchor, size - anchor, 0, 0, dst, capacity, &op)) {
+    return 0;
+  }
+  return op;
+}
+
+bool LZUtil::Decompress(const char *src, uint32_t size, char *dst, uint32_t dst_size) {
+  auto *in = reinterpret_cast<const uint8_t *>(src);
+  uint32_t ip = 0;
+  uint32_t op = 0;
+
+  // A well-formed block always ends with a literals-only sequence, which catches truncation right after a match.
+  while (ip < size) {
+    uint8_t token = in[ip++];
+    uint32_t literal_length = token >> 4;
+    if (literal_length == 15 && !ReadLength(in, size, &ip, &literal_length)) {
+      return false;
+    }
+    if (ip + literal_length > size || op + literal_length > dst_size) {
+      return false;
+    }
+    memcpy(dst + op, src + ip, literal_length);
+    ip += literal_length;
+    op += literal_length;
+    if (ip == size) {
+      return op == dst_size;
+    }
+
+    if (ip + sizeof(uint16_t) > size) {
+      return false;
+    }
+    uint32_t offset = in[ip] | (in[ip + 1] << 8);
+    ip += sizeof(uint16_t);
+    uint32_t match_length = token & 0xf;
+    if (match_length == 15 && !ReadLength(in, size, &ip, &match_length)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > op || op + match_length > dst_size) {
+      return false;
+    }
+    // The match may overlap the bytes it produces, so copy forward one byte at a time.
+    for (uint32_t i = 0; i < match_length; i++, op++) {
+      dst[op] = dst[op - offset];
+    }
+  }
+  return false;
+}
+
+}  // namespace bustub
@@ -12,57 +12,621 @@
 
 #include "concurrency/lock_manager.h"
 
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 namespace bustub {
 
-bool LockManager::LockShared(Transaction *txn, const RID &rid) {
-  txn->GetSharedLockSet()->emplace(rid);
+bool LockManager::LockShared(Transaction *txn, const RID &rid, page_id_t table_id) {
+  {
+    LockTablePartition &partition = GetPartition(rid);
+    std::unique_lock<std::mutex> lock(partition.latch_);
+    if (!CanLock(txn, LockMode::SHARED) ||
+        !Acquire(txn, &partition, &partition.lock_table_[rid], LockMode::SHARED, &lock)) {
+      return false;
+    }
+    txn->GetSharedLockSet()->emplace(rid);
+  }
+  AddRowLock(txn, rid, table_id);
   return true;
 }
 
-bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
-  txn->GetExclusiveLockSet()->emplace(rid);
+bool LockManager::LockExclusive(Transaction *txn, const RID &rid, page_id_t table_id) {
+  {
+    LockTablePartition &partition = GetPartition(rid);
+    std::unique_lock<std::mutex> lock(partition.latch_);
+    if (!CanLock(txn, LockMode::EXCLUSIVE) ||
+        !Acquire(txn, &partition, &partition.lock_table_[rid], LockMode::EXCLUSIVE, &lock)) {
+      return false;
+    }
+    txn->GetExclusiveLockSet()->emplace(rid);
+  }
+  AddRowLock(txn, rid, table_id);
   return true;
 }
 
 bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
+  LockTablePartition &partition = GetPartition(rid);
+  std::unique_lock<std::mutex> lock(partition.latch_);
+  if (!CanLock(txn, LockMode::EXCLUSIVE) ||
+      !Upgrade(txn, &partition, &partition.lock_table_[rid], LockMode::EXCLUSIVE, &lock)) {
+    return false;
+  }
   txn->GetSharedLockSet()->erase(rid);
   txn->GetExclusiveLockSet()->emplace(rid);
   return true;
 }
 
 bool LockManager::Unlock(Transaction *txn, const RID &rid) {
-  txn->GetSharedLockSet()->erase(rid);
-  txn->GetExclusiveLockSet()->erase(rid);
+  LockTablePartition &partition = GetPartition(rid);
+  std::unique_lock<std::mutex> lock(partition.latch_);
+  size_t shared = txn->GetSharedLockSet()->erase(rid);
+  size_t exclusive = txn->GetExclusiveLockSet()->erase(rid);
+  auto it = partition.lock_table_.find(rid);
+  if (shared + exclusive == 0 || it == partition.lock_table_.end()) {
+    return false;
+  }
+  if (Release(&it->second, txn->GetTransactionId())) {
+    partition.lock_table_.erase(it);
+  }
+  if (exclusive != 0 || txn->GetIsolationLevel() != IsolationLevel::READ_COMMITTED) {
+    Shrink(txn);
+  }
+  return true;
+}
+
+bool LockManager::LockTable(Transaction *txn, LockMode lock_mode, page_id_t table_id) {
+  auto table_lock_set = txn->GetTableLockSet();
+  LockTablePartition &partition = GetTablePartition(table_id);
+  std::unique_lock<std::mutex> lock(partition.latch_);
+  auto held = table_lock_set->find(table_id);
+  if (held != table_lock_set->end() && Covers(held->second, lock_mode)) {
+    return true;
+  }
+  if (!CanLock(txn, lock_mode)) {
+    return false;
+  }
+  LockRequestQueue *queue = &partition.table_lock_table_[table_id];
+  if (held == table_lock_set->end()) {
+    if (!Acquire(txn, &partition, queue, lock_mode, &lock)) {
+      return false;
+    }
+    table_lock_set->emplace(table_id, lock_mode);
+    return true;
+  }
+  LockMode upgraded = Combine(held->second, lock_mode);
+  if (!Upgrade(txn, &partition, queue, upgraded, &lock)) {
+    return false;
+  }
+  held->second = upgraded;
+  return true;
+}
+
+bool LockManager::UnlockTable(Transaction *txn, page_id_t table_id) {
+  LockTablePartition &partition = GetTablePartition(table_id);
+  std::unique_lock<std::mutex> lock(partition.latch_);
+  auto it = partition.table_lock_table_.find(table_id);
+  if (txn->GetTableLockSet()->erase(table_id) == 0 || it == partition.table_lock_table_.end()) {
+    return false;
+  }
+  txn->GetTableRowLockSet()->erase(table_id);
+  if (Release(&it->second, txn->GetTransactionId())) {
+    partition.table_lock_table_.erase(it);
+  }
+  Shrink(txn);
+  return true;
+}
+
+LockMode LockManager::Combine(LockMode a, LockMode b) {
+  if (a == b) {
+    return a;
+  }
+  // The modes form a lattice: IS below S and IX, both below SIX, which is below X.
+  auto rank = [](LockMode mode) {
+    switch (mode) {
+      case LockMode::INTENTION_SHARED:
+        return 0;
+      case LockMode::SHARED:
+      case LockMode::INTENTION_EXCLUSIVE:
+        return 1;
+      case LockMode::SHARED_INTENTION_EXCLUSIVE:
+        return 2;
+      default:
+        return 3;
+    }
+  };
+  if (rank(a) == rank(b)) {
+    // SHARED and INTENTION_EXCLUSIVE.
+    return LockMode::SHARED_INTENTION_EXCLUSIVE;
+  }
+  return rank(a) > rank(b) ? a : b;
+}
+
+bool LockManager::Compatible(LockMode a, LockMode b) {
+  switch (a) {
+    case LockMode::INTENTION_SHARED:
+      return b != LockMode::EXCLUSIVE;
+    case LockMode::INTENTION_EXCLUSIVE:
+      return b == LockMode::INTENTION_SHARED || b == LockMode::INTENTION_EXCLUSIVE;
+    case LockMode::SHARED:
+      return b == LockMode::INTENTION_SHARED || b == LockMode::SHARED;
+    case LockMode::SHARED_INTENTION_EXCLUSIVE:
+      return b == LockMode::INTENTION_SHARED;
+    default:
+      return false;
+  }
+}
+
+bool LockManager::CanLock(Transaction *txn, LockMode lock_mode) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED && lock_mode != LockMode::EXCLUSIVE &&
+      lock_mode != LockMode::INTENTION_EXCLUSIVE) {
+    // Its reads take no locks.
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    // 2PL: no lock after the first unlock.
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  return true;
+}
+
+bool LockManager::Acquire(Transaction *txn, LockTablePartition *partition, LockRequestQueue *queue, LockMode lock_mode,
+                          std::unique_lock<std::mutex> *lock) {
+  auto it = queue->request_queue_.emplace(queue->request_queue_.end(), txn, lock_mode);
+  GrantWaiting(queue);
+  if (!it->granted_ && Prevention()) {
+    Prevent(partition, queue, &*it, lock);
+  }
+  Wait(partition, queue, &*it, lock);
+  if (txn->GetState() == TransactionState::ABORTED) {
+    queue->request_queue_.erase(it);
+    GrantWaiting(queue);
+    return false;
+  }
+  return true;
+}
+
+bool LockManager::Upgrade(Transaction *txn, LockTablePartition *partition, LockRequestQueue *queue, LockMode lock_mode,
+                          std::unique_lock<std::mutex> *lock) {
+  if (queue->upgrading_) {
+    // Two upgrades would wait for each other forever.
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  txn_id_t txn_id = txn->GetTransactionId();
+  auto &requests = queue->request_queue_;
+  auto it = std::find_if(requests.begin(), requests.end(), [&](const auto &r) { return r.txn_id_ == txn_id; });
+  BUSTUB_ASSERT(it != requests.end() && it->granted_, "Upgrading a lock that is not held.");
+  LockMode old_mode = it->lock_mode_;
+  requests.erase(it);
+  auto pos = std::find_if(requests.begin(), requests.end(), [](const auto &r) { return !r.granted_; });
+  it = requests.emplace(pos, txn, lock_mode);
+  queue->upgrading_ = true;
+  GrantWaiting(queue);
+  if (!it->granted_ && Prevention()) {
+    Prevent(partition, queue, &*it, lock);
+  }
+  if (!it->granted_ && Detection()) {
+    // The requests behind the upgrade wait for it now.
+    std::lock_guard<std::mutex> guard(latch_);
+    for (auto behind = std::next(it); behind != requests.end(); ++behind) {
+      auto &edges = waits_for_[behind->txn_id_];
+      if (std::find(edges.begin(), edges.end(), txn_id) == edges.end()) {
+        edges.push_back(txn_id);
+      }
+    }
+  }
+  Wait(partition, queue, &*it, lock);
+  queue->upgrading_ = false;
+  if (txn->GetState() == TransactionState::ABORTED) {
+    // Keep the old lock, which the transaction releases when it rolls back. It may be granted with the new one.
+    it->lock_mode_ = old_mode;
+    it->granted_ = true;
+    GrantWaiting(queue);
+    return false;
+  }
+  return true;
+}
+
+void LockManager::Prevent(LockTablePartition *partition, LockRequestQueue *queue, LockRequest *request,
+                          std::unique_lock<std::mutex> *lock) {
+  // The request waits for those ahead of it, unless they are granted in a compatible mode. Only an upgrade is
+  // followed by requests, which wait for it.
+  std::vector<const LockRequest *> waits_for;
+  std::vector<const LockRequest *> waited_by;
+  auto it = queue->request_queue_.begin();
+  for (; &*it != request; ++it) {
+    if (!it->granted_ || !Compatible(it->lock_mode_, request->lock_mode_)) {
+      waits_for.push_back(&*it);
+    }
+  }
+  for (++it; it != queue->request_queue_.end(); ++it) {
+    waited_by.push_back(&*it);
+  }
+  // Under WOUND_WAIT, a transaction only waits for older ones, under WAIT_DIE only for younger ones. The waiting
+  // transaction is aborted under WAIT_DIE, the one waited for under WOUND_WAIT.
+  bool wound_wait = deadlock_mode_ == DeadlockMode::WOUND_WAIT;
+  const auto &abort_if_younger = wound_wait ? waits_for : waited_by;
+  const auto &abort_request_if_older = wound_wait ? waited_by : waits_for;
+  for (const auto *other : abort_request_if_older) {
+    if (other->txn_id_ < request->txn_id_) {
+      request->txn_->SetState(TransactionState::ABORTED);
+      return;
+    }
+  }
+  std::vector<txn_id_t> victims;
+  for (const auto *other : abort_if_younger) {
+    if (other->txn_id_ > request->txn_id_ && other->txn_->Wound()) {
+      victims.push_back(other->txn_id_);
+    }
+  }
+  WakeUp(victims, partition, lock);
+}
+
+void LockManager::WakeUp(const std::vector<txn_id_t> &victims, LockTablePartition *partition,
+                         std::unique_lock<std::mutex> *lock) {
+  for (txn_id_t victim : victims) {
+    std::unique_lock<std::mutex> waiting_lock(waiting_latch_);
+    auto waiting = waiting_.find(victim);
+    if (waiting == waiting_.end()) {
+      // Running, it fails its next lock call.
+      continue;
+    }
+    if (waiting->second.partition_ == partition) {
+      waiting->second.request_->cv_.notify_one();
+      continue;
+    }
+    // The victim checks its state under the latch of the partition it waits in.
+    LockTablePartition *other = waiting->second.partition_;
+    waiting_lock.unlock();
+    lock->unlock();
+    {
+      std::lock_guard<std::mutex> other_guard(other->latch_);
+      std::lock_guard<std::mutex> waiting_guard(waiting_latch_);
+      waiting = waiting_.find(victim);
+      if (waiting != waiting_.end() && waiting->second.partition_ == other) {
+        waiting->second.request_->cv_.notify_one();
+      }
+    }
+    lock->lock();
+  }
+}
+
+void LockManager::Wait(LockTablePartition *partition, LockRequestQueue *queue, LockRequest *request,
+                       std::unique_lock<std::mutex> *lock) {
+  Transaction *txn = request->txn_;
+  txn_id_t txn_id = txn->GetTransactionId();
+  auto done = [&] { return request->granted_ || txn->GetState() == TransactionState::ABORTED; };
+  if (done()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(waiting_latch_);
+    waiting_[txn_id] = WaitingRequest{partition, request};
+  }
+  if (Detection()) {
+    AddWaitEdges(*queue, *request);
+    while (!request->cv_.wait_for(*lock, cycle_detection_interval, done)) {
+      // Requests ahead may have gone, and upgrades may have come in.
+      AddWaitEdges(*queue, *request);
+      txn_id_t victim;
+      if (!FindCycle(txn_id, &victim)) {
+        continue;
+      }
+      {
+        std::lock_guard<std::mutex> guard(latch_);
+        waits_for_.erase(victim);
+      }
+      if (victim == txn_id) {
+        txn->SetState(TransactionState::ABORTED);
+        break;
+      }
+      // Only a waiting transaction is part of a cycle, and it is still growing.
+      std::unique_lock<std::mutex> waiting_lock(waiting_latch_);
+      auto waiting = waiting_.find(victim);
+      if (waiting != waiting_.end() && waiting->second.request_->txn_->Wound()) {
+        waiting_lock.unlock();
+        WakeUp({victim}, partition, lock);
+      }
+    }
+    std::lock_guard<std::mutex> guard(latch_);
+    waits_for_.erase(txn_id);
+  } else {
+    request->cv_.wait(*lock, done);
+  }
+  std::lock_guard<std::mutex> guard(waiting_latch_);
+  waiting_.erase(txn_id);
+}
+
+void LockManager::AddWaitEdges(const LockRequestQueue &queue, const LockRequest &request) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto &edges = waits_for_[request.txn_id_];
+  edges.clear();
+  for (const auto &other : queue.request_queue_) {
+    if (&other == &request) {
+      break;
+    }
+    if (!other.granted_ || !Compatible(other.lock_mode_, request.lock_mode_)) {
+      edges.push_back(other.txn_id_);
+    }
+  }
+}
+
+void LockManager::GrantWaiting(LockRequestQueue *queue) {
+  // A bit per mode held by some granted request.
+  uint32_t granted_modes = 0;
+  auto compatible = [&](LockMode mode) {
+    for (uint32_t held = 0; held <= static_cast<uint32_t>(LockMode::SHARED_INTENTION_EXCLUSIVE); held++) {
+      if ((granted_modes & (1U << held)) != 0 && !Compatible(static_cast<LockMode>(held), mode)) {
+        return false;
+      }
+    }
+    return true;
+  };
+  for (auto &request : queue->request_queue_) {
+    if (!request.granted_) {
+      // FIFO: a request never overtakes one that waits.
+      if (!compatible(request.lock_mode_)) {
+        return;
+      }
+      request.granted_ = true;
+      request.cv_.notify_one();
+      if (Detection()) {
+        // The transaction waits for nobody now, even before it wakes up.
+        std::lock_guard<std::mutex> guard(latch_);
+        waits_for_.erase(request.txn_id_);
+      }
+    }
+    granted_modes |= 1U << static_cast<uint32_t>(request.lock_mode_);
+  }
+}
+
+bool LockManager::Release(LockRequestQueue *queue, txn_id_t txn_id) {
+  auto &requests = queue->request_queue_;
+  auto it = std::find_if(requests.begin(), requests.end(), [&](const auto &r) { return r.txn_id_ == txn_id; });
+  if (it != requests.end()) {
+    requests.erase(it);
+  }
+  GrantWaiting(queue);
+  return requests.empty();
+}
+
+void LockManager::Shrink(Transaction *txn) {
+  if (txn->GetState() == TransactionState::GROWING) {
+    txn->SetState(TransactionState::SHRINKING);
+  }
+}
+
+bool LockManager::LockKeyRange(Transaction *txn, const KeyRange &range, LockMode lock_mode) {
+  BUSTUB_ASSERT(lock_mode == LockMode::SHARED || lock_mode == LockMode::EXCLUSIVE, "Key ranges have no intentions.");
+  auto key_range_lock_set = txn->GetKeyRangeLockSet();
+  LockTablePartition &partition = GetKeyRangePartition(range);
+  std::unique_lock<std::mutex> lock(partition.latch_);
+  auto held = key_range_lock_set->find(range);
+  if (held != key_range_lock_set->end() && Covers(held->second, lock_mode)) {
+    return true;
+  }
+  if (!CanLock(txn, lock_mode)) {
+    return false;
+  }
+  LockRequestQueue *queue = &partition.key_range_lock_table_[range];
+  if (held == key_range_lock_set->end()) {
+    if (!Acquire(txn, &partition, queue, lock_mode, &lock)) {
+      return false;
+    }
+    key_range_lock_set->emplace(range, lock_mode);
+    return true;
+  }
+  if (!Upgrade(txn, &partition, queue, lock_mode, &lock)) {
+    return false;
+  }
+  held->second = lock_mode;
+  return true;
+}
+
+bool LockManager::LockInsertGap(Transaction *txn, const KeyRange &gap) {
+  if (txn->GetKeyRangeLockSet()->count(gap) != 0) {
+    return LockKeyRange(txn, gap, LockMode::EXCLUSIVE);
+  }
+  LockTablePartition &partition = GetKeyRangePartition(gap);
+  std::unique_lock<std::mutex> lock(partition.latch_);
+  if (!CanLock(txn, LockMode::EXCLUSIVE)) {
+    return false;
+  }
+  LockRequestQueue *queue = &partition.key_range_lock_table_[gap];
+  if (!Acquire(txn, &partition, queue, LockMode::EXCLUSIVE, &lock)) {
+    return false;
+  }
+  // An instant lock is no unlock in the sense of 2PL.
+  if (Release(queue, txn->GetTransactionId())) {
+    partition.key_range_lock_table_.erase(gap);
+  }
   return true;
 }
 
-void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) { assert(Detection()); }
+bool LockManager::UnlockKeyRange(Transaction *txn, const KeyRange &range) {
+  LockTablePartition &partition = GetKeyRangePartition(range);
+  std::unique_lock<std::mutex> lock(partition.latch_);
+  auto it = partition.key_range_lock_table_.find(range);
+  auto held = txn->GetKeyRangeLockSet()->find(range);
+  if (held == txn->GetKeyRangeLockSet()->end() || it == partition.key_range_lock_table_.end()) {
+    return false;
+  }
+  bool exclusive = held->second == LockMode::EXCLUSIVE;
+  txn->GetKeyRangeLockSet()->erase(held);
+  if (Release(&it->second, txn->GetTransactionId())) {
+    partition.key_range_lock_table_.erase(it);
+  }
+  if (exclusive || txn->GetIsolationLevel() != IsolationLevel::READ_COMMITTED) {
+    Shrink(txn);
+  }
+  return true;
+}
+
+void LockManager::AddRowLock(Transaction *txn, const RID &rid, page_id_t table_id) {
+  size_t threshold = lock_escalation_threshold;
+  if (table_id == INVALID_PAGE_ID || threshold == 0) {
+    return;
+  }
+  auto &rows = (*txn->GetTableRowLockSet())[table_id];
+  rows.push_back(rid);
+  if (rows.size() > threshold && (rows.size() - 1) % threshold == 0) {
+    Escalate(txn, table_id);
+  }
+}
 
-void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) { assert(Detection()); }
+bool LockManager::Escalate(Transaction *txn, page_id_t table_id) {
+  auto &rows = (*txn->GetTableRowLockSet())[table_id];
+  bool exclusive = std::any_of(rows.begin(), rows.end(), [txn](const RID &rid) { return txn->IsExclusiveLocked(rid); });
+  {
+    LockTablePartition &partition = GetTablePartition(table_id);
+    std::lock_guard<std::mutex> guard(partition.latch_);
+    auto held = txn->GetTableLockSet()->find(table_id);
+    auto queue = partition.table_lock_table_.find(table_id);
+    if (held == txn->GetTableLockSet()->end() || queue == partition.table_lock_table_.end()) {
+      return false;
+    }
+    LockMode upgraded = Combine(held->second, exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED);
+    // Every other request is granted and stays compatible, so nobody waits for the transaction because of this.
+    LockRequest *own = nullptr;
+    for (auto &request : queue->second.request_queue_) {
+      if (request.txn_id_ == txn->GetTransactionId()) {
+        own = &request;
+      } else if (!request.granted_ || !Compatible(request.lock_mode_, upgraded)) {
+        escalation_conflicts_++;
+        return false;
+      }
+    }
+    BUSTUB_ASSERT(own != nullptr, "The table lock of the transaction is not in the queue.");
+    own->lock_mode_ = upgraded;
+    held->second = upgraded;
+  }
+  // The table lock covers the rows now. Releasing them is no unlock in the sense of 2PL.
+  uint64_t released = 0;
+  for (const RID &rid : rows) {
+    if (txn->GetSharedLockSet()->erase(rid) + txn->GetExclusiveLockSet()->erase(rid) == 0) {
+      continue;
+    }
+    LockTablePartition &partition = GetPartition(rid);
+    std::lock_guard<std::mutex> guard(partition.latch_);
+    auto it = partition.lock_table_.find(rid);
+    if (it != partition.lock_table_.end() && Release(&it->second, txn->GetTransactionId())) {
+      partition.lock_table_.erase(it);
+    }
+    released++;
+  }
+  rows.clear();
+  escalations_++;
+  released_rows_ += released;
+  return true;
+}
+
+void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {
+  assert(Detection());
+  std::lock_guard<std::mutex> guard(latch_);
+  auto &edges = waits_for_[t1];
+  if (std::find(edges.begin(), edges.end(), t2) == edges.end()) {
+    edges.push_back(t2);
+  }
+}
+
+void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
+  assert(Detection());
+  std::lock_guard<std::mutex> guard(latch_);
+  auto it = waits_for_.find(t1);
+  if (it == waits_for_.end()) {
+    return;
+  }
+  it->second.erase(std::remove(it->second.begin(), it->second.end(), t2), it->second.end());
+  if (it->second.empty()) {
+    waits_for_.erase(it);
+  }
+}
 
 bool LockManager::HasCycle(txn_id_t *txn_id) {
   BUSTUB_ASSERT(Detection(), "Detection should be enabled!");
+  std::lock_guard<std::mutex> guard(latch_);
+  // Depth-first search from the oldest transaction, visiting the older ones first so that the result is stable.
+  std::vector<txn_id_t> sources;
+  for (auto &[source, edges] : waits_for_) {
+    std::sort(edges.begin(), edges.end());
+    sources.push_back(source);
+  }
+  std::sort(sources.begin(), sources.end());
+  std::unordered_set<txn_id_t> visited;
+  std::vector<txn_id_t> path;
+  std::unordered_set<txn_id_t> on_path;
+  std::function<bool(txn_id_t)> visit = [&](txn_id_t txn) {
+    visited.insert(txn);
+    path.push_back(txn);
+    on_path.insert(txn);
+    auto it = waits_for_.find(txn);
+    if (it != waits_for_.end()) {
+      for (txn_id_t next : it->second) {
+        if (on_path.count(next) != 0) {
+          *txn_id = *std::max_element(std::find(path.begin(), path.end(), next), path.end());
+          return true;
+        }
+        if (visited.count(next) == 0 && visit(next)) {
+          return true;
+        }
+      }
+    }
+    path.pop_back();
+    on_path.erase(txn);
+    return false;
+  };
+  for (txn_id_t source : sources) {
+    if (visited.count(source) == 0 && visit(source)) {
+      return true;
+    }
+  }
   return false;
 }
 
 std::vector<std::pair<txn_id_t, txn_id_t>> LockManager::GetEdgeList() {
   BUSTUB_ASSERT(Detection(), "Detection should be enabled!");
-  return {};
+  std::lock_guard<std::mutex> guard(latch_);
+  std::vector<std::pair<txn_id_t, txn_id_t>> edges;
+  for (const auto &[source, targets] : waits_for_) {
+    for (txn_id_t target : targets) {
+      edges.emplace_back(source, target);
+    }
+  }
+  return edges;
 }
 
-void LockManager::RunCycleDetection() {
-  BUSTUB_ASSERT(Detection(), "Detection should be enabled!");
-  while (enable_cycle_detection_) {
-    std::this_thread::sleep_for(cycle_detection_interval);
-    {
-      std::unique_lock<std::mutex> l(latch_);
-      // TODO(student): remove the continue and add your cycle detection and abort code here
-      continue;
+bool LockManager::FindCycle(txn_id_t source, txn_id_t *txn_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  std::unordered_set<txn_id_t> visited;
+  std::vector<txn_id_t> path;
+  std::function<bool(txn_id_t)> visit = [&](txn_id_t txn) {
+    visited.insert(txn);
+    path.push_back(txn);
+    auto it = waits_for_.find(txn);
+    if (it != waits_for_.end()) {
+      for (txn_id_t next : it->second) {
+        if (next == source) {
+          *txn_id = *std::max_element(path.begin(), path.end());
+          return true;
+        }
+        if (visited.count(next) == 0 && visit(next)) {
+          return true;
+        }
+      }
     }
-  }
+    path.pop_back();
+    return false;
+  };
+  return visit(source);
 }
 
 }  // namespace bustub
@@ -12,32 +12,53 @@
 
 #include "concurrency/transaction_manager.h"
 
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
+TransactionRegistry TransactionManager::txn_registry;
 
-Transaction *TransactionManager::Begin(Transaction *txn) {
+/** Transactions that ended on this thread, which Begin() reuses. Freed when the thread exits. */
+static thread_local std::vector<std::unique_ptr<Transaction>> txn_pool;
+
+Transaction *TransactionManager::Begin(Transaction *txn, ConcurrencyControl concurrency_control,
+                                       IsolationLevel isolation_level) {
   // Acquire the global transaction latch in shared mode.
   global_txn_latch_.RLock();
 
-  if (txn == nullptr) {
+  if (txn == nullptr && !txn_pool.empty()) {
+    txn = txn_pool.back().release();
+    txn_pool.pop_back();
+    txn->Reset(next_txn_id_++);
+  } else if (txn == nullptr) {
     txn = new Transaction(next_txn_id_++);
   }
+  timestamp_t read_ts = concurrency_control != ConcurrencyControl::LOCKING ? version_store_.BeginSnapshot() : 0;
+  txn->SetConcurrencyControl(concurrency_control, &version_store_, read_ts);
+  txn->SetIsolationLevel(isolation_level);
 
   if (enable_logging) {
-    // TODO(student): Add logging here.
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
+    lsn_t lsn = log_manager_->AppendLogRecord(&log_record, txn, INVALID_PAGE_ID);
+    if (lsn != INVALID_LSN) {
+      txn->SetPrevLSN(lsn);
+    }
   }
 
-  txn_map[txn->GetTransactionId()] = txn;
+  txn_registry.Register(txn);
   return txn;
 }
 
 void TransactionManager::Commit(Transaction *txn) {
+  if (txn->BuffersWrites() && !ApplyBufferedWrites(txn)) {
+    Abort(txn);
+    return;
+  }
   txn->SetState(TransactionState::COMMITTED);
 
   // Perform all deletes before we commit.
@@ -54,22 +75,43 @@ void TransactionManager::Commit(Transaction *txn) {
   write_set->clear();
 
   if (enable_logging) {
-    // TODO(student): add logging here
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+    log_manager_->AppendLogRecord(&log_record, txn, INVALID_PAGE_ID);
+    // Publish the whole private buffer with one reservation, then wait for it to become durable. An asynchronous
+    // commit leaves that to the flush thread: until the COMMIT record is on disk, recovery undoes the transaction as
+    // a whole, and transactions that saw its changes commit after it in the log, so they cannot outlive it.
+    lsn_t lsn = log_manager_->PublishPrivateLog(txn);
+    log_manager_->ReleasePrivateLog(txn);
+    if (!txn->IsAsyncCommit()) {
+      log_manager_->Flush(lsn);
+    }
   }
 
+  // Other writers of the rows wait for the locks, so they see the commit timestamp.
+  version_store_.Commit(txn);
   // Release all the locks.
   ReleaseLocks(txn);
+  if (txn->IsSnapshot()) {
+    version_store_.EndSnapshot(txn->GetReadTimestamp());
+  }
+  txn_registry.Remove(txn->GetTransactionId());
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
 }
 
 void TransactionManager::Abort(Transaction *txn) {
   txn->SetState(TransactionState::ABORTED);
+  // Writes that an optimistic transaction buffered never reached the table.
+  if (txn->BuffersWrites()) {
+    txn->GetWriteSet()->clear();
+  }
 
-  // Rollback before releasing the lock.
-  auto write_set = txn->GetWriteSet();
-  while (!write_set->empty()) {
-    auto &item = write_set->back();
+  // Rollback before releasing the lock. The updates that undo the writes go to the write set like any other, so roll
+  // back from a copy.
+  std::deque<WriteRecord> write_set;
+  write_set.swap(*txn->GetWriteSet());
+  while (!write_set.empty()) {
+    auto &item = write_set.back();
     auto table = item.table_;
     if (item.wtype_ == WType::DELETE) {
       table->RollbackDelete(item.rid_, txn);
@@ -79,20 +121,71 @@ void TransactionManager::Abort(Transaction *txn) {
     } else if (item.wtype_ == WType::UPDATE) {
       table->UpdateTuple(item.tuple_, item.rid_, txn);
     }
-    write_set->pop_back();
+    write_set.pop_back();
   }
-  write_set->clear();
+  txn->GetWriteSet()->clear();
 
   if (enable_logging) {
-    // TODO(student): add logging here
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
+    log_manager_->AppendLogRecord(&log_record, txn, INVALID_PAGE_ID);
+    // Publish the whole private buffer with one reservation, then wait for it to become durable.
+    lsn_t lsn = log_manager_->PublishPrivateLog(txn);
+    log_manager_->ReleasePrivateLog(txn);
+    log_manager_->Flush(lsn);
   }
 
+  version_store_.Abort(txn);
   // Release all the locks.
   ReleaseLocks(txn);
+  if (txn->IsSnapshot()) {
+    version_store_.EndSnapshot(txn->GetReadTimestamp());
+  }
+  txn_registry.Remove(txn->GetTransactionId());
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
 }
 
+bool TransactionManager::ApplyBufferedWrites(Transaction *txn) {
+  std::lock_guard<std::mutex> guard(validation_latch_);
+  if (!version_store_.Validate(txn)) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  // From here on the writes go to the table like those of a snapshot transaction, which locks each row.
+  std::deque<WriteRecord> buffered;
+  buffered.swap(*txn->GetWriteSet());
+  txn->StartWritePhase();
+  for (auto &item : buffered) {
+    RID rid = item.rid_;
+    bool applied = false;
+    if (item.wtype_ == WType::INSERT) {
+      applied = item.table_->InsertTuple(item.tuple_, &rid, txn);
+    } else if (item.wtype_ == WType::DELETE) {
+      applied = item.table_->MarkDelete(rid, txn);
+    } else if (item.wtype_ == WType::UPDATE) {
+      applied = item.table_->UpdateTuple(item.tuple_, rid, txn);
+    }
+    if (!applied || txn->GetState() == TransactionState::ABORTED) {
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+  }
+  return true;
+}
+
+void TransactionManager::Recycle(Transaction *txn) {
+  BUSTUB_ASSERT(txn->GetState() == TransactionState::COMMITTED || txn->GetState() == TransactionState::ABORTED,
+                "Recycling a transaction that has not ended.");
+  if (txn_pool.size() >= static_cast<size_t>(TXN_POOL_SIZE)) {
+    delete txn;
+    return;
+  }
+  if (txn_pool.capacity() == 0) {
+    txn_pool.reserve(TXN_POOL_SIZE);
+  }
+  txn_pool.emplace_back(txn);
+}
+
 void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
 
 void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
@@ -0,0 +1,198 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.cpp
+//
+// Identification: src/concurrency/transaction_registry.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/transaction_registry.h"
+
+#include <algorithm>
+
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+TransactionRegistry::TransactionRegistry(size_t num_shards)
+    : num_shards_(num_shards), shards_(new Shard[num_shards]) {
+  BUSTUB_ASSERT(num_shards_ > 0 && (num_shards_ & (num_shards_ - 1)) == 0, "The number of shards is a power of two.");
+  while ((static_cast<size_t>(1) << shard_bits_) < num_shards_) {
+    shard_bits_++;
+  }
+  for (size_t i = 0; i < num_shards_; i++) {
+    shards_[i].table_ = new Table(MIN_CAPACITY);
+    shards_[i].readers_[0] = 0;
+    shards_[i].readers_[1] = 0;
+  }
+}
+
+TransactionRegistry::~TransactionRegistry() {
+  for (size_t i = 0; i < num_shards_; i++) {
+    delete shards_[i].table_.load();
+    for (auto &[epoch, table] : shards_[i].retired_) {
+      delete table;
+    }
+  }
+}
+
+void TransactionRegistry::Register(Transaction *txn) {
+  txn_id_t txn_id = txn->GetTransactionId();
+  BUSTUB_ASSERT(txn_id >= 0, "Transaction IDs are not negative.");
+  Shard &shard = GetShard(txn_id);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  Table *table = shard.table_;
+  Slot *slot = FindSlot(table, txn_id);
+  if (slot != nullptr) {
+    slot->txn_ = txn;
+    return;
+  }
+  // Keep at least half of the slots empty, so that probes stay short and lookups of missing IDs end.
+  if (2 * (shard.used_ + 1) > table->capacity_) {
+    Rebuild(&shard);
+    table = shard.table_;
+  }
+  for (size_t i = HomeSlot(txn_id, *table);; i = (i + 1) & (table->capacity_ - 1)) {
+    txn_id_t current = table->slots_[i].txn_id_;
+    if (current == EMPTY || current == TOMBSTONE) {
+      table->slots_[i].txn_ = txn;
+      table->slots_[i].txn_id_ = txn_id;
+      shard.live_++;
+      shard.used_ += current == EMPTY ? 1 : 0;
+      break;
+    }
+  }
+  Reclaim(&shard);
+}
+
+void TransactionRegistry::Remove(txn_id_t txn_id) {
+  Shard &shard = GetShard(txn_id);
+  std::lock_guard<std::mutex> guard(shard.latch_);
+  Slot *slot = FindSlot(shard.table_, txn_id);
+  if (slot == nullptr) {
+    return;
+  }
+  slot->txn_id_ = TOMBSTONE;
+  slot->txn_ = nullptr;
+  shard.live_--;
+  // Shrink once most of the table is unused, which also drops the tombstones.
+  Table *table = shard.table_;
+  if (table->capacity_ > MIN_CAPACITY && 8 * shard.live_ < table->capacity_) {
+    Rebuild(&shard);
+  }
+  Reclaim(&shard);
+}
+
+Transaction *TransactionRegistry::Find(txn_id_t txn_id) {
+  Shard &shard = GetShard(txn_id);
+  uint64_t epoch;
+  while (true) {
+    epoch = shard.epoch_.load(std::memory_order_acquire);
+    // The increment has to be visible before the table is read, which the read-modify-write and the load after it
+    // order.
+    shard.readers_[epoch & 1].fetch_add(1);
+    if (shard.epoch_.load() == epoch) {
+      break;
+    }
+    shard.readers_[epoch & 1].fetch_sub(1, std::memory_order_release);
+  }
+  Transaction *txn = nullptr;
+  Table *table = shard.table_.load(std::memory_order_acquire);
+  size_t mask = table->capacity_ - 1;
+  for (size_t i = HomeSlot(txn_id, *table), probes = 0; probes <= mask; i = (i + 1) & mask, probes++) {
+    txn_id_t current = table->slots_[i].txn_id_.load(std::memory_order_acquire);
+    if (current == EMPTY) {
+      break;
+    }
+    if (current == txn_id) {
+      txn = table->slots_[i].txn_.load(std::memory_order_acquire);
+      // IDs are never registered twice at once, so the slot held the transaction all along unless it was removed.
+      if (table->slots_[i].txn_id_.load() != txn_id) {
+        txn = nullptr;
+      }
+      break;
+    }
+  }
+  shard.readers_[epoch & 1].fetch_sub(1, std::memory_order_release);
+  return txn;
+}
+
+size_t TransactionRegistry::Size() {
+  size_t size = 0;
+  for (size_t i = 0; i < num_shards_; i++) {
+    std::lock_guard<std::mutex> guard(shards_[i].latch_);
+    size += shards_[i].live_;
+  }
+  return size;
+}
+
+size_t TransactionRegistry::GetCapacity() {
+  size_t capacity = 0;
+  for (size_t i = 0; i < num_shards_; i++) {
+    std::lock_guard<std::mutex> guard(shards_[i].latch_);
+    capacity += shards_[i].table_.load()->capacity_;
+    for (auto &[epoch, table] : shards_[i].retired_) {
+      capacity += table->capacity_;
+    }
+  }
+  return capacity;
+}
+
+TransactionRegistry::Slot *TransactionRegistry::FindSlot(Table *table, txn_id_t txn_id) {
+  for (size_t i = HomeSlot(txn_id, *table);; i = (i + 1) & (table->capacity_ - 1)) {
+    txn_id_t current = table->slots_[i].txn_id_;
+    if (current == txn_id) {
+      return &table->slots_[i];
+    }
+    if (current == EMPTY) {
+      return nullptr;
+    }
+  }
+}
+
+void TransactionRegistry::Rebuild(Shard *shard) {
+  Table *old_table = shard->table_;
+  size_t capacity = MIN_CAPACITY;
+  while (capacity < 4 * (shard->live_ + 1)) {
+    capacity *= 2;
+  }
+  auto *table = new Table(capacity);
+  for (size_t i = 0; i < old_table->capacity_; i++) {
+    txn_id_t txn_id = old_table->slots_[i].txn_id_;
+    if (txn_id == EMPTY || txn_id == TOMBSTONE) {
+      continue;
+    }
+    size_t j = HomeSlot(txn_id, *table);
+    while (table->slots_[j].txn_id_ != EMPTY) {
+      j = (j + 1) & (capacity - 1);
+    }
+    table->slots_[j].txn_ = old_table->slots_[i].txn_.load();
+    table->slots_[j].txn_id_ = txn_id;
+  }
+  shard->table_ = table;
+  shard->used_ = shard->live_;
+  shard->retired_.emplace_back(shard->epoch_, old_table);
+}
+
+void TransactionRegistry::Reclaim(Shard *shard) {
+  if (shard->retired_.empty()) {
+    return;
+  }
+  // Lookups that started two epochs ago are done once the counter that the next epoch reuses has drained.
+  uint64_t epoch = shard->epoch_;
+  if (shard->readers_[(epoch + 1) & 1] == 0) {
+    shard->epoch_ = ++epoch;
+  }
+  auto &retired = shard->retired_;
+  auto done = std::partition(retired.begin(), retired.end(), [epoch](const auto &r) { return r.first + 2 > epoch; });
+  for (auto it = done; it != retired.end(); ++it) {
+    delete it->second;
+  }
+  retired.erase(done, retired.end());
+}
+
+}  // namespace bustub
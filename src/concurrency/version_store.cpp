@@ -0,0 +1,217 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.cpp
+//
+// Identification: src/concurrency/version_store.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/version_store.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+timestamp_t VersionStore::BeginSnapshot() {
+  std::lock_guard<std::mutex> guard(latch_);
+  snapshots_.insert(last_commit_ts_);
+  return last_commit_ts_;
+}
+
+void VersionStore::EndSnapshot(timestamp_t read_ts) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto it = snapshots_.find(read_ts);
+  BUSTUB_ASSERT(it != snapshots_.end(), "Ending a snapshot that was not begun.");
+  snapshots_.erase(it);
+  CollectGarbage();
+}
+
+bool VersionStore::CanWrite(Transaction *txn, const RID &rid) {
+  std::lock_guard<std::mutex> guard(latch_);
+  return IsUnchanged(txn, rid);
+}
+
+bool VersionStore::Validate(Transaction *txn) {
+  std::lock_guard<std::mutex> guard(latch_);
+  for (const RID &rid : *txn->GetReadSet()) {
+    if (!IsUnchanged(txn, rid)) {
+      return false;
+    }
+  }
+  // Buffered inserts have no row yet.
+  for (const WriteRecord &item : *txn->GetWriteSet()) {
+    if (item.wtype_ != WType::INSERT && !IsUnchanged(txn, item.rid_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void VersionStore::AddVersion(Transaction *txn, const RID &rid, const Tuple *before) {
+  std::lock_guard<std::mutex> guard(latch_);
+  VersionChain &chain = chains_[rid];
+  if (chain.writer_ == txn->GetTransactionId()) {
+    // Nobody else sees what the transaction wrote before.
+    return;
+  }
+  if (chain.writer_ != INVALID_TXN_ID) {
+    // The writer freed the slot, by committing a delete or rolling back an insert, and is not done yet. Until it is,
+    // the empty slot is a version that no snapshot sees.
+    BUSTUB_ASSERT(before == nullptr, "Two transactions write a row at the same time.");
+    chain.undo_.push_back(UndoVersion{PENDING_TS, false, Tuple{}, chain.writer_});
+  } else {
+    chain.undo_.push_back(UndoVersion{chain.ts_, before != nullptr, before != nullptr ? *before : Tuple{}});
+  }
+  chain.writer_ = txn->GetTransactionId();
+  writes_[chain.writer_].push_back(rid);
+}
+
+VersionVisibility VersionStore::GetVersion(Transaction *txn, const RID &rid, Tuple *tuple) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto it = chains_.find(rid);
+  if (it == chains_.end()) {
+    return VersionVisibility::CURRENT;
+  }
+  const VersionChain &chain = it->second;
+  timestamp_t read_ts = txn->GetReadTimestamp();
+  if (chain.writer_ == txn->GetTransactionId() || (chain.writer_ == INVALID_TXN_ID && chain.ts_ <= read_ts)) {
+    return VersionVisibility::CURRENT;
+  }
+  for (auto version = chain.undo_.rbegin(); version != chain.undo_.rend(); ++version) {
+    if (version->ts_ <= read_ts) {
+      if (!version->exists_) {
+        return VersionVisibility::NONE;
+      }
+      *tuple = version->tuple_;
+      return VersionVisibility::OLD;
+    }
+  }
+  return VersionVisibility::NONE;
+}
+
+void VersionStore::Commit(Transaction *txn) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto it = writes_.find(txn->GetTransactionId());
+  if (it == writes_.end()) {
+    return;
+  }
+  // Snapshots taken from now on see every row of the transaction.
+  timestamp_t commit_ts = ++last_commit_ts_;
+  for (const RID &rid : it->second) {
+    auto chain = chains_.find(rid);
+    if (chain == chains_.end()) {
+      continue;
+    }
+    if (chain->second.writer_ == txn->GetTransactionId()) {
+      chain->second.writer_ = INVALID_TXN_ID;
+      chain->second.ts_ = commit_ts;
+      continue;
+    }
+    // Another transaction reused the slot that the delete freed. Versions stay in commit order, so the row is gone
+    // no later than the next version appeared.
+    auto pending = FindPending(&chain->second, txn->GetTransactionId());
+    if (pending != chain->second.undo_.end()) {
+      auto next = pending + 1;
+      timestamp_t next_ts = PENDING_TS;
+      if (next != chain->second.undo_.end()) {
+        next_ts = next->ts_;
+      } else if (chain->second.writer_ == INVALID_TXN_ID) {
+        next_ts = chain->second.ts_;
+      }
+      pending->ts_ = std::min(commit_ts, next_ts);
+      pending->pending_ = INVALID_TXN_ID;
+    }
+  }
+  committed_.emplace_back(commit_ts, std::move(it->second));
+  writes_.erase(it);
+  CollectGarbage();
+}
+
+void VersionStore::Abort(Transaction *txn) {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto it = writes_.find(txn->GetTransactionId());
+  if (it == writes_.end()) {
+    return;
+  }
+  timestamp_t watermark = Watermark();
+  for (const RID &rid : it->second) {
+    auto chain = chains_.find(rid);
+    if (chain == chains_.end()) {
+      continue;
+    }
+    if (chain->second.writer_ != txn->GetTransactionId()) {
+      // Another transaction reused the slot of a rolled back insert, so it overwrote what was there before.
+      auto pending = FindPending(&chain->second, txn->GetTransactionId());
+      if (pending != chain->second.undo_.end()) {
+        chain->second.undo_.erase(pending);
+      }
+      continue;
+    }
+    // The row goes back to the transaction that freed its slot, if that one is not done yet.
+    chain->second.writer_ = chain->second.undo_.back().pending_;
+    chain->second.undo_.pop_back();
+    // Otherwise the commit of the version on the page drops the chain later.
+    if (chain->second.writer_ == INVALID_TXN_ID && chain->second.ts_ <= watermark) {
+      chains_.erase(chain);
+    }
+  }
+  writes_.erase(it);
+}
+
+size_t VersionStore::GetVersionedRowCount() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return chains_.size();
+}
+
+bool VersionStore::IsUnchanged(Transaction *txn, const RID &rid) {
+  auto it = chains_.find(rid);
+  if (it == chains_.end()) {
+    return true;
+  }
+  const VersionChain &chain = it->second;
+  if (chain.writer_ != INVALID_TXN_ID) {
+    return chain.writer_ == txn->GetTransactionId();
+  }
+  return chain.ts_ <= txn->GetReadTimestamp();
+}
+
+std::vector<VersionStore::UndoVersion>::iterator VersionStore::FindPending(VersionChain *chain, txn_id_t txn_id) {
+  return std::find_if(chain->undo_.begin(), chain->undo_.end(),
+                      [txn_id](const UndoVersion &version) { return version.pending_ == txn_id; });
+}
+
+timestamp_t VersionStore::Watermark() { return snapshots_.empty() ? last_commit_ts_ : *snapshots_.begin(); }
+
+void VersionStore::CollectGarbage() {
+  timestamp_t watermark = Watermark();
+  while (!committed_.empty() && committed_.front().first <= watermark) {
+    for (const RID &rid : committed_.front().second) {
+      auto it = chains_.find(rid);
+      if (it == chains_.end()) {
+        continue;
+      }
+      VersionChain &chain = it->second;
+      if (chain.writer_ == INVALID_TXN_ID) {
+        if (chain.ts_ <= watermark) {
+          chains_.erase(it);
+        }
+        continue;
+      }
+      // A writer is at work: keep the version every snapshot sees, which is the newest one old enough, and those after.
+      auto &undo = chain.undo_;
+      for (size_t i = undo.size(); i-- > 0;) {
+        if (undo[i].ts_ <= watermark) {
+          undo.erase(undo.begin(), undo.begin() + i);
+          break;
+        }
+      }
+    }
+    committed_.pop_front();
+  }
+}
+
+}  // namespace bustub
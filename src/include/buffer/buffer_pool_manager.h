@@ -13,9 +13,9 @@
 #pragma once
 
 #include <list>
-#include <iostream>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <vector>
 
 #include "buffer/clock_replacer.h"
 #include "recovery/log_manager.h"
@@ -24,8 +24,24 @@
 
 namespace bustub {
 
+class LogRecovery;
+
+/** Counters of the page writes of a BufferPoolManager. */
+struct BufferPoolStats {
+  /** Victims taken from the replacer, and how many of them were dirty and written back. */
+  uint64_t evictions_{0};
+  uint64_t dirty_evictions_{0};
+  /** Evictions that passed over frames whose log was not durable, and asked for an asynchronous log flush. */
+  uint64_t async_flush_requests_{0};
+  /** Page writes that waited for a log flush by the write-ahead rule, which they do without the buffer pool latch. */
+  uint64_t wal_forced_flushes_{0};
+};
+
 /**
  * BufferPoolManager reads disk pages to and from its internal buffer pool.
+ *
+ * Eviction prefers victims that can be written without forcing the log. If it has to pass over others, it asks for
+ * an asynchronous log flush. If every candidate waits for the log, it waits for the flush with the latch released.
  */
 class BufferPoolManager {
  public:
@@ -92,11 +108,26 @@ class BufferPoolManager {
     GradingCallback(callback, CallbackType::AFTER, INVALID_PAGE_ID);
   }
 
+  /**
+   * Collect the dirty page table for a checkpoint. Pinned pages are included even if they are clean, since they may be
+   * in the middle of a change.
+   * @return every page that is dirty or pinned, with its recLSN
+   */
+  std::vector<DirtyPageEntry> GetDirtyPageTable();
+
+  /**
+   * Make every page read from disk go through log_recovery->RedoPage() before it is returned, for a restart that
+   * redoes pages on demand. Pages that still wait for redo also show up in the dirty page table.
+   * @param log_recovery the recovery that indexed the pending records, nullptr to stop
+   */
+  void SetRedoOnDemand(LogRecovery *log_recovery);
+
+  /** @return a snapshot of the page write counters */
+  BufferPoolStats GetStats();
+
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
-  Page* getPage(page_id_t page_id, bool x);
-
   /** @return size of the buffer pool */
   size_t GetPoolSize() { return pool_size_; }
 
@@ -155,21 +186,58 @@ class BufferPoolManager {
    */
   void FlushAllPagesImpl();
 
+  /**
+   * Take a frame from the free list, or else evict a victim from the replacer, writing it back if it is dirty.
+   * @param[out] frame_id the frame that can be reused
+   * @param lock holds latch_, which is released while waiting for the log
+   * @return false if every frame is pinned
+   */
+  bool FindVictimFrame(frame_id_t *frame_id, std::unique_lock<std::mutex> *lock);
+
+  /** @return true if writing the page now would have to force the log first */
+  bool NeedsLogFlush(Page *page);
+
+  /**
+   * Write a resident page back under its write latch, forcing the log first if the write-ahead rule asks for it.
+   * @param frame_id the frame of the page
+   * @param lock holds latch_, which is released while waiting for the page latch and for the log
+   */
+  void FlushFrame(frame_id_t frame_id, std::unique_lock<std::mutex> *lock);
+
+  /**
+   * Publish the records that the running writers of the page keep privately and move the page LSN past them. The
+   * caller holds the write latch of the page, or the page is unpinned, so that nobody else writes the page LSN.
+   * @return the LSN that the log must reach before the page may be written, which may cover records of other pages
+   */
+  lsn_t PublishPageLog(Page *page);
+
+  /**
+   * Write the page to disk, under the same conditions as PublishPageLog(). Its log is durable already: eviction picks
+   * such victims, and FlushFrame() forces it.
+   */
+  void WritePageBack(Page *page);
+
+  /** @return a recLSN for a page that starts to be changed now: every record that is not yet durable comes after it */
+  lsn_t CurrentRecLSN();
+
   /** Number of pages in the buffer pool. */
   size_t pool_size_;
   /** Array of buffer pool pages. */
   Page *pages_;
   /** Pointer to the disk manager. */
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
   /** Pointer to the log manager. */
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
   /** Page table for keeping track of buffer pool pages. */
   std::unordered_map<page_id_t, frame_id_t> page_table_;
   /** Replacer to find unpinned pages for replacement. */
   Replacer *replacer_;
   /** List of free pages. */
   std::list<frame_id_t> free_list_;
-  /** This latch protects shared data structures. We recommend updating this comment to describe what it protects. */
+  /** Redoes pages as they are read in while an instant restart is in progress, nullptr otherwise. */
+  LogRecovery *redo_on_demand_{nullptr};
+  BufferPoolStats stats_;
+  /** Protects the page table, the free list, redo_on_demand_, stats_ and the book-keeping fields of every page. */
   std::mutex latch_;
 };
 }  // namespace bustub
@@ -12,174 +12,14 @@
 
 #pragma once
 
-#include <list>
 #include <mutex>  // NOLINT
 #include <vector>
-#include <algorithm>
-
-#include <iostream>
 
 #include "buffer/replacer.h"
 #include "common/config.h"
 
 namespace bustub {
 
-/**
- * Structure to hold all information in a single frame 
- */
-struct ClockSlot{
-  frame_id_t value;
-  frame_id_t position;
-  bool ref_id;
-  ClockSlot* next;
-
-
-  ClockSlot()
-  {
-    this->position = position;
-    this->value = -1;
-    this->ref_id = false;
-  }
-};
-
-struct Clock{
-  frame_id_t current_head_id;
-  frame_id_t ticker_head_pos;
-  ClockSlot* head;
-
-  Clock(size_t size)
-  {
-    head = new ClockSlot();
-    head->position = 1;
-    head->next = NULL;
-    current_head_id = 1;
-    ticker_head_pos = 1;
-    
-
-    for(size_t i = 1 ; i <= size -1 ; i++)
-    {
-      ClockSlot* temp = new ClockSlot();
-      temp->position = i+1;
-      ClockSlot* lastnode = head;
-      size_t iter = 0;
-      while(lastnode->next != NULL)
-      {
-        iter+= 1;
-        lastnode = lastnode->next;
-      }
-
-      if (iter == size-2)
-      {
-        temp->next = head;
-
-      }
-      
-      lastnode->next = temp;
-    }
-  }
-
-  void add(frame_id_t value)
-  {
-    ClockSlot* temp = head;
-    while ((temp->value != -1))
-    {
-      temp = temp->next;
-    }
-    temp->value = value; 
-    
-  }
-
-  size_t size()
-  {
-
-    ClockSlot* temp = head->next;
-
-    size_t iter = 0;
-
-    if (head->value != -1)
-    {
-      iter+=1;
-    }
-    while(current_head_id != temp->position)
-    {
-      if (temp->value == -1)
-      {
-        temp = temp->next;
-        continue;
-      }
-      temp = temp->next;
-      iter += 1;
-    }
-    return iter;
-  }
-
-  void findVictim(frame_id_t* value)
-  {
-    ClockSlot* temp = head;
-    ClockSlot* clockHead;
-
-    while(ticker_head_pos != temp->position) temp = temp->next;
-
-    clockHead = temp;
-
-    while(clockHead->ref_id)
-    {
-      clockHead->ref_id = false;
-      clockHead = clockHead->next;
-    }
-
-    *value = clockHead->value;
-    clockHead->value = -1;
-    if (size() == 0)
-    {
-      ticker_head_pos = 1;
-      return;
-    }
-
-    while (clockHead->next->value == -1)clockHead = clockHead->next;
-    ticker_head_pos = clockHead->next->position;
-
-  }
-
-
-  void remove(frame_id_t value)
-  {
-    ClockSlot* temp = head;
-    while ((temp->value != value))
-    {
-      temp = temp->next;
-    }
-    temp->value = -1;
-    temp->ref_id = false;
-    
-  }
-
-  bool already_present(frame_id_t value, frame_id_t mode)
-  {
-    ClockSlot* temp = head->next;
-
-    if(head->value == value) 
-    {
-      if (mode == 1)head->ref_id = true;
-      return true;
-    }
-
-    while((current_head_id != temp->position))
-    {
-      if (temp->value == value)
-      {
-        if (mode == 1)temp->ref_id = true;
-        return true;
-      }
-      temp = temp->next;
-    }
-    return false;
-  }
-  
-};
-
-
-
 /**
  * ClockReplacer implements the clock replacement policy, which approximates the Least Recently Used policy.
  */
@@ -198,6 +38,8 @@ class ClockReplacer : public Replacer {
 
   bool Victim(frame_id_t *frame_id) override;
 
+  bool PreferredVictim(frame_id_t *frame_id, const std::function<bool(frame_id_t)> &prefer) override;
+
   void Pin(frame_id_t frame_id) override;
 
   void Unpin(frame_id_t frame_id) override;
@@ -205,10 +47,21 @@ class ClockReplacer : public Replacer {
   size_t Size() override;
 
  private:
- Clock* clock;
- std::vector<frame_id_t> pages;
- std::mutex m;
-  // TODO(student): implement me!
+  /** Clock state of one frame. */
+  struct ClockSlot {
+    /** True if the frame is unpinned, i.e. a candidate for eviction. */
+    bool in_replacer_{false};
+    /** Reference bit, set on unpin and cleared when the clock hand passes. */
+    bool ref_{false};
+  };
+
+  /** One slot per frame id. Grows if a frame id beyond the initial capacity shows up. */
+  std::vector<ClockSlot> slots_;
+  /** Position of the clock hand. */
+  size_t hand_{0};
+  /** Number of frames in the replacer. */
+  size_t size_{0};
+  std::mutex latch_;
 };
 
 }  // namespace bustub
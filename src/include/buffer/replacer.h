@@ -12,6 +12,9 @@
 
 #pragma once
 
+#include <functional>
+#include <vector>
+
 #include "common/config.h"
 
 namespace bustub {
@@ -31,6 +34,29 @@ class Replacer {
    */
   virtual bool Victim(frame_id_t *frame_id) = 0;
 
+  /**
+   * Remove the victim frame as defined by the replacement policy, passing over the frames that prefer rejects. Those
+   * stay in the replacer. By default, the frames passed over are taken out with Victim() and unpinned again, which
+   * makes them recently used; replacers that can pass over frames in place override this.
+   * @param[out] frame_id id of frame that was removed
+   * @param prefer returns false for frames that should rather not be victimized now
+   * @return true if a victim frame was found, false otherwise
+   */
+  virtual bool PreferredVictim(frame_id_t *frame_id, const std::function<bool(frame_id_t)> &prefer) {
+    std::vector<frame_id_t> passed_over;
+    bool found = false;
+    for (size_t candidates = Size(); !found && candidates > 0 && Victim(frame_id); candidates--) {
+      found = prefer(*frame_id);
+      if (!found) {
+        passed_over.push_back(*frame_id);
+      }
+    }
+    for (frame_id_t passed : passed_over) {
+      Unpin(passed);
+    }
+    return found;
+  }
+
   /**
    * Pins a frame, indicating that it should not be victimized until it is unpinned.
    * @param frame_id the id of the frame to pin
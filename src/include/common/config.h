@@ -14,18 +14,43 @@
 
 #include <atomic>
 #include <chrono>  // NOLINT
+#include <cstddef>
 #include <cstdint>
 
 namespace bustub {
 
-/** Cycle detection is performed every CYCLE_DETECTION_INTERVAL milliseconds. */
+/** A transaction that waits for a lock this long looks for a deadlock it is part of, and again every interval. */
 extern std::chrono::milliseconds cycle_detection_interval;
 
+/**
+ * A transaction that locks more rows than this through one table has their locks replaced with a single lock on the
+ * table, see LockManager. 0 never escalates.
+ */
+extern std::atomic<size_t> lock_escalation_threshold;
+
 /** True if logging should be enabled, false otherwise. */
 extern std::atomic<bool> enable_logging;
 
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
-extern std::chrono::duration<int64_t> log_timeout;
+extern std::chrono::milliseconds log_timeout;
+
+/**
+ * Default commit mode of new transactions. True if Commit() returns once the COMMIT record is in the log buffer;
+ * the flush thread then makes it durable within LOG_TIMEOUT.
+ */
+extern std::atomic<bool> enable_async_commit;
+
+/** True if transactions buffer their log records privately and publish them at commit or on overflow. */
+extern std::atomic<bool> enable_private_log;
+
+/** True if updates are logged as a delta between the old and the new tuple instead of two full images. */
+extern std::atomic<bool> enable_delta_update;
+
+/** True if every flush of the log buffer is compressed before it is written to the log file. */
+extern std::atomic<bool> enable_log_compression;
+
+/** Number of threads that redo the log during recovery, partitioned by page id. 1 redoes it on the calling thread. */
+extern std::atomic<int> redo_threads;
 
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
@@ -34,12 +59,19 @@ static constexpr int HEADER_PAGE_ID = 0;                                      //
 static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
+static constexpr int TXN_LOG_BUFFER_SIZE = LOG_BUFFER_SIZE / 4;               // size of a private txn log buffer
+static constexpr int LOG_SEGMENT_SIZE = 16 * LOG_BUFFER_SIZE;                // size of a log segment file in byte
+static constexpr int LOG_SPARE_SEGMENTS = 2;                                  // recycled log segments kept for reuse
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int LOCK_TABLE_PARTITIONS = 16;                              // latched partitions of the lock table
+static constexpr int TXN_REGISTRY_SHARDS = 16;                                // shards of the transaction registry
+static constexpr int TXN_POOL_SIZE = 16;                                      // ended transactions kept per thread
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
 using txn_id_t = int32_t;      // transaction id type
 using lsn_t = int32_t;         // log sequence number type
+using timestamp_t = int64_t;   // commit timestamp type
 using slot_offset_t = size_t;  // slot offset type
 using oid_t = uint16_t;
 
@@ -0,0 +1,50 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lz_util.h
+//
+// Identification: src/include/common/util/lz_util.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+
+namespace bustub {
+
+/**
+ * LZUtil is a small LZ77 block codec in the style of LZ4, tuned for speed rather than ratio.
+ *
+ * A block is a sequence of
+ *  ------------------------------------------------------------------------------------
+ *  | token (1) | literal length (0+) | literals | offset (2) | match length (0+) |
+ *  ------------------------------------------------------------------------------------
+ * The high nibble of the token is the literal length and the low nibble the match length minus MIN_MATCH. A nibble
+ * of 15 is continued by bytes that are added to it, up to and including the first byte that is not 255. The last
+ * sequence of a block has literals only.
+ */
+class LZUtil {
+ public:
+  /**
+   * Compress size bytes of src into dst.
+   * @return the compressed size, or 0 if it would exceed capacity
+   */
+  static uint32_t Compress(const char *src, uint32_t size, char *dst, uint32_t capacity);
+
+  /**
+   * Decompress a block produced by Compress().
+   * @return true if the block is well-formed and decompresses to exactly dst_size bytes
+   */
+  static bool Decompress(const char *src, uint32_t size, char *dst, uint32_t dst_size);
+
+ private:
+  static constexpr uint32_t MIN_MATCH = 4;
+  static constexpr uint32_t MAX_OFFSET = UINT16_MAX;
+  static constexpr uint32_t HASH_BITS = 12;
+};
+
+}  // namespace bustub
@@ -0,0 +1,51 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// key_range.h
+//
+// Identification: src/include/concurrency/key_range.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "common/util/hash_util.h"
+
+namespace bustub {
+
+/**
+ * A key of an ordered index, or the gap between it and the key before it, as a resource for key-range locking, see
+ * LockManager. Index and key are named by hashes, so that two of them may share locks, which is safe.
+ */
+struct KeyRange {
+  /** The gap after the last key of an index. */
+  static constexpr hash_t END_OF_INDEX = ~static_cast<hash_t>(0);
+
+  /** Hash of the name of the index. */
+  hash_t index_;
+  /** Hash of the key, or END_OF_INDEX. */
+  hash_t key_;
+  /** True for the gap before the key, false for the key itself. */
+  bool gap_;
+
+  bool operator==(const KeyRange &other) const {
+    return index_ == other.index_ && key_ == other.key_ && gap_ == other.gap_;
+  }
+};
+
+}  // namespace bustub
+
+namespace std {
+
+/** Implements std::hash on KeyRange. */
+template <>
+struct hash<bustub::KeyRange> {
+  size_t operator()(const bustub::KeyRange &range) const {
+    return bustub::HashUtil::CombineHashes(bustub::HashUtil::CombineHashes(range.index_, range.key_), range.gap_);
+  }
+};
+
+}  // namespace std
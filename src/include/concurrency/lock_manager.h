@@ -13,6 +13,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>  // NOLINT
 #include <list>
 #include <memory>
@@ -31,55 +32,108 @@ class TransactionManager;
 /** Two-Phase Locking mode. */
 enum class TwoPLMode { REGULAR, STRICT };
 
-/** Deadlock mode. */
-enum class DeadlockMode { PREVENTION, DETECTION };
+/**
+ * Deadlock mode. The prevention policies compare the age of transactions, which is their id: a smaller id is older.
+ * WOUND_WAIT: an older transaction aborts the younger ones it would wait for, a younger one waits for older ones.
+ * WAIT_DIE: an older transaction waits for younger ones, a younger one aborts itself instead of waiting for older ones.
+ * DETECTION: every transaction waits. One that waits long looks for a waits-for cycle, and aborts its youngest member.
+ */
+enum class DeadlockMode { WOUND_WAIT, WAIT_DIE, DETECTION, PREVENTION = WOUND_WAIT };
+
+/** Counters of lock escalation, see LockManager. */
+struct LockEscalationStats {
+  /** Row locks replaced with a table lock, and the row locks released by that. */
+  uint64_t escalations_{0};
+  uint64_t released_rows_{0};
+  /** Escalations given up because another transaction held or waited for the table. */
+  uint64_t conflicts_{0};
+};
 
 /**
- * LockManager handles transactions asking for locks on records.
+ * LockManager handles transactions asking for locks on records and on tables.
+ *
+ * Locks follow the multi-granularity protocol. A table, named by the first page of its heap, can be locked in any
+ * LockMode, and a row in SHARED or EXCLUSIVE mode. Before it locks a row, a transaction locks the row's table in the
+ * matching intention mode or in a mode that covers the row itself, see TableHeap. A scan thus takes a single SHARED
+ * lock on its table, while point writers take INTENTION_EXCLUSIVE on the table and EXCLUSIVE on each row.
+ *
+ * Requests on one resource are granted in FIFO order. An upgrade goes ahead of the requests that wait.
+ *
+ * The lock table is split into hash partitions, each with its own latch, so that requests on different resources
+ * rarely contend. Waiting requests are granted by the transaction that releases the lock they wait for, which wakes up
+ * exactly the requests it grants.
+ *
+ * A row lock may name the table it is taken through. Once a transaction holds more than lock_escalation_threshold
+ * row locks through one table, they are escalated: its lock on the table turns into a SHARED or EXCLUSIVE one, which
+ * covers the rows, and the row locks are released. An escalation never waits. If another transaction holds or waits
+ * for the table in a conflicting mode, the row locks stay, and the next attempt comes after as many rows again.
+ *
+ * Ordered indexes lock key ranges instead of their tables to keep phantoms out of range scans (next-key locking). A
+ * KeyRange is either a key or the gap before it, and is locked SHARED or EXCLUSIVE until the transaction ends:
+ * - a range scan locks each key it returns together with the gap before it, except the first one if it is the low end
+ *   of the range, and the gap before the first key past the range, END_OF_INDEX if there is none;
+ * - a point lookup locks its key, or the gap before the next key if it is missing;
+ * - an insert locks the gap before the next key for an instant, see LockInsertGap(), then the new key together with
+ *   the gap before it; a delete locks its key together with the gap before it, which the delete merges into the next.
+ * A scan thus holds up the writers of its range and of the gap after it, and no other writer.
+ *
+ * The IsolationLevel of a transaction decides how long its shared locks last. READ_UNCOMMITTED transactions may not
+ * ask for any, and READ_COMMITTED ones release them after each read without entering their shrinking phase.
+ *
+ * See DeadlockMode for how deadlocks are dealt with. A transaction aborted while it waits returns from the lock call,
+ * otherwise its next lock call fails. Either way, the transaction has to be aborted by the caller.
  */
 class LockManager {
-  enum class LockMode { SHARED, EXCLUSIVE };
-
   class LockRequest {
    public:
-    LockRequest(txn_id_t txn_id, LockMode lock_mode) : txn_id_(txn_id), lock_mode_(lock_mode), granted_(false) {}
+    LockRequest(Transaction *txn, LockMode lock_mode)
+        : txn_(txn), txn_id_(txn->GetTransactionId()), lock_mode_(lock_mode), granted_(false) {}
 
+    Transaction *txn_;
     txn_id_t txn_id_;
     LockMode lock_mode_;
     bool granted_;
+    /** Wakes up the waiting transaction once the request is granted. */
+    std::condition_variable cv_;
   };
 
   class LockRequestQueue {
    public:
+    /** Granted requests come first, followed by those that wait. */
     std::list<LockRequest> request_queue_;
-    std::condition_variable cv_;  // for notifying blocked transactions on this rid
     bool upgrading_ = false;
   };
 
+  /** A hash partition of the lock table. */
+  struct alignas(64) LockTablePartition {
+    /** Protects the queues of the partition and every request in them. */
+    std::mutex latch_;
+    std::unordered_map<RID, LockRequestQueue> lock_table_;
+    /** Lock requests on tables, by the first page of the table's heap. */
+    std::unordered_map<page_id_t, LockRequestQueue> table_lock_table_;
+    /** Lock requests on keys of indexes and the gaps between them. */
+    std::unordered_map<KeyRange, LockRequestQueue> key_range_lock_table_;
+  };
+
+  /** The request that a transaction waits for. */
+  struct WaitingRequest {
+    LockTablePartition *partition_;
+    LockRequest *request_;
+  };
+
  public:
   /**
    * Creates a new lock manager configured for the given type of 2-phase locking and deadlock policy.
    * @param two_pl_mode 2-phase locking mode
    * @param deadlock_mode deadlock policy
+   * @param num_partitions number of hash partitions of the lock table
    */
-  explicit LockManager(TwoPLMode two_pl_mode, DeadlockMode deadlock_mode = DeadlockMode::PREVENTION)
-      : two_pl_mode_(two_pl_mode), deadlock_mode_(deadlock_mode) {
-    // If Detection() is enabled, we should launch a background cycle detection thread.
-    if (Detection()) {
-      enable_cycle_detection_ = true;
-      cycle_detection_thread_ = new std::thread(&LockManager::RunCycleDetection, this);
-      LOG_INFO("Cycle detection thread launched");
-    }
-  }
-
-  ~LockManager() {
-    if (Detection()) {
-      enable_cycle_detection_ = false;
-      cycle_detection_thread_->join();
-      delete cycle_detection_thread_;
-      LOG_INFO("Cycle detection thread stopped");
-    }
-  }
+  explicit LockManager(TwoPLMode two_pl_mode, DeadlockMode deadlock_mode = DeadlockMode::PREVENTION,
+                       size_t num_partitions = LOCK_TABLE_PARTITIONS)
+      : two_pl_mode_(two_pl_mode),
+        deadlock_mode_(deadlock_mode),
+        num_partitions_(num_partitions),
+        partitions_(new LockTablePartition[num_partitions]) {}
 
   /*
    * [LOCK_NOTE]: For all locking functions, we:
@@ -93,17 +147,19 @@ class LockManager {
    * Acquire a lock on RID in shared mode. See [LOCK_NOTE] in header file.
    * @param txn the transaction requesting the shared lock
    * @param rid the RID to be locked in shared mode
-   * @return true if the lock is granted, false otherwise
+   * @param table_id the first page of the heap of the table that the row is locked through, INVALID_PAGE_ID if none
+   * @return true if the lock is granted, false otherwise. Escalation may replace it with a table lock right away.
    */
-  bool LockShared(Transaction *txn, const RID &rid);
+  bool LockShared(Transaction *txn, const RID &rid, page_id_t table_id = INVALID_PAGE_ID);
 
   /**
    * Acquire a lock on RID in exclusive mode. See [LOCK_NOTE] in header file.
    * @param txn the transaction requesting the exclusive lock
    * @param rid the RID to be locked in exclusive mode
-   * @return true if the lock is granted, false otherwise
+   * @param table_id the first page of the heap of the table that the row is locked through, INVALID_PAGE_ID if none
+   * @return true if the lock is granted, false otherwise. Escalation may replace it with a table lock right away.
    */
-  bool LockExclusive(Transaction *txn, const RID &rid);
+  bool LockExclusive(Transaction *txn, const RID &rid, page_id_t table_id = INVALID_PAGE_ID);
 
   /**
    * Upgrade a lock from a shared lock to an exclusive lock.
@@ -121,6 +177,62 @@ class LockManager {
    */
   bool Unlock(Transaction *txn, const RID &rid);
 
+  /**
+   * Acquire a lock on a table, or upgrade the lock that the transaction holds on it to one that also covers lock_mode,
+   * e.g. SHARED_INTENTION_EXCLUSIVE for SHARED and INTENTION_EXCLUSIVE. See [LOCK_NOTE] in header file, except that
+   * locking a table again is allowed.
+   * @param txn the transaction requesting the lock
+   * @param lock_mode the mode to lock the table in
+   * @param table_id the first page of the table's heap
+   * @return true if the transaction holds a lock that covers lock_mode, false otherwise
+   */
+  bool LockTable(Transaction *txn, LockMode lock_mode, page_id_t table_id);
+
+  /**
+   * Release the lock held by the transaction on a table, after the locks it holds on the table's rows.
+   * @param txn the transaction releasing the lock
+   * @param table_id the first page of the table's heap
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockTable(Transaction *txn, page_id_t table_id);
+
+  /**
+   * Acquire a lock on a key of an index or the gap before it, or upgrade a SHARED lock that the transaction holds on
+   * it. See [LOCK_NOTE] in header file, except that locking a key range again is allowed.
+   * @param txn the transaction requesting the lock
+   * @param range the key or gap to lock
+   * @param lock_mode SHARED or EXCLUSIVE
+   * @return true if the transaction holds a lock that covers lock_mode, false otherwise
+   */
+  bool LockKeyRange(Transaction *txn, const KeyRange &range, LockMode lock_mode);
+
+  /**
+   * Wait until no other transaction holds a lock on a gap that a new key goes into, without keeping the lock. The
+   * key splits the gap, and its own lock protects the part before it from then on, so inserts into one gap only wait
+   * for the scans that hold it, not for each other. If the transaction holds a lock on the gap, it is upgraded.
+   * @param txn the transaction inserting a key
+   * @param gap the gap before the key that follows the new one
+   * @return true if the key may be inserted, false otherwise
+   */
+  bool LockInsertGap(Transaction *txn, const KeyRange &gap);
+
+  /**
+   * Release the lock held by the transaction on a key of an index or the gap before it.
+   * @param txn the transaction releasing the lock
+   * @param range the key or gap that is locked by the transaction
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockKeyRange(Transaction *txn, const KeyRange &range);
+
+  /** @return true if a lock in mode held covers a request for mode requested, i.e. grants at least its rights */
+  static bool Covers(LockMode held, LockMode requested) { return Combine(held, requested) == held; }
+
+  /** @return the weakest mode that covers both a and b */
+  static LockMode Combine(LockMode a, LockMode b);
+
+  /** @return true if two transactions can hold locks in modes a and b on the same resource */
+  static bool Compatible(LockMode a, LockMode b);
+
   /*** Graph API ***/
   /**
    * Adds edge t1->t2
@@ -142,24 +254,129 @@ class LockManager {
   /** @return the set of all edges in the graph, used for testing only! */
   std::vector<std::pair<txn_id_t, txn_id_t>> GetEdgeList();
 
-  /** Runs cycle detection in the background. */
-  void RunCycleDetection();
+  /** @return the counters of lock escalation */
+  LockEscalationStats GetEscalationStats() const {
+    LockEscalationStats stats;
+    stats.escalations_ = escalations_;
+    stats.released_rows_ = released_rows_;
+    stats.conflicts_ = escalation_conflicts_;
+    return stats;
+  }
 
  private:
-  TwoPLMode two_pl_mode_ __attribute__((__unused__));
+  TwoPLMode two_pl_mode_;
   DeadlockMode deadlock_mode_;
 
   bool Detection() { return deadlock_mode_ == DeadlockMode::DETECTION; }
-  bool Prevention() { return deadlock_mode_ == DeadlockMode::PREVENTION; }
+  bool Prevention() { return deadlock_mode_ != DeadlockMode::DETECTION; }
+
+  /**
+   * Check that the transaction may acquire a lock in lock_mode, aborting it if 2PL or its isolation level forbids
+   * that.
+   * @return false if the transaction is aborted
+   */
+  bool CanLock(Transaction *txn, LockMode lock_mode);
+
+  /** @return the partition of the lock table that holds the requests on rid */
+  LockTablePartition &GetPartition(const RID &rid) { return partitions_[PartitionOf(std::hash<RID>()(rid))]; }
+  /** @return the partition of the lock table that holds the requests on a table */
+  LockTablePartition &GetTablePartition(page_id_t table_id) {
+    return partitions_[PartitionOf(std::hash<page_id_t>()(table_id))];
+  }
+  /** @return the partition of the lock table that holds the requests on a key range */
+  LockTablePartition &GetKeyRangePartition(const KeyRange &range) {
+    return partitions_[PartitionOf(std::hash<KeyRange>()(range))];
+  }
+  /** @return the partition of a resource with the given hash, which may leave the low bits alike for many of them */
+  size_t PartitionOf(size_t hash) const { return ((hash * 0x9E3779B97F4A7C15ULL) >> 32) % num_partitions_; }
+
+  /**
+   * Queue a request of the transaction and wait until it is granted. lock holds the latch of the queue's partition,
+   * except while the transaction waits.
+   * @return false if the transaction was aborted, in which case the request is gone
+   */
+  bool Acquire(Transaction *txn, LockTablePartition *partition, LockRequestQueue *queue, LockMode lock_mode,
+               std::unique_lock<std::mutex> *lock);
+
+  /**
+   * Replace the granted request of the transaction with one in a stronger mode, ahead of the requests that wait.
+   * @return false if the transaction was aborted, in which case it keeps its old lock
+   */
+  bool Upgrade(Transaction *txn, LockTablePartition *partition, LockRequestQueue *queue, LockMode lock_mode,
+               std::unique_lock<std::mutex> *lock);
 
+  /**
+   * Apply the prevention policy to a request that is not granted: abort the younger transactions that it waits for
+   * under WOUND_WAIT, or its own transaction if it waits for an older one under WAIT_DIE. An upgrade also holds up
+   * the requests behind it, which may abort the upgrading transaction or the younger ones that wait.
+   */
+  void Prevent(LockTablePartition *partition, LockRequestQueue *queue, LockRequest *request,
+               std::unique_lock<std::mutex> *lock);
+
+  /**
+   * Wake up the transactions, which were aborted, if they wait for a lock. This releases lock for a while if one of
+   * them waits in another partition.
+   */
+  void WakeUp(const std::vector<txn_id_t> &victims, LockTablePartition *partition, std::unique_lock<std::mutex> *lock);
+
+  /**
+   * Wait until the request is granted or its transaction aborted. Under DETECTION, the request's edges are in the
+   * waits-for graph while it waits, and it looks for a deadlock every cycle_detection_interval.
+   */
+  void Wait(LockTablePartition *partition, LockRequestQueue *queue, LockRequest *request,
+            std::unique_lock<std::mutex> *lock);
+
+  /** Replace the edges of the request's transaction in the waits-for graph with those to the requests it waits for. */
+  void AddWaitEdges(const LockRequestQueue &queue, const LockRequest &request);
+
+  /**
+   * Look for a cycle of the waits-for graph through source, which is cheaper than HasCycle(): a cycle that forms
+   * goes through the transaction whose edge closes it.
+   * @param[out] txn_id if there is a cycle, the newest transaction ID in it
+   * @return true if there is a cycle
+   */
+  bool FindCycle(txn_id_t source, txn_id_t *txn_id);
+
+  /** Grant the waiting requests that are compatible with every granted one in FIFO order, and wake them up. */
+  void GrantWaiting(LockRequestQueue *queue);
+
+  /**
+   * Remove the request of the transaction and grant the requests that it held up.
+   * @return true if the queue is empty afterwards
+   */
+  bool Release(LockRequestQueue *queue, txn_id_t txn_id);
+
+  /**
+   * Move a growing transaction to its shrinking phase when it gives up a lock before it ends. Not called for the
+   * shared locks of READ_COMMITTED transactions, which only last for a read.
+   */
+  void Shrink(Transaction *txn);
+
+  /** Count a row lock granted through a table, and escalate the row locks of the table when there are too many. */
+  void AddRowLock(Transaction *txn, const RID &rid, page_id_t table_id);
+
+  /**
+   * Replace the row locks of the transaction through a table with a lock on the table, unless that has to wait.
+   * @return true if the row locks were escalated
+   */
+  bool Escalate(Transaction *txn, page_id_t table_id);
+
+  /** Protects waits_for_. Taken after a partition latch. */
   std::mutex latch_;
-  std::atomic<bool> enable_cycle_detection_;
-  std::thread *cycle_detection_thread_;
+  /** The transactions that wait for a lock, protected by waiting_latch_. Taken after a partition latch. */
+  std::mutex waiting_latch_;
+  std::unordered_map<txn_id_t, WaitingRequest> waiting_;
 
-  /** Lock table for lock requests. */
-  std::unordered_map<RID, LockRequestQueue> lock_table_;
-  /** Waits-for graph representation. */
+  /** Lock table for lock requests on rows, tables and key ranges, split into partitions. */
+  size_t num_partitions_;
+  std::unique_ptr<LockTablePartition[]> partitions_;
+  /** Waits-for graph representation, with an edge from each transaction that waits to those it waits for. */
   std::unordered_map<txn_id_t, std::vector<txn_id_t>> waits_for_;
+
+  /** See LockEscalationStats. */
+  std::atomic<uint64_t> escalations_{0};
+  std::atomic<uint64_t> released_rows_{0};
+  std::atomic<uint64_t> escalation_conflicts_{0};
 };
 
 }  // namespace bustub
@@ -15,11 +15,15 @@
 #include <atomic>
 #include <deque>
 #include <memory>
+#include <mutex>   // NOLINT
 #include <thread>  // NOLINT
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "common/config.h"
 #include "common/logger.h"
+#include "concurrency/key_range.h"
 #include "storage/page/page.h"
 #include "storage/table/tuple.h"
 
@@ -36,12 +40,39 @@ namespace bustub {
  **/
 enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
+/**
+ * Lock modes. Rows are locked SHARED or EXCLUSIVE. A table may also be locked with an intention mode, which announces
+ * row locks of the matching mode on the table: INTENTION_SHARED for SHARED row locks, INTENTION_EXCLUSIVE for
+ * EXCLUSIVE ones, and SHARED_INTENTION_EXCLUSIVE for reading the whole table while locking rows to change them.
+ */
+enum class LockMode { SHARED, EXCLUSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED_INTENTION_EXCLUSIVE };
+
+/**
+ * How a transaction is isolated from concurrent ones.
+ * LOCKING: two-phase locking of every row and table read or written, see LockManager.
+ * SNAPSHOT: snapshot isolation. Reads see the database as of the start of the transaction and take no locks, see
+ * VersionStore. Writes lock rows exclusively, and fail if another transaction wrote the row after the snapshot.
+ * OPTIMISTIC: reads see a snapshot too and remember the rows they read. Writes stay in the write set until commit,
+ * which validates that no other transaction wrote those rows since the snapshot, and only then applies them.
+ */
+enum class ConcurrencyControl { LOCKING, SNAPSHOT, OPTIMISTIC };
+
+/**
+ * Isolation levels of a LOCKING transaction, which decide how long its reads keep their locks. Writes always lock
+ * their rows exclusively until the transaction ends.
+ * READ_UNCOMMITTED: reads take no locks, and see rows that other transactions have not committed.
+ * READ_COMMITTED: reads lock a row while they read it, so they see committed rows, but may see a row change.
+ * REPEATABLE_READ: rows read stay locked until the transaction ends, and scans lock their table. Serializable.
+ */
+enum class IsolationLevel { READ_UNCOMMITTED, READ_COMMITTED, REPEATABLE_READ };
+
 /**
  * Type of write operation.
  */
 enum class WType { INSERT = 0, DELETE, UPDATE };
 
 class TableHeap;
+class VersionStore;
 
 /**
  * WriteRecord tracks information related to a write.
@@ -53,7 +84,7 @@ class WriteRecord {
 
   RID rid_;
   WType wtype_;
-  /** The tuple is only used for the update operation. */
+  /** The old tuple of an update, or the new tuple of a write that an optimistic transaction buffers. */
   Tuple tuple_;
   /** The table heap specifies which table this write record is for. */
   TableHeap *table_;
@@ -63,14 +94,22 @@ class WriteRecord {
  * Transaction tracks information related to a transaction.
  */
 class Transaction {
+  // The log manager owns the layout of the private log buffer.
+  friend class LogManager;
+
  public:
   explicit Transaction(txn_id_t txn_id)
       : state_(TransactionState::GROWING),
         thread_id_(std::this_thread::get_id()),
         txn_id_(txn_id),
         prev_lsn_(INVALID_LSN),
+        async_commit_(enable_async_commit),
         shared_lock_set_{new std::unordered_set<RID>},
-        exclusive_lock_set_{new std::unordered_set<RID>} {
+        exclusive_lock_set_{new std::unordered_set<RID>},
+        table_lock_set_{new std::unordered_map<page_id_t, LockMode>},
+        table_row_lock_set_{new std::unordered_map<page_id_t, std::vector<RID>>},
+        key_range_lock_set_{new std::unordered_map<KeyRange, LockMode>},
+        read_set_{new std::unordered_set<RID>} {
     // Initialize the sets that will be tracked.
     write_set_ = std::make_shared<std::deque<WriteRecord>>();
     page_set_ = std::make_shared<std::deque<bustub::Page *>>();
@@ -81,6 +120,34 @@ class Transaction {
 
   DISALLOW_COPY(Transaction);
 
+  /**
+   * Make a transaction that committed or aborted ready to begin again under a new ID. The sets are cleared, not
+   * freed, and the private log buffer is kept.
+   * @param txn_id the new id of the transaction
+   */
+  void Reset(txn_id_t txn_id) {
+    BUSTUB_ASSERT(log_record_count_ == 0 && log_pages_.empty(), "Resetting a transaction with an unpublished log.");
+    state_ = TransactionState::GROWING;
+    thread_id_ = std::this_thread::get_id();
+    txn_id_ = txn_id;
+    prev_lsn_ = INVALID_LSN;
+    async_commit_ = enable_async_commit;
+    concurrency_control_ = ConcurrencyControl::LOCKING;
+    isolation_level_ = IsolationLevel::REPEATABLE_READ;
+    version_store_ = nullptr;
+    read_ts_ = 0;
+    write_phase_ = false;
+    write_set_->clear();
+    page_set_->clear();
+    deleted_page_set_->clear();
+    shared_lock_set_->clear();
+    exclusive_lock_set_->clear();
+    table_lock_set_->clear();
+    table_row_lock_set_->clear();
+    key_range_lock_set_->clear();
+    read_set_->clear();
+  }
+
   /** @return the id of the thread running the transaction */
   inline std::thread::id GetThreadId() const { return thread_id_; }
 
@@ -114,6 +181,17 @@ class Transaction {
   /** @return the set of resources under an exclusive lock */
   inline std::shared_ptr<std::unordered_set<RID>> GetExclusiveLockSet() { return exclusive_lock_set_; }
 
+  /** @return the tables under a lock, named by the first page of their heap, with the mode of the lock */
+  inline std::shared_ptr<std::unordered_map<page_id_t, LockMode>> GetTableLockSet() { return table_lock_set_; }
+
+  /** @return the rows locked through each table, some of which may be unlocked since */
+  inline std::shared_ptr<std::unordered_map<page_id_t, std::vector<RID>>> GetTableRowLockSet() {
+    return table_row_lock_set_;
+  }
+
+  /** @return the keys and gaps of indexes under a lock, with the mode of the lock */
+  inline std::shared_ptr<std::unordered_map<KeyRange, LockMode>> GetKeyRangeLockSet() { return key_range_lock_set_; }
+
   /** @return true if rid is shared locked by this transaction */
   bool IsSharedLocked(const RID &rid) { return shared_lock_set_->find(rid) != shared_lock_set_->end(); }
 
@@ -129,6 +207,15 @@ class Transaction {
    */
   inline void SetState(TransactionState state) { state_ = state; }
 
+  /**
+   * Abort the transaction on behalf of another one, unless it has already left the growing phase.
+   * @return true if the transaction was growing and is aborted now
+   */
+  inline bool Wound() {
+    TransactionState growing = TransactionState::GROWING;
+    return state_.compare_exchange_strong(growing, TransactionState::ABORTED);
+  }
+
   /** @return the previous LSN */
   inline lsn_t GetPrevLSN() { return prev_lsn_; }
 
@@ -138,9 +225,59 @@ class Transaction {
    */
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  /** @return true if Commit() returns without waiting for the COMMIT record to become durable */
+  inline bool IsAsyncCommit() const { return async_commit_; }
+
+  /**
+   * Choose the commit mode of this transaction, overriding enable_async_commit.
+   * @param async_commit true to return from Commit() once the COMMIT record is in the log buffer
+   */
+  inline void SetAsyncCommit(bool async_commit) { async_commit_ = async_commit; }
+
+  /** @return how the transaction is isolated from concurrent ones */
+  inline ConcurrencyControl GetConcurrencyControl() const { return concurrency_control_; }
+
+  /** @return the isolation level of the transaction, which only matters under LOCKING */
+  inline IsolationLevel GetIsolationLevel() const { return isolation_level_; }
+
+  /** Set the isolation level of the transaction before it reads anything. */
+  inline void SetIsolationLevel(IsolationLevel isolation_level) { isolation_level_ = isolation_level; }
+
+  /** @return true if the transaction reads a snapshot, which an optimistic one does too */
+  inline bool IsSnapshot() const { return concurrency_control_ != ConcurrencyControl::LOCKING; }
+
+  /** @return true if the transaction validates its reads at commit */
+  inline bool IsOptimistic() const { return concurrency_control_ == ConcurrencyControl::OPTIMISTIC; }
+
+  /** @return true if writes only go to the write set, because the transaction has not been validated yet */
+  inline bool BuffersWrites() const { return IsOptimistic() && !write_phase_; }
+
+  /** Let a validated optimistic transaction apply its writes. */
+  inline void StartWritePhase() { write_phase_ = true; }
+
+  /** @return the rows that an optimistic transaction read */
+  inline std::shared_ptr<std::unordered_set<RID>> GetReadSet() { return read_set_; }
+
+  /** @return the commit timestamp of the newest transaction that a snapshot transaction sees */
+  inline timestamp_t GetReadTimestamp() const { return read_ts_; }
+
+  /** @return the store that keeps the row versions the transaction overwrites, nullptr if none */
+  inline VersionStore *GetVersionStore() const { return version_store_; }
+
+  /**
+   * Set up the concurrency control of a new transaction, see TransactionManager::Begin().
+   * @param read_ts the read timestamp of a snapshot transaction
+   */
+  inline void SetConcurrencyControl(ConcurrencyControl concurrency_control, VersionStore *version_store,
+                                    timestamp_t read_ts) {
+    concurrency_control_ = concurrency_control;
+    version_store_ = version_store;
+    read_ts_ = read_ts;
+  }
+
  private:
-  /** The current transaction state. */
-  TransactionState state_;
+  /** The current transaction state. Other transactions abort this one to break deadlocks, see Wound(). */
+  std::atomic<TransactionState> state_;
   /** The thread ID, used in single-threaded transactions. */
   std::thread::id thread_id_;
   /** The ID of this transaction. */
@@ -148,8 +285,28 @@ class Transaction {
 
   /** The undo set of the transaction. */
   std::shared_ptr<std::deque<WriteRecord>> write_set_;
-  /** The LSN of the last record written by the transaction. */
-  lsn_t prev_lsn_;
+  /** The LSN of the last record written by the transaction. Records still in the private log buffer have none. */
+  std::atomic<lsn_t> prev_lsn_;
+  /** True if the commit does not wait for the log; the flush thread makes it durable within log_timeout. */
+  bool async_commit_;
+  ConcurrencyControl concurrency_control_{ConcurrencyControl::LOCKING};
+  IsolationLevel isolation_level_{IsolationLevel::REPEATABLE_READ};
+  VersionStore *version_store_{nullptr};
+  timestamp_t read_ts_{0};
+  /** True once an optimistic transaction passed validation. */
+  bool write_phase_{false};
+
+  /** Private log buffer: serialized records that are not published yet. Allocated on first use. */
+  std::unique_ptr<char[]> log_buffer_;
+  /** Bytes and number of records in the private log buffer. */
+  uint32_t log_buffer_size_{0};
+  uint32_t log_record_count_{0};
+  /** True if the last record in the private log buffer is the COMMIT or ABORT record of the transaction. */
+  bool log_end_buffered_{false};
+  /** Protects the private log buffer; the buffer pool may publish it to honor the WAL rule. */
+  std::mutex log_latch_;
+  /** Pages registered with the log manager as carrying changes logged in the private buffer. */
+  std::unordered_set<page_id_t> log_pages_;
 
   /** Concurrent index: the pages that were latched during index operation. */
   std::shared_ptr<std::deque<Page *>> page_set_;
@@ -160,6 +317,14 @@ class Transaction {
   std::shared_ptr<std::unordered_set<RID>> shared_lock_set_;
   /** LockManager: the set of exclusive-locked tuples held by this transaction. */
   std::shared_ptr<std::unordered_set<RID>> exclusive_lock_set_;
+  /** LockManager: the tables locked by this transaction, with the mode of each lock. */
+  std::shared_ptr<std::unordered_map<page_id_t, LockMode>> table_lock_set_;
+  /** LockManager: the rows locked through each table, which lock escalation replaces with a table lock. */
+  std::shared_ptr<std::unordered_map<page_id_t, std::vector<RID>>> table_row_lock_set_;
+  /** LockManager: the keys and gaps of indexes locked by this transaction, with the mode of each lock. */
+  std::shared_ptr<std::unordered_map<KeyRange, LockMode>> key_range_lock_set_;
+  /** Optimistic concurrency control: the rows read, which nobody may have written since the snapshot. */
+  std::shared_ptr<std::unordered_set<RID>> read_set_;
 };
 
 }  // namespace bustub
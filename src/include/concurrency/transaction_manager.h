@@ -13,12 +13,15 @@
 #pragma once
 
 #include <atomic>
-#include <unordered_map>
+#include <mutex>  // NOLINT
 #include <unordered_set>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
+#include "concurrency/transaction_registry.h"
+#include "concurrency/version_store.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
@@ -36,14 +39,18 @@ class TransactionManager {
 
   /**
    * Begins a new transaction.
-   * @param txn an optional transaction object to be initialized, otherwise a new transaction is created
+   * @param txn an optional transaction object to be initialized, otherwise one is taken from the pool of the calling
+   * thread, see Recycle(), or created
+   * @param concurrency_control how the transaction is isolated from concurrent ones
+   * @param isolation_level how long the reads of a LOCKING transaction keep their locks
    * @return an initialized transaction
    */
-  Transaction *Begin(Transaction *txn = nullptr);
+  Transaction *Begin(Transaction *txn = nullptr, ConcurrencyControl concurrency_control = ConcurrencyControl::LOCKING,
+                     IsolationLevel isolation_level = IsolationLevel::REPEATABLE_READ);
 
   /**
-   * Commits a transaction.
-   * @param txn the transaction to commit
+   * Commits a transaction. An optimistic transaction that fails validation is aborted instead.
+   * @param txn the transaction to commit, ABORTED afterwards if it could not commit
    */
   void Commit(Transaction *txn);
 
@@ -54,20 +61,25 @@ class TransactionManager {
   void Abort(Transaction *txn);
 
   /**
-   * Global list of running transactions
+   * Hand a transaction that committed or aborted back to the pool of the calling thread, in place of deleting it. The
+   * next Begin() on the thread reuses it, so that a steady stream of transactions does not allocate them.
+   * @param txn the transaction, which the caller must not use any more
    */
+  static void Recycle(Transaction *txn);
 
-  /** The transaction map is a global list of all the running transactions in the system. */
-  static std::unordered_map<txn_id_t, Transaction *> txn_map;
+  /** @return the store of old row versions for snapshot transactions */
+  VersionStore *GetVersionStore() { return &version_store_; }
+
+  /** The running transactions in the system. Transactions leave it when they commit or abort. */
+  static TransactionRegistry txn_registry;
 
   /**
-   * Locates and returns the transaction with the given transaction ID.
-   * @param txn_id the id of the transaction to be found, it must exist!
+   * Locates and returns the transaction with the given transaction ID, without taking a latch.
+   * @param txn_id the id of the transaction to be found, it must be running!
    * @return the transaction with the given transaction id
    */
   static Transaction *GetTransaction(txn_id_t txn_id) {
-    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-    auto *res = TransactionManager::txn_map[txn_id];
+    auto *res = txn_registry.Find(txn_id);
     assert(res != nullptr);
     return res;
   }
@@ -79,6 +91,12 @@ class TransactionManager {
   void ResumeTransactions();
 
  private:
+  /**
+   * Validate an optimistic transaction and apply the writes that it buffered.
+   * @return false if the transaction was aborted
+   */
+  bool ApplyBufferedWrites(Transaction *txn);
+
   /**
    * Releases all the locks held by the given transaction.
    * @param txn the transaction whose locks should be released
@@ -94,11 +112,30 @@ class TransactionManager {
     for (auto locked_rid : lock_set) {
       lock_manager_->Unlock(txn, locked_rid);
     }
+    std::vector<KeyRange> key_ranges;
+    for (const auto &item : *txn->GetKeyRangeLockSet()) {
+      key_ranges.push_back(item.first);
+    }
+    for (const auto &range : key_ranges) {
+      lock_manager_->UnlockKeyRange(txn, range);
+    }
+    // Tables last: their locks protect the row locks.
+    std::vector<page_id_t> tables;
+    for (const auto &item : *txn->GetTableLockSet()) {
+      tables.push_back(item.first);
+    }
+    for (page_id_t table_id : tables) {
+      lock_manager_->UnlockTable(txn, table_id);
+    }
   }
 
   std::atomic<txn_id_t> next_txn_id_{0};
-  LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
+  LockManager *lock_manager_;
+  LogManager *log_manager_;
+  /** Old versions of the rows that transactions of this manager write. */
+  VersionStore version_store_;
+  /** Optimistic transactions validate and apply their writes one at a time, so that each sees those before. */
+  std::mutex validation_latch_;
 
   /** The global transaction latch is used for checkpointing. */
   ReaderWriterLatch global_txn_latch_;
@@ -0,0 +1,121 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry.h
+//
+// Identification: src/include/concurrency/transaction_registry.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+class Transaction;
+
+/**
+ * TransactionRegistry maps the IDs of running transactions to the transactions. It does not own them: a transaction
+ * is registered when it begins and removed when it ends, so the registry only grows with the number of transactions
+ * that run at the same time.
+ *
+ * IDs are spread over shards by hash. Each shard is an open-addressing hash table that writers change under the
+ * shard's latch, and that lookups read without any latch. A writer that grows, shrinks or cleans up a table swaps in
+ * a new one and retires the old one, which is freed once no lookup can still read it. Lookups announce themselves in
+ * one of two reader counters of the shard, picked by the parity of the shard's epoch. The epoch only moves on once
+ * the counter that it is about to reuse has drained, so a table retired in an epoch is free to go two epochs later.
+ */
+class TransactionRegistry {
+ public:
+  /** @param num_shards number of shards, each with its own latch for writers, a power of two */
+  explicit TransactionRegistry(size_t num_shards = TXN_REGISTRY_SHARDS);
+
+  ~TransactionRegistry();
+
+  DISALLOW_COPY(TransactionRegistry);
+
+  /** Add a transaction, replacing the one registered under its ID if there is one. */
+  void Register(Transaction *txn);
+
+  /** Remove the transaction with the given ID, if it is registered. */
+  void Remove(txn_id_t txn_id);
+
+  /** @return the transaction with the given ID, nullptr if none is registered. Takes no latch. */
+  Transaction *Find(txn_id_t txn_id);
+
+  /** @return the number of registered transactions */
+  size_t Size();
+
+  /** @return the number of slots in the hash tables of all shards, retired ones included */
+  size_t GetCapacity();
+
+ private:
+  /** Marks a slot that never held a transaction, where a lookup stops. */
+  static constexpr txn_id_t EMPTY = INVALID_TXN_ID;
+  /** Marks a slot whose transaction was removed, which a lookup moves past. */
+  static constexpr txn_id_t TOMBSTONE = INVALID_TXN_ID - 1;
+  static constexpr size_t MIN_CAPACITY = 16;
+
+  struct Slot {
+    /** Set after txn_ when a transaction is registered, and before it is cleared when the transaction is removed. */
+    std::atomic<txn_id_t> txn_id_{EMPTY};
+    std::atomic<Transaction *> txn_{nullptr};
+  };
+
+  struct Table {
+    explicit Table(size_t capacity) : capacity_(capacity), slots_(new Slot[capacity]) {}
+
+    /** A power of two. */
+    size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+  };
+
+  struct alignas(64) Shard {
+    /** Protects the members below, except those that lookups read. */
+    std::mutex latch_;
+    std::atomic<Table *> table_{nullptr};
+    /** Slots that hold a transaction, and those that hold one or a tombstone. */
+    size_t live_{0};
+    size_t used_{0};
+    /** Lookups read the epoch and count themselves in the reader counter of its parity. */
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<uint64_t> readers_[2];
+    /** Tables that lookups may still read, with the epoch they were retired in. */
+    std::vector<std::pair<uint64_t, Table *>> retired_;
+  };
+
+  /** @return the shard of a transaction ID */
+  Shard &GetShard(txn_id_t txn_id) { return shards_[static_cast<size_t>(txn_id) & (num_shards_ - 1)]; }
+
+  /** @return the first slot to probe for a transaction ID in a table */
+  size_t HomeSlot(txn_id_t txn_id, const Table &table) const {
+    return ((static_cast<uint64_t>(txn_id) >> shard_bits_) * 0x9E3779B97F4A7C15ULL >> 16) & (table.capacity_ - 1);
+  }
+
+  /** @return the slot of the transaction ID in the table, or nullptr. The caller holds the shard's latch. */
+  Slot *FindSlot(Table *table, txn_id_t txn_id);
+
+  /** Move the live transactions of the shard to a new table that fits them, and retire the old one. */
+  void Rebuild(Shard *shard);
+
+  /** Advance the epoch of the shard if that is safe, and free the tables that no lookup reads any more. */
+  void Reclaim(Shard *shard);
+
+  size_t num_shards_;
+  /** The number of low bits of a transaction ID that pick its shard. */
+  int shard_bits_{0};
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace bustub
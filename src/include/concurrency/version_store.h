@@ -0,0 +1,141 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// version_store.h
+//
+// Identification: src/include/concurrency/version_store.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <deque>
+#include <limits>
+#include <mutex>  // NOLINT
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/** Which version of a row a snapshot sees. */
+enum class VersionVisibility { CURRENT, OLD, NONE };
+
+/**
+ * VersionStore keeps the old versions of rows for transactions that read a snapshot, see ConcurrencyControl.
+ *
+ * Table pages only hold the newest version of each row, which may not be committed yet. Every transaction that writes a
+ * row first hands the version it overwrites to the store, together with the commit timestamp of that version. The
+ * versions of one row form a chain, from which a snapshot picks the newest one committed at or before its read
+ * timestamp. A row without a chain was committed before every snapshot.
+ *
+ * Once every snapshot sees the newest committed version of a row, its older versions are dropped. Writers add
+ * versions under the write latch of the row's page, and snapshot reads look them up under its read latch.
+ */
+class VersionStore {
+ public:
+  VersionStore() = default;
+
+  DISALLOW_COPY(VersionStore);
+
+  /** @return the read timestamp of a new snapshot, which sees every transaction committed so far */
+  timestamp_t BeginSnapshot();
+
+  /** End a snapshot, so that the versions only it sees can go. */
+  void EndSnapshot(timestamp_t read_ts);
+
+  /**
+   * Check that a snapshot transaction may overwrite a row: another transaction may not have written it after the
+   * snapshot was taken, or be writing it now. The first writer wins.
+   * @return true if the transaction may write the row
+   */
+  bool CanWrite(Transaction *txn, const RID &rid);
+
+  /**
+   * Validate an optimistic transaction: nobody may have written the rows in its read set or its write set after the
+   * snapshot was taken, or be writing them now.
+   * @return true if the transaction may commit
+   */
+  bool Validate(Transaction *txn);
+
+  /**
+   * Keep the version of a row that a transaction is about to overwrite, unless the transaction wrote the row before.
+   * @param before the current version of the row, nullptr if there is none because the transaction inserts it
+   */
+  void AddVersion(Transaction *txn, const RID &rid, const Tuple *before);
+
+  /**
+   * Find the version of a row that a snapshot transaction sees.
+   * @param[out] tuple the version if it is OLD
+   * @return CURRENT if the transaction sees the version on the page, which may be deleted, OLD if it sees the one
+   * returned in tuple, NONE if the row did not exist yet
+   */
+  VersionVisibility GetVersion(Transaction *txn, const RID &rid, Tuple *tuple);
+
+  /** Make the rows that a transaction wrote visible to new snapshots, at a new commit timestamp. */
+  void Commit(Transaction *txn);
+
+  /** Forget the versions that a transaction added, after it has rolled back its writes on the table pages. */
+  void Abort(Transaction *txn);
+
+  /** @return the number of rows with old versions */
+  size_t GetVersionedRowCount();
+
+ private:
+  struct UndoVersion {
+    /** Commit timestamp of the version, PENDING_TS until the transaction that removed the row is done. */
+    timestamp_t ts_;
+    /** False if the row did not exist at the time. */
+    bool exists_;
+    Tuple tuple_;
+    /** The transaction that freed the slot of the row before another one reused it, see AddVersion(). */
+    txn_id_t pending_{INVALID_TXN_ID};
+  };
+
+  struct VersionChain {
+    /** The transaction that wrote the version on the page and has not committed yet, INVALID_TXN_ID if none. */
+    txn_id_t writer_{INVALID_TXN_ID};
+    /** Commit timestamp of the version on the page, unless it has a writer. */
+    timestamp_t ts_{0};
+    /** Older versions, the newest last. */
+    std::vector<UndoVersion> undo_;
+  };
+
+  /** No snapshot sees a version with this timestamp. */
+  static constexpr timestamp_t PENDING_TS = std::numeric_limits<timestamp_t>::max();
+
+  /** @return the version that the slot of a row was empty at after txn_id freed it, undo_.end() if there is none */
+  static std::vector<UndoVersion>::iterator FindPending(VersionChain *chain, txn_id_t txn_id);
+
+  /** @return true if no other transaction wrote the row after the snapshot of txn, or is writing it */
+  bool IsUnchanged(Transaction *txn, const RID &rid);
+
+  /** @return the oldest read timestamp that a snapshot may still use */
+  timestamp_t Watermark();
+
+  /** Drop the versions of rows committed before every snapshot. */
+  void CollectGarbage();
+
+  /** Protects the members below. */
+  std::mutex latch_;
+  timestamp_t last_commit_ts_{0};
+  /** Read timestamps of the running snapshots. */
+  std::multiset<timestamp_t> snapshots_;
+  std::unordered_map<RID, VersionChain> chains_;
+  /** The rows that each running transaction has written. */
+  std::unordered_map<txn_id_t, std::vector<RID>> writes_;
+  /** Rows written by committed transactions, by commit timestamp, whose chains may still have to go. */
+  std::deque<std::pair<timestamp_t, std::vector<RID>>> committed_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,122 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// backup_manager.h
+//
+// Identification: src/include/recovery/backup_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "recovery/log_recovery.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/** Counters of one backup taken by a BackupManager. */
+struct BackupStats {
+  /** Every change logged before this LSN was on disk when the backup started. The next increment builds on it. */
+  lsn_t backup_lsn_{INVALID_LSN};
+  /** The first and the last LSN of the log in the backup. A restore brings the database up to the last one. */
+  lsn_t start_lsn_{INVALID_LSN};
+  lsn_t end_lsn_{INVALID_LSN};
+  /** Pages read from the database file, and pages written to the backup. */
+  uint64_t pages_read_{0};
+  uint64_t pages_written_{0};
+  /** Pages read again because two reads differed while the database wrote them. */
+  uint64_t page_rereads_{0};
+  /** Bytes of log blocks written to the backup. */
+  uint64_t log_bytes_{0};
+  /** Time spent waiting to stay below the read rate. */
+  uint64_t throttle_ns_{0};
+};
+
+/**
+ * On-disk header of a backup file, written last so that an interrupted backup is never restored. The header is
+ * followed by entries, each a uint32_t type and then either a page id and PAGE_SIZE bytes of page, or a log block
+ * with its LogBlockHeader.
+ */
+struct BackupHeader {
+  static constexpr uint32_t MAGIC = 0x42555442;
+  static constexpr uint32_t ENTRY_PAGE = 1;
+  static constexpr uint32_t ENTRY_LOG_BLOCK = 2;
+
+  /** MAGIC once the backup is complete. */
+  uint32_t magic_;
+  /** The backup LSN of the backup this one is an increment of, INVALID_LSN for a full backup. */
+  lsn_t base_lsn_;
+  /** See BackupStats. */
+  lsn_t backup_lsn_;
+  /** The first and the last LSN of the log in the backup. */
+  lsn_t start_lsn_;
+  lsn_t end_lsn_;
+  /** The master record of the database when the backup started, INVALID_LSN if there was none. */
+  lsn_t checkpoint_lsn_;
+};
+
+/**
+ * BackupManager takes full and incremental page-level backups of a database that may be running, in this process or
+ * another one. It reads the database file sequentially through a DiskManager of its own, so it takes no latch that
+ * the buffer pool or the log manager hold, and it can throttle its reads.
+ *
+ * A backup starts with an analysis pass over the log. Its redo LSN becomes the backup LSN: every change logged before
+ * it was on disk at that point, so a page whose LSN is below the backup LSN of the base backup has not changed since.
+ * An incremental backup only holds the other pages, and those that carry no LSN at all. Pages read while the database
+ * writes them may be out of date, so the backup also copies the log that recovery needs, up to the last block written
+ * while it read the pages, and a restore finishes with regular recovery from the checkpoint of the last backup.
+ *
+ * Taking a checkpoint right before a backup keeps both the log that it copies and the next increment small.
+ */
+class BackupManager {
+ public:
+  /** @param db_file the database file to back up, with its log segments next to it */
+  explicit BackupManager(const std::string &db_file);
+
+  ~BackupManager();
+
+  DISALLOW_COPY(BackupManager);
+
+  /**
+   * Write a backup of the database to backup_file.
+   * @param base_lsn the backup LSN of the previous backup to take an increment of it, INVALID_LSN for a full backup
+   * @param bytes_per_second the rate limit for reading the database file, 0 for none
+   * @return the counters of the backup, including its backup LSN
+   */
+  BackupStats Backup(const std::string &backup_file, lsn_t base_lsn = INVALID_LSN, uint64_t bytes_per_second = 0);
+
+  /**
+   * Create db_file from a full backup and the increments taken after it, oldest first. Recovery has to run on the
+   * database before it is used, from the log of the last backup.
+   * @throw Exception if a backup is incomplete or does not build on the one before it
+   */
+  static void Restore(const std::vector<std::string> &backup_files, const std::string &db_file);
+
+ private:
+  /** Read the page twice until both reads agree, so that no write of the database tears it. */
+  void ReadPage(page_id_t page_id, char *data, BackupStats *stats);
+
+  /**
+   * Append the log blocks that follow the last one copied to the backup, starting with the oldest segment.
+   * @throw Exception if segments were recycled before they were copied
+   */
+  void CopyLog(std::ofstream *out, BackupStats *stats);
+
+  std::unique_ptr<DiskManager> disk_manager_;
+  /** Reads log block headers and runs the analysis pass. */
+  std::unique_ptr<LogRecovery> log_reader_;
+
+  /** Log offset and first LSN of the next block to copy. */
+  int log_offset_{-1};
+  lsn_t next_lsn_{INVALID_LSN};
+};
+
+}  // namespace bustub
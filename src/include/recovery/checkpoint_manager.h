@@ -12,14 +12,31 @@
 
 #pragma once
 
+#include <mutex>  // NOLINT
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
 
+/** Counters of the fuzzy checkpoints taken by a CheckpointManager. */
+struct CheckpointStats {
+  uint64_t checkpoints_{0};
+  /** Pages written back by checkpoints. */
+  uint64_t pages_flushed_{0};
+  /** Total and longest duration of a checkpoint. */
+  uint64_t total_ns_{0};
+  uint64_t max_ns_{0};
+};
+
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily. Recovery starts at
+ * the last checkpoint, and the log segments before it are recycled.
+ *
+ * FuzzyCheckpoint() takes an ARIES checkpoint instead, which never blocks transactions: it writes back the dirty pages
+ * one at a time, then logs BEGIN_CHECKPOINT and an END_CHECKPOINT record that carries the active transaction table and
+ * the dirty page table.
  */
 class CheckpointManager {
  public:
@@ -34,10 +51,20 @@ class CheckpointManager {
   void BeginCheckpoint();
   void EndCheckpoint();
 
+  /** Take a fuzzy checkpoint while transactions keep running. */
+  void FuzzyCheckpoint();
+
+  /** @return a snapshot of the fuzzy checkpoint counters */
+  CheckpointStats GetStats();
+
  private:
-  TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+
+  /** Serializes fuzzy checkpoints and protects stats_. */
+  std::mutex latch_;
+  CheckpointStats stats_;
 };
 
 }  // namespace bustub
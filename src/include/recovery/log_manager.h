@@ -13,32 +13,75 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>  // NOLINT
 #include <future>              // NOLINT
 #include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "concurrency/transaction.h"
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
 
 namespace bustub {
 
+/** Counters of the log block writer, see enable_log_compression. */
+struct LogCompressionStats {
+  /** Blocks written, and how many of them were stored compressed. */
+  uint64_t blocks_{0};
+  uint64_t compressed_blocks_{0};
+  /** Bytes of log records handed to the writer, and bytes that reached the log file including block headers. */
+  uint64_t raw_bytes_{0};
+  uint64_t written_bytes_{0};
+  /** Time spent compressing. */
+  uint64_t compress_ns_{0};
+};
+
 /**
  * LogManager maintains a separate thread that is awakened whenever the log buffer is full or whenever a timeout
  * happens. When the thread is awakened, the log buffer's content is written into the disk log file.
+ *
+ * Appenders do not take a latch. Each one reserves its LSN and its byte range in the log buffer with a single
+ * fetch-add on a combined (LSN, offset) word, serializes its record in parallel with the others and then advances
+ * the completion watermark. The appender whose reservation crosses the end of the buffer seals it: it waits for the
+ * watermark to reach the seal point, swaps the buffers and reopens the reservation word. Appenders whose reservation
+ * landed past the end wait for the reopen and retry, so LSNs stay dense and ordered by log offset.
+ *
+ * The flush buffer goes to disk as one LogBlockHeader-framed block, compressed if enable_log_compression is set and
+ * compression makes it smaller. The disk manager spreads the blocks over segment files, which TruncateLog() recycles
+ * once a checkpoint no longer needs them.
+ *
+ * With enable_private_log, transactions first collect their records in a private buffer and publish all of them with
+ * one reservation at commit or when the private buffer fills up. Buffered records get their LSNs on publication.
  */
 class LogManager {
  public:
   explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
+      : filled_(0), disk_manager_(disk_manager) {
+    // LSNs continue where the log on disk ends.
+    lsn_t next_lsn = FindEndOfLog();
+    reservation_ = Pack(next_lsn, 0);
+    persistent_lsn_ = next_lsn - 1;
     log_buffer_ = new char[LOG_BUFFER_SIZE];
     flush_buffer_ = new char[LOG_BUFFER_SIZE];
+    for (auto &block_buffer : block_buffers_) {
+      block_buffer = new char[sizeof(LogBlockHeader) + LOG_BUFFER_SIZE];
+    }
   }
 
   ~LogManager() {
+    StopFlushThread();
     delete[] log_buffer_;
     delete[] flush_buffer_;
     log_buffer_ = nullptr;
     flush_buffer_ = nullptr;
+    for (auto &block_buffer : block_buffers_) {
+      delete[] block_buffer;
+      block_buffer = nullptr;
+    }
   }
 
   void RunFlushThread();
@@ -46,29 +89,196 @@ class LogManager {
 
   lsn_t AppendLogRecord(LogRecord *log_record);
 
-  inline lsn_t GetNextLSN() { return next_lsn_; }
+  /**
+   * Append a record written by txn that describes a change to page_id (INVALID_PAGE_ID for BEGIN/COMMIT/ABORT).
+   * With private logging, the record is buffered in the transaction and INVALID_LSN is returned. The caller then
+   * leaves the LSN of the page alone: the buffered record is published before the page is written, see
+   * PublishPageWriters().
+   * @return the LSN of the record if it went straight to the shared log, INVALID_LSN if it was buffered
+   */
+  lsn_t AppendLogRecord(LogRecord *log_record, Transaction *txn, page_id_t page_id);
+
+  /**
+   * Append a record written by txn straight to the shared log, after the records txn has buffered privately.
+   * @return the LSN of the record
+   */
+  lsn_t AppendSharedLogRecord(LogRecord *log_record, Transaction *txn);
+
+  /**
+   * Append a BEGIN_CHECKPOINT record, make it durable and collect the active transaction table as of the record.
+   * @param[out] active_txns every transaction with records in the log but no COMMIT or ABORT record before the
+   * checkpoint, with the LSN of its last record
+   * @param[out] oldest_lsn the LSN of the first record of the oldest of those transactions, or of the checkpoint
+   * @return the LSN of the BEGIN_CHECKPOINT record
+   */
+  lsn_t AppendBeginCheckpoint(std::vector<ActiveTxnEntry> *active_txns, lsn_t *oldest_lsn);
+
+  /**
+   * Publish the private log buffer of txn to the shared log with a single reservation.
+   * @return the LSN of the last record written by txn
+   */
+  lsn_t PublishPrivateLog(Transaction *txn);
+
+  /**
+   * Publish the private buffers of all running transactions that changed page_id. The buffer pool calls this before
+   * writing the page, so that the write-ahead rule also covers records that are not published yet.
+   *
+   * The result covers the whole log of those transactions, not only their records of page_id, so it can include
+   * records of other pages and COMMIT records. A running writer may log more to other pages right after, and a later
+   * call then returns a larger LSN even though the log of the page was forced in between. Callers check the records
+   * of the page against the LSN they forced, not against a later result.
+   * @return the largest LSN of a record of those transactions or of the ones that changed the page and ended since its
+   * last write, INVALID_LSN if there are none
+   */
+  lsn_t PublishPageWriters(page_id_t page_id);
+
+  /**
+   * @return true if a page with the given page LSN can be written without forcing the log, i.e. every record that
+   * describes a change to it, including the ones its writers keep in their private buffers, is durable
+   */
+  bool IsPageLogDurable(page_id_t page_id, lsn_t page_lsn);
+
+  /**
+   * Forget the pages registered by txn, remembering its last LSN for the next write of each of them. Must be called
+   * once txn has published its last record.
+   */
+  void ReleasePrivateLog(Transaction *txn);
+
+  /**
+   * Block until every log record up to and including lsn is on disk. Concurrent callers share one disk write.
+   * @param lsn the log sequence number that must become durable
+   */
+  void Flush(lsn_t lsn);
+
+  /**
+   * Ask the flush thread to write the log without waiting for it. Does nothing if there is no flush thread, or if a
+   * flush is under way already, since the caller must not block.
+   */
+  void RequestFlush();
+
+  /** @return the next LSN to be handed out; only exact while no appender is waiting on a full buffer */
+  inline lsn_t GetNextLSN() { return UnpackLSN(reservation_.load()); }
   inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
   inline char *GetLogBuffer() { return log_buffer_; }
 
+  /**
+   * Make recovery start at the checkpoint and recycle the log segments that only hold records before redo_lsn. Every
+   * change described by a record before redo_lsn must already be on disk.
+   * @param redo_lsn the first LSN that recovery may have to redo or undo
+   * @param checkpoint_lsn the BEGIN_CHECKPOINT record that analysis starts at, INVALID_LSN to start at redo_lsn
+   */
+  void TruncateLog(lsn_t redo_lsn, lsn_t checkpoint_lsn = INVALID_LSN);
+
+  /** @return a snapshot of the block writer counters */
+  LogCompressionStats GetCompressionStats();
+
  private:
-  // TODO(students): you may add your own member variables
+  /** Packs an LSN and a buffer offset into one reservation word. */
+  static inline uint64_t Pack(lsn_t lsn, uint32_t offset) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(lsn)) << 32) | offset;
+  }
+  static inline lsn_t UnpackLSN(uint64_t word) { return static_cast<lsn_t>(word >> 32); }
+  static inline uint32_t UnpackOffset(uint64_t word) { return static_cast<uint32_t>(word); }
 
-  /** The atomic counter which records the next log sequence number. */
-  std::atomic<lsn_t> next_lsn_;
+  /** Byte offsets of the LSN and prev LSN inside a serialized record header. */
+  static constexpr int OFFSET_LSN = 4;
+  static constexpr int OFFSET_PREV_LSN = 12;
+
+  /** Writes the record into dest, which must have log_record->GetSize() bytes available. */
+  static void SerializeLogRecord(LogRecord *log_record, char *dest);
+
+  /**
+   * Reserve count consecutive LSNs and size bytes of the log buffer. The caller writes the records to *dest and then
+   * calls CompleteReservation(size).
+   * @return the first reserved LSN
+   */
+  lsn_t Reserve(uint32_t count, uint32_t size, char **dest);
+  inline void CompleteReservation(uint32_t size) { filled_.fetch_add(size, std::memory_order_release); }
+
+  /** Publish the private buffer of txn, whose log_latch_ must be held. */
+  lsn_t PublishLocked(Transaction *txn);
+
+  /** Append a record of txn to the shared log. The log_latch_ of txn must be held. */
+  lsn_t AppendSharedLocked(LogRecord *log_record, Transaction *txn);
+
+  static inline bool IsEndRecord(LogRecordType type) {
+    return type == LogRecordType::COMMIT || type == LogRecordType::ABORT;
+  }
+
+  /**
+   * Take active_txns_latch_ if the next record of txn adds it to or removes it from active_txns_. Held across the
+   * reservation, so that a checkpoint sees a transaction exactly if its first record comes before the checkpoint and
+   * its last one after.
+   * @param ends true if the record is the COMMIT or ABORT record of txn
+   */
+  std::unique_lock<std::mutex> LatchActiveTxns(Transaction *txn, bool ends);
+  /** Add txn to active_txns_ if first_lsn is its first LSN, or drop it if it ends. Call before setting its prev LSN. */
+  void UpdateActiveTxns(Transaction *txn, lsn_t first_lsn, bool ends);
+
+  /**
+   * Seal the active buffer at end_offset, hand it over for flushing and reopen the reservation word.
+   * The caller must be the unique thread whose reservation made the offset cross the end of the buffer.
+   * @param next_lsn the first LSN that is not part of the sealed buffer
+   * @param first_count LSNs reserved at the start of the new buffer for the caller's own records, 0 if none
+   * @param first_size bytes reserved at the start of the new buffer for the caller's own records, 0 if none
+   */
+  void SealBuffer(uint32_t end_offset, lsn_t next_lsn, uint32_t first_count, uint32_t first_size);
+
+  /** Seal the active buffer without appending to it. Returns once the buffer is reopened. */
+  void SealActiveBuffer();
+
+  /** @return the LSN that follows the last complete block of the log on disk */
+  lsn_t FindEndOfLog();
+
+  /** Write the sealed buffer to disk as one block, if any. Must be called with latch_ held. */
+  void WriteFlushBuffer();
+
+  /** High 32 bits: the next LSN. Low 32 bits: the next free offset in log_buffer_. */
+  std::atomic<uint64_t> reservation_;
+  /** Completion watermark: bytes of log_buffer_ whose records are fully serialized. */
+  std::atomic<uint32_t> filled_;
   /** The log records before and including the persistent lsn have been written to disk. */
   std::atomic<lsn_t> persistent_lsn_;
 
   char *log_buffer_;
   char *flush_buffer_;
+  /** Bytes of flush_buffer_ waiting to be written, and the last LSN they contain. Protected by latch_. */
+  uint32_t flush_size_{0};
+  lsn_t flush_lsn_{INVALID_LSN};
+  /** True if a caller of Flush() is waiting for the flush thread. Protected by latch_. */
+  bool flush_requested_{false};
+  /** Blocks are assembled here, alternating between the two so that consecutive log writes use different memory. */
+  char *block_buffers_[2];
+  int next_block_buffer_{0};
+  /** Protected by latch_. */
+  LogCompressionStats compression_stats_;
 
+  /** Serializes sealing and disk writes. Appenders never take it on the fast path. */
   std::mutex latch_;
 
-  std::thread *flush_thread_ __attribute__((__unused__));
+  std::thread *flush_thread_{nullptr};
 
+  /** Wakes the flush thread. */
   std::condition_variable cv_;
+  /** Wakes appenders waiting for a sealed buffer to reopen. */
+  std::condition_variable reopen_cv_;
+  /** Wakes callers waiting for persistent_lsn_ to advance. */
+  std::condition_variable flushed_cv_;
+
+  DiskManager *disk_manager_;
+
+  /** Running transactions with private records, keyed by the pages those records change. */
+  std::unordered_map<page_id_t, std::unordered_set<Transaction *>> private_writers_;
+  /** The last LSN of the ended writers of each page that was not written since, which the page LSN must cover. */
+  std::unordered_map<page_id_t, lsn_t> released_lsns_;
+  /** Protects private_writers_ and released_lsns_. Taken before any transaction's log_latch_. */
+  std::mutex private_latch_;
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  /** Transactions with records in the shared log but no COMMIT or ABORT record yet, with their first LSN. */
+  std::unordered_map<Transaction *, lsn_t> active_txns_;
+  /** Protects active_txns_. Taken after a transaction's log_latch_. */
+  std::mutex active_txns_latch_;
 };
 
 }  // namespace bustub
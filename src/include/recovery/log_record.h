@@ -12,10 +12,15 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
+#include "common/util/hash_util.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
@@ -32,6 +37,72 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** Update that only logs the byte ranges in which the old and the new tuple differ. */
+  DELTAUPDATE,
+  /** Start of a fuzzy checkpoint. */
+  BEGIN_CHECKPOINT,
+  /** End of a fuzzy checkpoint, carrying the active transaction table and the dirty page table. */
+  END_CHECKPOINT,
+  /** Insert of an entry into a B+ tree leaf page, at a slot of its array. */
+  INDEXINSERT,
+  /** Delete of the entry at a slot of a B+ tree leaf page. */
+  INDEXDELETE,
+  /** Structure modification of a B+ tree, such as a split or a merge: the bytes it writes to each page it changes. */
+  INDEXSMO,
+};
+
+/** Active transaction table entry: a transaction and the LSN of its last record. */
+using ActiveTxnEntry = std::pair<txn_id_t, lsn_t>;
+/** Dirty page table entry: a page and its recLSN, the first LSN that may describe a change missing on disk. */
+using DirtyPageEntry = std::pair<page_id_t, lsn_t>;
+
+/** A range of bytes that a structure modification writes to an index page. Its data follows in the log record. */
+struct IndexPageWrite {
+  page_id_t page_id_;
+  uint16_t offset_;
+  uint16_t length_;
+};
+
+/**
+ * The log is a sequence of blocks, one per flush of the log buffer. A block holds whole log records, optionally
+ * compressed with LZUtil, and never spans two log segments.
+ *----------------------------------------------------------------------------------------------
+ * | size | uncompressed_size | first LSN | last LSN | flags | checksum | payload (size bytes) |
+ *----------------------------------------------------------------------------------------------
+ */
+struct LogBlockHeader {
+  static constexpr uint32_t FLAG_COMPRESSED = 1;
+
+  /** Bytes of payload that follow the header on disk. */
+  uint32_t size_;
+  /** Bytes of log records in the block once decompressed. */
+  uint32_t uncompressed_size_;
+  /** LSNs of the first and the last record in the block. */
+  lsn_t first_lsn_;
+  lsn_t last_lsn_;
+  uint32_t flags_;
+  /** Checksum of the payload on disk, which tells a block that is only partly written from a complete one. */
+  uint32_t checksum_;
+
+  /** @return the checksum of size bytes of payload */
+  static uint32_t Checksum(const char *payload, uint32_t size) {
+    return static_cast<uint32_t>(HashUtil::HashBytes(payload, size));
+  }
+
+  /**
+   * Tell a block apart from unused or stale bytes of a log segment. Recycled segments keep the blocks of their previous
+   * use, but those all have LSNs below the first LSN of the segment.
+   * @param offset log offset of the block
+   * @param segment_lsn first LSN of the segment holding offset
+   * @return true if the header describes a block that can have been written at offset
+   */
+  bool IsValid(int offset, lsn_t segment_lsn) const {
+    return size_ > 0 && size_ <= static_cast<uint32_t>(LOG_BUFFER_SIZE) &&
+           uncompressed_size_ <= static_cast<uint32_t>(LOG_BUFFER_SIZE) && first_lsn_ >= segment_lsn &&
+           last_lsn_ >= first_lsn_ &&
+           static_cast<size_t>(offset % LOG_SEGMENT_SIZE) + sizeof(LogBlockHeader) + size_ <=
+               static_cast<size_t>(LOG_SEGMENT_SIZE);
+  }
 };
 
 /**
@@ -57,17 +128,44 @@ enum class LogRecordType {
  *--------------------------
  * | HEADER | prev_page_id |
  *--------------------------
+ * For delta update type log record
+ *---------------------------------------------------------------------------------
+ * | HEADER | tuple_rid | old_tuple_size | new_tuple_size | delta_size | delta[] |
+ *---------------------------------------------------------------------------------
+ * The delta is a sequence of ranges | offset (2) | length (2) | xor_data[length] |. Both tuple images are padded
+ * with zeroes to the larger size and XORed, so the same delta turns the old image into the new one and back.
+ * For end checkpoint type log record (begin checkpoint is just the HEADER)
+ *-----------------------------------------------------------------------------------------------------
+ * | HEADER | txn_count | (txn_id, last_lsn)[txn_count] | page_count | (page_id, rec_lsn)[page_count] |
+ *-----------------------------------------------------------------------------------------------------
+ * For index insert and index delete type log record
+ *---------------------------------------------------------------
+ * | HEADER | page_id | slot | entry_size | entry_data[entry_size] |
+ *---------------------------------------------------------------
+ * The entry is the key and the value of a leaf page, as raw bytes, so that recovery needs no key type to move it.
+ * For index structure modification type log record
+ *---------------------------------------------------------------------------------------
+ * | HEADER | write_count | (page_id, offset, length)[write_count] | data[sum of lengths] |
+ *---------------------------------------------------------------------------------------
+ * A structure modification is a nested top action: one record holds all of it, so that recovery redoes either all of
+ * it or none, and it is never undone, even if its transaction rolls back.
  */
 class LogRecord {
   friend class LogManager;
   friend class LogRecovery;
 
  public:
+  /** The size of the serialized header shared by all log record types. */
+  static const int HEADER_SIZE = 20;
+
   LogRecord() = default;
 
-  // constructor for Transaction type(BEGIN/COMMIT/ABORT)
+  // constructor for Transaction type(BEGIN/COMMIT/ABORT), and for INDEXSMO type filled by AddIndexPageWrite()
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type)
-      : size_(HEADER_SIZE), txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {}
+      : size_(log_record_type == LogRecordType::INDEXSMO ? HEADER_SIZE + sizeof(uint32_t) : HEADER_SIZE),
+        txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type) {}
 
   // constructor for INSERT/DELETE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &rid, const Tuple &tuple)
@@ -85,15 +183,18 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + tuple.GetLength();
   }
 
-  // constructor for UPDATE type
+  // constructor for UPDATE/DELTAUPDATE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &update_rid,
             const Tuple &old_tuple, const Tuple &new_tuple)
-      : txn_id_(txn_id),
-        prev_lsn_(prev_lsn),
-        log_record_type_(log_record_type),
-        update_rid_(update_rid),
-        old_tuple_(old_tuple),
-        new_tuple_(new_tuple) {
+      : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type), update_rid_(update_rid) {
+    if (log_record_type == LogRecordType::DELTAUPDATE) {
+      EncodeDelta(old_tuple, new_tuple);
+      size_ = HEADER_SIZE + sizeof(RID) + 3 * sizeof(int32_t) + delta_.size();
+      return;
+    }
+    assert(log_record_type == LogRecordType::UPDATE);
+    old_tuple_ = old_tuple;
+    new_tuple_ = new_tuple;
     // calculate log record size
     size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
   }
@@ -110,6 +211,28 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
   }
 
+  // constructor for INDEXINSERT/INDEXDELETE type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t page_id, int32_t slot,
+            const char *entry, uint32_t entry_size)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(log_record_type),
+        index_page_id_(page_id),
+        index_slot_(slot),
+        index_entry_(entry, entry + entry_size) {
+    assert(log_record_type == LogRecordType::INDEXINSERT || log_record_type == LogRecordType::INDEXDELETE);
+    size_ = HEADER_SIZE + sizeof(page_id_t) + sizeof(int32_t) + sizeof(uint32_t) + entry_size;
+  }
+
+  // constructor for END_CHECKPOINT type
+  LogRecord(std::vector<ActiveTxnEntry> active_txns, std::vector<DirtyPageEntry> dirty_pages)
+      : log_record_type_(LogRecordType::END_CHECKPOINT),
+        active_txns_(std::move(active_txns)),
+        dirty_pages_(std::move(dirty_pages)) {
+    size_ = HEADER_SIZE + 2 * sizeof(uint32_t) + active_txns_.size() * sizeof(ActiveTxnEntry) +
+            dirty_pages_.size() * sizeof(DirtyPageEntry);
+  }
+
   ~LogRecord() = default;
 
   inline Tuple &GetDeleteTuple() { return delete_tuple_; }
@@ -128,6 +251,40 @@ class LogRecord {
 
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
+  inline page_id_t GetNewPageId() { return page_id_; }
+
+  inline const std::vector<ActiveTxnEntry> &GetActiveTxns() const { return active_txns_; }
+
+  inline const std::vector<DirtyPageEntry> &GetDirtyPages() const { return dirty_pages_; }
+
+  inline page_id_t GetIndexPageId() const { return index_page_id_; }
+
+  inline int32_t GetIndexSlot() const { return index_slot_; }
+
+  inline const std::vector<char> &GetIndexEntry() const { return index_entry_; }
+
+  inline const std::vector<IndexPageWrite> &GetIndexPageWrites() const { return index_writes_; }
+
+  /** @return the bytes of all index page writes, one after the other */
+  inline const std::vector<char> &GetIndexPageData() const { return index_data_; }
+
+  /**
+   * Add a write of length bytes at offset of an index page to an INDEXSMO record. A structure modification adds every
+   * range that it changes before it appends the record.
+   */
+  inline void AddIndexPageWrite(page_id_t page_id, uint16_t offset, const char *data, uint16_t length) {
+    assert(log_record_type_ == LogRecordType::INDEXSMO && offset + length <= PAGE_SIZE);
+    index_writes_.push_back({page_id, offset, length});
+    index_data_.insert(index_data_.end(), data, data + length);
+    size_ = HEADER_SIZE + sizeof(uint32_t) + index_writes_.size() * sizeof(IndexPageWrite) + index_data_.size();
+  }
+
+  /** @return the tuple after a DELTAUPDATE, given the tuple before it (for redo) */
+  inline Tuple GetDeltaRedoTuple(const Tuple &old_tuple) const { return ApplyDelta(old_tuple, new_size_); }
+
+  /** @return the tuple before a DELTAUPDATE, given the tuple after it (for undo) */
+  inline Tuple GetDeltaUndoTuple(const Tuple &new_tuple) const { return ApplyDelta(new_tuple, old_size_); }
+
   inline int32_t GetSize() { return size_; }
 
   inline lsn_t GetLSN() { return lsn_; }
@@ -152,6 +309,69 @@ class LogRecord {
   }
 
  private:
+  /** A range whose gap to the previous one is at most this long is merged into it, the gap costs less than a header. */
+  static constexpr uint32_t DELTA_MERGE_GAP = 2 * sizeof(uint16_t);
+
+  /** Fills delta_ with the XOR ranges that turn old_tuple into new_tuple. */
+  void EncodeDelta(const Tuple &old_tuple, const Tuple &new_tuple) {
+    old_size_ = old_tuple.GetLength();
+    new_size_ = new_tuple.GetLength();
+    std::vector<char> diff(std::max(old_size_, new_size_), 0);
+    memcpy(diff.data(), old_tuple.GetData(), old_size_);
+    for (uint32_t i = 0; i < new_size_; i++) {
+      diff[i] ^= new_tuple.GetData()[i];
+    }
+
+    uint32_t size = diff.size();
+    uint32_t i = 0;
+    while (i < size) {
+      if (diff[i] == 0) {
+        i++;
+        continue;
+      }
+      // Extend the range until the next run of equal bytes that is too long to be worth including.
+      uint32_t begin = i;
+      uint32_t end = i + 1;
+      for (uint32_t j = end; j < size && j - end <= DELTA_MERGE_GAP; j++) {
+        if (diff[j] != 0) {
+          end = j + 1;
+        }
+      }
+      auto offset = static_cast<uint16_t>(begin);
+      auto length = static_cast<uint16_t>(end - begin);
+      size_t pos = delta_.size();
+      delta_.resize(pos + 2 * sizeof(uint16_t) + length);
+      memcpy(delta_.data() + pos, &offset, sizeof(uint16_t));
+      memcpy(delta_.data() + pos + sizeof(uint16_t), &length, sizeof(uint16_t));
+      memcpy(delta_.data() + pos + 2 * sizeof(uint16_t), diff.data() + begin, length);
+      i = end;
+    }
+  }
+
+  /** @return tuple with delta_ applied, cut to result_size bytes */
+  Tuple ApplyDelta(const Tuple &tuple, uint32_t result_size) const {
+    std::vector<char> image(std::max(old_size_, new_size_), 0);
+    memcpy(image.data(), tuple.GetData(), std::min<size_t>(tuple.GetLength(), image.size()));
+    for (size_t pos = 0; pos < delta_.size();) {
+      uint16_t offset;
+      uint16_t length;
+      memcpy(&offset, delta_.data() + pos, sizeof(uint16_t));
+      memcpy(&length, delta_.data() + pos + sizeof(uint16_t), sizeof(uint16_t));
+      pos += 2 * sizeof(uint16_t);
+      for (uint16_t k = 0; k < length; k++) {
+        image[offset + k] ^= delta_[pos + k];
+      }
+      pos += length;
+    }
+
+    Tuple result(update_rid_);
+    result.size_ = result_size;
+    result.data_ = new char[result_size];
+    result.allocated_ = true;
+    memcpy(result.data_, image.data(), result_size);
+    return result;
+  }
+
   // the length of log record(for serialization, in bytes)
   int32_t size_{0};
   // must have fields
@@ -173,10 +393,27 @@ class LogRecord {
   Tuple old_tuple_;
   Tuple new_tuple_;
 
+  // case3': for delta update operation, shares update_rid_
+  uint32_t old_size_{0};
+  uint32_t new_size_{0};
+  std::vector<char> delta_;
+
   // case4: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
-  static const int HEADER_SIZE = 20;
+
+  // case5: for end checkpoint
+  std::vector<ActiveTxnEntry> active_txns_;
+  std::vector<DirtyPageEntry> dirty_pages_;
+
+  // case6: for index insert and index delete
+  page_id_t index_page_id_{INVALID_PAGE_ID};
+  int32_t index_slot_{0};
+  std::vector<char> index_entry_;
+
+  // case7: for index structure modification
+  std::vector<IndexPageWrite> index_writes_;
+  std::vector<char> index_data_;
 };  // namespace bustub
 
 }  // namespace bustub
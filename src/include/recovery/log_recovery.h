@@ -13,45 +13,230 @@
 #pragma once
 
 #include <algorithm>
-#include <mutex>  // NOLINT
+#include <chrono>  // NOLINT
+#include <functional>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
 #include "recovery/log_record.h"
+#include "storage/page/table_page.h"
 
 namespace bustub {
 
+/** Counters of the last recovery run by a LogRecovery. */
+struct RecoveryStats {
+  /** Log records read by the analysis pass and by the redo pass. */
+  uint64_t analyzed_records_{0};
+  uint64_t redo_records_{0};
+  /** Records that redo skipped through the dirty page table without fetching their page. */
+  uint64_t skipped_records_{0};
+  /** Page changes redone and undone. A NEWPAGE record changes the new page and the page before it. */
+  uint64_t redone_records_{0};
+  uint64_t undone_records_{0};
+  /** Time spent in the redo pass, after analysis. */
+  uint64_t redo_ns_{0};
+};
+
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Recovery follows ARIES. The analysis pass reads the log from the last checkpoint named by the master record and
+ * rebuilds the active transaction table and the dirty page table. Redo starts at the smallest recLSN in the dirty page
+ * table and only fetches a page if the table says that it may miss the change. Undo rolls back the transactions left
+ * in the active transaction table, reading older parts of the log on demand. It logs every change that it undoes and
+ * an ABORT record for every loser, so that recovery after another crash does not roll a loser back twice.
+ *
+ * With redo_threads > 1, the calling thread only reads the log and hands every record to the worker that owns its
+ * page, chosen by hashing the page id. Each page is changed by a single worker, in log order.
+ *
+ * StartRedoOnDemand() replaces Redo() for an instant restart: after analysis, it only indexes the records that each
+ * page has to redo and returns. The buffer pool redoes a page the first time it reads it, and a background thread
+ * reads in the pages that nobody asked for.
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
+  /** Undo() needs the log manager, to log the rollback. */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, LogManager *log_manager = nullptr)
+      : disk_manager_(disk_manager),
+        buffer_pool_manager_(buffer_pool_manager),
+        log_manager_(log_manager),
+        offset_(0) {
     log_buffer_ = new char[LOG_BUFFER_SIZE];
+    block_buffer_ = new char[LOG_BUFFER_SIZE];
+    pending_log_buffer_ = new char[LOG_BUFFER_SIZE];
+    pending_block_buffer_ = new char[LOG_BUFFER_SIZE];
   }
 
   ~LogRecovery() {
+    FinishRedoOnDemand();
     delete[] log_buffer_;
+    delete[] block_buffer_;
+    delete[] pending_log_buffer_;
+    delete[] pending_block_buffer_;
     log_buffer_ = nullptr;
+    block_buffer_ = nullptr;
+    pending_log_buffer_ = nullptr;
+    pending_block_buffer_ = nullptr;
   }
 
+  /** Run the analysis pass, then redo the changes that may be missing on disk. */
   void Redo();
+  /** Roll back the transactions that were running at the crash. Must follow Redo() or StartRedoOnDemand(). */
   void Undo();
+
+  /**
+   * Run the analysis pass on its own, on a log that may still grow.
+   * @return the LSN that redo would start at: every change logged before it is on disk
+   */
+  lsn_t AnalyzeRedoLSN();
+
+  /**
+   * Run the analysis pass and let the buffer pool redo every page when it first reads it. The database may be used as
+   * soon as this returns, but Undo() must run before any transaction touches the changes of a loser.
+   */
+  void StartRedoOnDemand();
+  /** Wait until the background thread has redone every page, then detach from the buffer pool. */
+  void FinishRedoOnDemand();
+  /**
+   * Apply the pending records of a page that the buffer pool has just read from disk, with its latch held.
+   * @return the LSN of the first record applied, INVALID_LSN if the page was up to date
+   */
+  lsn_t RedoPage(Page *page);
+  /** Add the pages that still wait for redo on demand to dirty_pages, with the LSN of their first pending record. */
+  void GetPendingPages(std::vector<DirtyPageEntry> *dirty_pages);
   bool DeserializeLogRecord(const char *data, LogRecord *log_record);
 
+  /** @return the counters of the last recovery, complete once redo on demand has finished */
+  inline RecoveryStats GetStats() const { return stats_; }
+
+  /**
+   * Read the log block at the given log offset, decompressing it if needed.
+   * @param offset log offset of the block
+   * @param[out] data receives the log records of the block, must hold LOG_BUFFER_SIZE bytes
+   * @param[out] header the header of the block
+   * @return the log offset right after the block, or -1 if there is no complete block at offset, in which case the
+   * log may go on at DiskManager::GetNextLogSegmentOffset(offset)
+   */
+  int ReadLogBlock(int offset, char *data, LogBlockHeader *header);
+  /** @return the log offset right after the block at offset, or -1 as for ReadLogBlock(); reads the header only */
+  int ReadLogBlockHeader(int offset, LogBlockHeader *header);
+
+  /**
+   * Redo the records of the log block at offset from first_lsn through last_lsn that their pages do not reflect yet,
+   * without analysis and without undo. A standby replays the log of its primary this way, one block at a time.
+   * @param[out] header the header of the block
+   * @return the log offset right after the block, or -1 as for ReadLogBlock()
+   */
+  int ReplayLogBlock(int offset, LogBlockHeader *header, lsn_t first_lsn, lsn_t last_lsn);
+
+  /**
+   * Follow the transactions through the log block at offset without redoing anything. A record of a transaction
+   * opens it, and its COMMIT or ABORT record closes it.
+   * @param[out] header the header of the block
+   * @param[in,out] open_txns the transactions that are open before the block, and after it on return
+   * @param[out] closed_lsn the last LSN of the block after which no transaction is open, left alone if there is none
+   * @return the log offset right after the block, or -1 as for ReadLogBlock()
+   */
+  int ScanLogBlockTxns(int offset, LogBlockHeader *header, std::unordered_set<txn_id_t> *open_txns, lsn_t *closed_lsn);
+
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** Same as above, decompressing through scratch, which must hold LOG_BUFFER_SIZE bytes. */
+  int ReadLogBlock(int offset, char *data, LogBlockHeader *header, char *scratch);
+  /** Rebuild active_txn_ and dirty_page_table_ from the last checkpoint and the log that follows it. */
+  void Analysis();
+  /**
+   * Read the log from start_lsn to its end and pass every record to visit, which returns false to stop the scan.
+   * Blocks that end before start_lsn are skipped by their header. Every record read is added to lsn_mapping_.
+   */
+  void ScanLog(lsn_t start_lsn, const std::function<bool(LogRecord *)> &visit);
+  /** @return false if the dirty page table shows that page_id already holds the change of the record at lsn */
+  bool NeedsRedo(page_id_t page_id, lsn_t lsn);
+  /** Replace pages with the ids of the pages whose image the record changes. */
+  void GetRecordPages(LogRecord *log_record, std::vector<page_id_t> *pages);
+
+  /** Read the log from redo_lsn and redo it with the given number of worker threads. */
+  void ParallelRedo(lsn_t redo_lsn, int num_workers);
+  struct RedoWorker;
+  /** Redo the batches queued for worker until it is told to stop. */
+  void RunRedoWorker(RedoWorker *worker);
+  /** Read in every page that still waits for redo on demand. */
+  void RunRedoOnDemand();
+
+  /**
+   * Redo the change that the record makes to page_id if the page does not reflect it yet.
+   * @return true if the page was changed
+   */
+  bool RedoLogRecord(LogRecord *log_record, page_id_t page_id);
+  /** Same as above for a page that the caller holds. */
+  bool RedoLogRecord(LogRecord *log_record, TablePage *page);
+  /**
+   * Undo the record unconditionally, by logging the inverse change as the next record of its transaction and redoing
+   * that, which leaves the page with its LSN.
+   * @return the LSN of the record logged, or prev_lsn if there was nothing to undo
+   */
+  lsn_t UndoLogRecord(LogRecord *log_record, lsn_t prev_lsn);
+  /**
+   * Build the record of the change that undoes log_record on page, which follows prev_lsn in its transaction. An index
+   * insert is only found on the page that the record names, so a tree that moves entries to other pages must roll
+   * back through the tree instead.
+   * @return false if there is nothing to undo
+   */
+  bool MakeCompensation(TablePage *page, LogRecord *log_record, lsn_t prev_lsn, LogRecord *compensation);
+  /** Apply the change described by the record to page. */
+  void ApplyLogRecord(TablePage *page, LogRecord *log_record);
+  /** Apply an index record to its leaf page, or to one of the pages of a structure modification. */
+  void ApplyIndexRecord(Page *page, LogRecord *log_record);
+  /** @return the slot of the entry on the leaf page, or -1 if it is not there */
+  int FindIndexEntry(Page *page, const std::vector<char> &entry);
+  /** @return the RID of the tuple changed by a tuple-level record */
+  RID GetRecordRID(LogRecord *log_record);
+  /** @return the pinned table page, which must be unpinned by the caller */
+  TablePage *FetchTablePage(page_id_t page_id);
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  LogManager *log_manager_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
-  /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  /** Pages that may miss changes on disk, with the LSN of the first such change (recLSN). */
+  std::unordered_map<page_id_t, lsn_t> dirty_page_table_;
+  /** Mapping the log sequence number to the log offset of its block and its offset inside the block, for undos. */
+  std::unordered_map<lsn_t, std::pair<int, int>> lsn_mapping_;
 
-  int offset_ __attribute__((__unused__));
+  /** Log offset of the block in log_buffer_. */
+  int offset_;
+  /** Decompressed records of the current block. */
   char *log_buffer_;
+  /** Compressed payload of the current block. */
+  char *block_buffer_;
+
+  /** A record that a page still has to redo: its LSN, the log offset of its block and its offset in the block. */
+  struct PendingRecord {
+    lsn_t lsn_;
+    int block_offset_;
+    uint32_t pos_;
+  };
+  /** The records that each page has to redo on demand, in log order. */
+  std::unordered_map<page_id_t, std::vector<PendingRecord>> pending_records_;
+  /** Log offset of the block in pending_log_buffer_, -1 if none. */
+  int pending_offset_{-1};
+  /** The buffers of ReadLogBlock() for redo on demand, which runs alongside Undo(). */
+  char *pending_log_buffer_;
+  char *pending_block_buffer_;
+  /** Protects pending_records_, the buffers above and the redo counters while redo on demand runs. */
+  std::mutex pending_latch_;
+  /** Reads in the pages that nobody asked for. */
+  std::thread redo_thread_;
+  std::chrono::steady_clock::time_point redo_start_;
+
+  RecoveryStats stats_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,144 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_standby.h
+//
+// Identification: src/include/recovery/log_standby.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_set>
+#include <utility>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/rwlatch.h"
+#include "recovery/log_recovery.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/** Replication counters of a LogStandby. */
+struct ReplicationStats {
+  /** The last LSN replayed, after which no transaction is open. Reads see the database of the primary as of it. */
+  lsn_t replay_lsn_{INVALID_LSN};
+  /** The last LSN found in the log of the primary. The difference to replay_lsn_ is the lag in log records. */
+  lsn_t received_lsn_{INVALID_LSN};
+  /** Log blocks and log records replayed. */
+  uint64_t replayed_blocks_{0};
+  uint64_t replayed_records_{0};
+  /** How long the oldest block that was found but not replayed yet has waited, 0 if the standby is caught up. */
+  uint64_t replay_lag_ns_{0};
+  /** The longest time a block waited between being found and being replayed. */
+  uint64_t max_replay_lag_ns_{0};
+};
+
+/**
+ * LogStandby keeps a read-only copy of a database up to date by following the log that its primary writes, which may
+ * run in another process on the same machine. It rescans the log segments of the primary for new blocks and replays
+ * them into its own buffer pool with the redo path of LogRecovery. Readers that hold the standby between BeginRead()
+ * and EndRead() see the database as of the replay LSN.
+ *
+ * A transaction of the primary may have records in the log long before it commits or aborts, e.g. when its private
+ * buffer fills up or a page write forces them out. Replay therefore only moves on to the last LSN after which no
+ * transaction is open, and applies everything up to there while readers wait, so that they only see whole
+ * transactions that committed. Records after that LSN wait until their transactions end.
+ *
+ * The database of the standby must start as a copy of the primary's taken no earlier than the oldest log segment,
+ * e.g. both empty, and the primary must not recycle segments that the standby has not replayed yet.
+ */
+class LogStandby {
+ public:
+  /**
+   * @param primary_db_file the database file of the primary, which must exist; its log segments are next to it
+   * @param buffer_pool_manager the buffer pool of the standby's own database
+   */
+  LogStandby(const std::string &primary_db_file, BufferPoolManager *buffer_pool_manager);
+
+  ~LogStandby();
+
+  DISALLOW_COPY(LogStandby);
+
+  /** Start a thread that polls the log of the primary every poll_interval and replays what it finds. */
+  void Start(std::chrono::milliseconds poll_interval = std::chrono::milliseconds(10));
+  /** Stop and join the polling thread. */
+  void Stop();
+
+  /**
+   * Replay the blocks that the primary has written since the last poll.
+   * @return true if at least one block was replayed
+   */
+  bool Poll();
+
+  /**
+   * Hold replay back until EndRead(), so that the caller reads a stable state of the database.
+   * @return the replay LSN that the reads see
+   */
+  lsn_t BeginRead();
+  void EndRead();
+
+  /** @return a snapshot of the replication counters */
+  ReplicationStats GetStats();
+
+ private:
+  /**
+   * Find the block that continues the log at offset, moving on to the next segment if the current one has ended.
+   * @param next_lsn the first LSN of the block, INVALID_LSN to take the first block found
+   * @param[out] header the header of the block
+   * @return the log offset of the block, -1 if it is not on disk yet
+   */
+  int FindBlock(int offset, lsn_t next_lsn, LogBlockHeader *header);
+
+  /** Record the blocks the primary has added to its log since the last call, for the lag counters. */
+  void ScanReceived();
+
+  /** Follow the transactions through the complete blocks added since the last call, moving closed_lsn_ on. */
+  void ScanTxns();
+
+  /** Reads the log of the primary. */
+  std::unique_ptr<DiskManager> primary_disk_manager_;
+  /** Replays the log into the standby's buffer pool. */
+  std::unique_ptr<LogRecovery> replayer_;
+
+  /**
+   * Log offset and first LSN of the block that replay continues with, of the next block to look for, and of the next
+   * block to follow the transactions through. Under poll_latch_, like the members up to received_blocks_.
+   */
+  int replay_offset_{-1};
+  lsn_t replay_next_lsn_{INVALID_LSN};
+  int scan_offset_{-1};
+  lsn_t scan_next_lsn_{INVALID_LSN};
+  int txn_scan_offset_{-1};
+  lsn_t txn_scan_next_lsn_{INVALID_LSN};
+  /** The transactions open at the end of the blocks followed so far, and the last LSN at which none was. */
+  std::unordered_set<txn_id_t> open_txns_;
+  lsn_t closed_lsn_{INVALID_LSN};
+  /** The last LSN of every block found but not replayed yet, with the time it was found. Protected by latch_. */
+  std::deque<std::pair<lsn_t, std::chrono::steady_clock::time_point>> received_blocks_;
+
+  /** Serializes polls. */
+  std::mutex poll_latch_;
+  /** Held in write mode while a block is replayed and in read mode by readers. */
+  ReaderWriterLatch replay_latch_;
+
+  /** Protects the members below. */
+  std::mutex latch_;
+  /** Wakes the polling thread when it has to stop. */
+  std::condition_variable cv_;
+  bool stop_{false};
+  std::thread poll_thread_;
+  ReplicationStats stats_;
+};
+
+}  // namespace bustub
@@ -13,9 +13,12 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 #include <fstream>
 #include <future>  // NOLINT
+#include <mutex>   // NOLINT
 #include <string>
+#include <vector>
 
 #include "common/config.h"
 
@@ -24,6 +27,12 @@ namespace bustub {
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * The log is split into segment files of LOG_SEGMENT_SIZE bytes, named after the LSN of their first block
+ * (<db stem>.log.<LSN>). Segment files are allocated in full when they are created, and segments dropped by
+ * TruncateLog() are kept as spares (<db stem>.log.spare.<n>) and renamed when a new segment is needed. Log offsets
+ * address the concatenation of the segments: the position of a segment in the log times LOG_SEGMENT_SIZE plus the
+ * offset inside the segment.
  */
 class DiskManager {
  public:
@@ -54,22 +63,72 @@ class DiskManager {
    */
   void ReadPage(page_id_t page_id, char *page_data);
 
+  /** @return the number of pages in the database file, including a partly written last one */
+  int GetNumPages();
+
   /**
-   * Flush the entire log buffer into disk.
+   * Flush the entire log buffer into disk. The data goes to a new segment if it does not fit in the current one, and
+   * the first write after opening the database always starts a new segment.
    * @param log_data raw log data
    * @param size size of log entry
+   * @param first_lsn LSN of the first log record in log_data, which names the segment if a new one is started
    */
-  void WriteLog(char *log_data, int size);
+  void WriteLog(char *log_data, int size, lsn_t first_lsn = 0);
 
   /**
    * Read a log entry from the log file.
    * @param[out] log_data output buffer
    * @param size size of the log entry
-   * @param offset offset of the log entry in the file
+   * @param offset log offset of the log entry
    * @return true if the read was successful, false otherwise
    */
   bool ReadLog(char *log_data, int size, int offset);
 
+  /**
+   * @return the log offset of the last segment that starts at or before lsn (the first segment if there is none), or
+   * -1 if the log is empty
+   */
+  int GetLogSegmentOffset(lsn_t lsn);
+
+  /** @return the log offset of the segment that follows the one holding offset, -1 if there is none */
+  int GetNextLogSegmentOffset(int offset);
+
+  /** @return the first LSN of the segment holding offset, INVALID_LSN if there is none */
+  lsn_t GetLogSegmentLSN(int offset);
+
+  /**
+   * Recycle the segments that only hold log records before lsn. The last segment is always kept.
+   * @param lsn the first LSN that must stay in the log
+   */
+  void TruncateLog(lsn_t lsn);
+
+  /**
+   * Pick up the segments that another process has added to the log or recycled since it was opened. Lets a reader
+   * follow the log of a database that is running elsewhere; the offsets of the segments that remain stay valid.
+   */
+  void RescanLog();
+
+  /** @return the number of segments in the log */
+  size_t GetNumLogSegments();
+
+  /** @return the number of spare segments waiting to be reused */
+  size_t GetNumSpareLogSegments();
+
+  /**
+   * Durably record the LSN at which recovery starts reading the log. Replaces the previous master record atomically.
+   * @param lsn the LSN of the last checkpoint
+   */
+  void WriteMasterRecord(lsn_t lsn);
+
+  /** @return the LSN of the last master record, INVALID_LSN if there is none */
+  lsn_t ReadMasterRecord();
+
+  /**
+   * Delete the log files of a database: its segments, spare segments and master record.
+   * @param db_file the file name of the database
+   */
+  static void RemoveLog(const std::string &db_file);
+
   /**
    * Allocate a page on disk.
    * @return the id of the allocated page
@@ -102,9 +161,35 @@ class DiskManager {
 
  private:
   int GetFileSize(const std::string &file_name);
-  // stream to write log file
+  /** Find the segments and spares of the log, or delete them if the database file is new. */
+  void OpenLog(bool new_database);
+  /** @return the prefix of the names of the log files of a database file, empty if it has no extension */
+  static std::string GetLogName(const std::string &db_file);
+  /** @return the suffixes after "<log name>." of the log files next to the database file */
+  static std::vector<std::string> ListLogFiles(const std::string &log_name);
+  /** @return the file name of the segment whose first LSN is lsn */
+  std::string GetLogSegmentName(lsn_t lsn) const;
+  /** Make a segment starting at first_lsn the current one. Must be called with log_latch_ held. */
+  void StartLogSegment(lsn_t first_lsn);
+  // stream to write the current log segment
   std::fstream log_io_;
+  // stream to read log segments
+  std::fstream log_read_io_;
+  // prefix of the names of the log files
   std::string log_name_;
+  /** First LSNs of the segments, oldest first. */
+  std::deque<lsn_t> log_segments_;
+  /** Position in the log of log_segments_.front(). */
+  int log_segment_base_{0};
+  /** Write offset inside the last segment, -1 if the next write starts a new segment. */
+  int log_write_offset_{-1};
+  /** Position in the log of the segment open in log_read_io_, -1 if none. */
+  int log_read_segment_{-1};
+  /** File names of the spare segments, and the number for the next one. */
+  std::vector<std::string> spare_log_segments_;
+  int next_spare_id_{0};
+  /** Protects the log streams and the segment book-keeping. */
+  std::mutex log_latch_;
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
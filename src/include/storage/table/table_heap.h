@@ -23,6 +23,13 @@ namespace bustub {
 /**
  * TableHeap represents a physical table on disk.
  * This is just a doubly-linked list of pages.
+ *
+ * With logging enabled, every access locks the table, named by its first page, before the row: a scan locks the table
+ * in shared mode, which covers all of its rows, while a point access takes an intention lock and locks the row.
+ *
+ * Every write hands the version it overwrites to the version store of the transaction, see VersionStore. A snapshot
+ * transaction reads the versions of its snapshot without any lock, and only locks the rows that it writes. An
+ * optimistic transaction reads the same way, but buffers its writes until it commits, see ConcurrencyControl.
  */
 class TableHeap {
   friend class TableIterator;
@@ -53,7 +60,7 @@ class TableHeap {
   /**
    * Insert a tuple into the table. If the tuple is too large (>= page_size), return false.
    * @param tuple tuple to insert
-   * @param[out] rid the rid of the inserted tuple
+   * @param[out] rid the rid of the inserted tuple, invalid while an optimistic transaction buffers the insert
    * @param txn the transaction performing the insert
    * @return true iff the insert is successful
    */
@@ -99,7 +106,7 @@ class TableHeap {
    */
   bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn);
 
-  /** @return the begin iterator of this table */
+  /** @return the begin iterator of this table, End() if txn was aborted while it locked the table in shared mode */
   TableIterator Begin(Transaction *txn);
 
   /** @return the end iterator of this table */
@@ -109,6 +116,35 @@ class TableHeap {
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
  private:
+  /**
+   * Lock this table for an access to one of its rows, in the intention mode of the row lock, unless the transaction
+   * holds a table lock that covers the row already. Then lock the row, before its page is latched: a transaction that
+   * waits for a row lock with the latch held keeps the holder of the lock out of the page.
+   * @param rid the row, nullptr for a new one, which TablePage::InsertTuple() locks
+   * @param exclusive true to change the row, false to read it
+   * @param[out] row_lock_manager the lock manager to lock the row with, nullptr if the table lock covers the row
+   * @return false if the transaction was aborted
+   */
+  bool LockForRow(const RID *rid, Transaction *txn, bool exclusive, LockManager **row_lock_manager);
+
+  /** @return true if the lock of the transaction on this table covers its rows, for writing them if exclusive */
+  bool TableLockCovers(Transaction *txn, bool exclusive);
+
+  /**
+   * Check that nobody changed a row since the snapshot of the transaction that is about to change it, after locking it.
+   * @return false if the transaction was aborted
+   */
+  bool CheckSnapshotWrite(const RID &rid, Transaction *txn);
+
+  /**
+   * Keep a write of an optimistic transaction in its write set until it commits.
+   * @return false if the transaction does not see the row
+   */
+  bool BufferWrite(const RID &rid, WType wtype, const Tuple &tuple, Transaction *txn);
+
+  /** Read the version of a row that the snapshot of txn sees, or that an optimistic transaction wrote itself. */
+  bool GetSnapshotTuple(const RID &rid, Tuple *tuple, Transaction *txn);
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
@@ -49,6 +49,9 @@ class TableIterator {
   TableIterator operator++(int);
 
  private:
+  /** @return true if the scan moves past the slots whose rows it cannot read */
+  bool SkipsMissing();
+
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
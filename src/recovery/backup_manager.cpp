@@ -0,0 +1,209 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// backup_manager.cpp
+//
+// Identification: src/recovery/backup_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/backup_manager.h"
+
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <filesystem>
+#include <thread>  // NOLINT
+
+#include "common/exception.h"
+
+namespace bustub {
+
+/** Pages read between two copies of the log, so that a checkpoint cannot recycle a segment before it is copied. */
+static constexpr int LOG_COPY_INTERVAL = 64;
+
+BackupManager::BackupManager(const std::string &db_file) {
+  // A disk manager that finds no database file starts a new one and deletes the log next to it.
+  if (!std::filesystem::exists(db_file)) {
+    throw Exception("can't find db file to back up");
+  }
+  disk_manager_ = std::make_unique<DiskManager>(db_file);
+  log_reader_ = std::make_unique<LogRecovery>(disk_manager_.get(), nullptr);
+}
+
+BackupManager::~BackupManager() { disk_manager_->ShutDown(); }
+
+BackupStats BackupManager::Backup(const std::string &backup_file, lsn_t base_lsn, uint64_t bytes_per_second) {
+  BackupStats stats;
+  std::ofstream out(backup_file, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    throw Exception("can't create backup file");
+  }
+  BackupHeader header{};
+  header.base_lsn_ = base_lsn;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(BackupHeader));
+
+  // Copy the log first and only then read the master record, which a checkpoint moves before it recycles segments.
+  log_offset_ = -1;
+  next_lsn_ = INVALID_LSN;
+  CopyLog(&out, &stats);
+  header.checkpoint_lsn_ = disk_manager_->ReadMasterRecord();
+  if (header.checkpoint_lsn_ != INVALID_LSN && header.checkpoint_lsn_ < stats.start_lsn_) {
+    throw Exception("log segments were recycled before the backup copied them");
+  }
+  stats.backup_lsn_ = log_reader_->AnalyzeRedoLSN();
+
+  auto start = std::chrono::steady_clock::now();
+  int num_pages = disk_manager_->GetNumPages();
+  char data[PAGE_SIZE];
+  for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+    ReadPage(page_id, data, &stats);
+    // Every page keeps its LSN at the same offset, see Page::GetLSN(). The header page has none.
+    lsn_t lsn;
+    memcpy(&lsn, data + sizeof(page_id_t), sizeof(lsn_t));
+    if (base_lsn == INVALID_LSN || page_id == HEADER_PAGE_ID || lsn <= 0 || lsn >= base_lsn) {
+      uint32_t type = BackupHeader::ENTRY_PAGE;
+      out.write(reinterpret_cast<const char *>(&type), sizeof(uint32_t));
+      out.write(reinterpret_cast<const char *>(&page_id), sizeof(page_id_t));
+      out.write(data, PAGE_SIZE);
+      stats.pages_written_++;
+    }
+    if (page_id % LOG_COPY_INTERVAL == LOG_COPY_INTERVAL - 1) {
+      CopyLog(&out, &stats);
+    }
+    if (bytes_per_second > 0) {
+      std::chrono::duration<double> elapsed(static_cast<double>(stats.pages_read_) * PAGE_SIZE / bytes_per_second);
+      auto due = start + std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+      auto now = std::chrono::steady_clock::now();
+      if (now < due) {
+        std::this_thread::sleep_until(due);
+        stats.throttle_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(due - now).count();
+      }
+    }
+  }
+  // The database wrote no page before the log that describes it, so this covers every page read.
+  CopyLog(&out, &stats);
+
+  header.magic_ = BackupHeader::MAGIC;
+  header.backup_lsn_ = stats.backup_lsn_;
+  header.start_lsn_ = stats.start_lsn_;
+  header.end_lsn_ = stats.end_lsn_;
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(BackupHeader));
+  out.close();
+  if (out.fail()) {
+    throw Exception("can't write backup file");
+  }
+  return stats;
+}
+
+void BackupManager::Restore(const std::vector<std::string> &backup_files, const std::string &db_file) {
+  std::filesystem::remove(db_file);
+  DiskManager disk_manager(db_file);
+  // WriteLog() insists on alternating buffers.
+  std::vector<char> blocks[2] = {std::vector<char>(sizeof(LogBlockHeader) + LOG_BUFFER_SIZE),
+                                 std::vector<char>(sizeof(LogBlockHeader) + LOG_BUFFER_SIZE)};
+  int next_block = 0;
+  lsn_t prev_backup_lsn = INVALID_LSN;
+  BackupHeader header{};
+  char page[PAGE_SIZE];
+  for (size_t i = 0; i < backup_files.size(); i++) {
+    std::ifstream in(backup_files[i], std::ios::binary);
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(BackupHeader)) || header.magic_ != BackupHeader::MAGIC) {
+      throw Exception("incomplete backup file");
+    }
+    if (i > 0 && (header.base_lsn_ == INVALID_LSN || header.base_lsn_ != prev_backup_lsn)) {
+      throw Exception("backup does not build on the one before it");
+    }
+    prev_backup_lsn = header.backup_lsn_;
+    // Pages override those of older backups. Only the log of the last backup is needed.
+    bool last = i + 1 == backup_files.size();
+    uint32_t type;
+    while (in.read(reinterpret_cast<char *>(&type), sizeof(uint32_t))) {
+      if (type == BackupHeader::ENTRY_PAGE) {
+        page_id_t page_id;
+        in.read(reinterpret_cast<char *>(&page_id), sizeof(page_id_t));
+        in.read(page, PAGE_SIZE);
+        disk_manager.WritePage(page_id, page);
+        continue;
+      }
+      char *block = blocks[next_block].data();
+      in.read(block, sizeof(LogBlockHeader));
+      LogBlockHeader block_header;
+      memcpy(&block_header, block, sizeof(LogBlockHeader));
+      in.read(block + sizeof(LogBlockHeader), block_header.size_);
+      if (last) {
+        disk_manager.WriteLog(block, sizeof(LogBlockHeader) + block_header.size_, block_header.first_lsn_);
+        next_block ^= 1;
+      }
+    }
+    if (!in.eof()) {
+      throw Exception("can't read backup file");
+    }
+  }
+  if (header.checkpoint_lsn_ != INVALID_LSN) {
+    disk_manager.WriteMasterRecord(header.checkpoint_lsn_);
+  }
+  disk_manager.ShutDown();
+}
+
+void BackupManager::ReadPage(page_id_t page_id, char *data, BackupStats *stats) {
+  char check[PAGE_SIZE];
+  disk_manager_->ReadPage(page_id, data);
+  stats->pages_read_++;
+  for (;;) {
+    disk_manager_->ReadPage(page_id, check);
+    if (memcmp(data, check, PAGE_SIZE) == 0) {
+      return;
+    }
+    memcpy(data, check, PAGE_SIZE);
+    stats->page_rereads_++;
+  }
+}
+
+void BackupManager::CopyLog(std::ofstream *out, BackupStats *stats) {
+  disk_manager_->RescanLog();
+  if (log_offset_ < 0) {
+    log_offset_ = disk_manager_->GetLogSegmentOffset(0);
+  }
+  std::vector<char> block(sizeof(LogBlockHeader) + LOG_BUFFER_SIZE);
+  while (log_offset_ >= 0) {
+    // The database only starts a segment once the previous one is full, see LogStandby::FindBlock().
+    int next_segment = disk_manager_->GetNextLogSegmentOffset(log_offset_);
+    LogBlockHeader header;
+    int next_offset = log_reader_->ReadLogBlockHeader(log_offset_, &header);
+    if (next_offset >= 0 && next_lsn_ != INVALID_LSN && header.first_lsn_ > next_lsn_) {
+      throw Exception("log segments were recycled before the backup copied them");
+    }
+    if (next_offset < 0 || (next_lsn_ != INVALID_LSN && header.first_lsn_ != next_lsn_)) {
+      if (next_segment < 0) {
+        return;
+      }
+      log_offset_ = next_segment;
+      continue;
+    }
+    disk_manager_->ReadLog(block.data(), next_offset - log_offset_, log_offset_);
+    if (header.checksum_ != LogBlockHeader::Checksum(block.data() + sizeof(LogBlockHeader), header.size_)) {
+      // Still being written, or torn by a crash if the log went on in the next segment since.
+      if (next_segment < 0) {
+        return;
+      }
+      log_offset_ = next_segment;
+      continue;
+    }
+    uint32_t type = BackupHeader::ENTRY_LOG_BLOCK;
+    out->write(reinterpret_cast<const char *>(&type), sizeof(uint32_t));
+    out->write(block.data(), next_offset - log_offset_);
+    if (stats->start_lsn_ == INVALID_LSN) {
+      stats->start_lsn_ = header.first_lsn_;
+    }
+    stats->end_lsn_ = header.last_lsn_;
+    stats->log_bytes_ += next_offset - log_offset_;
+    log_offset_ = next_offset;
+    next_lsn_ = header.last_lsn_ + 1;
+  }
+}
+
+}  // namespace bustub
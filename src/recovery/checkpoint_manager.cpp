@@ -12,16 +12,67 @@
 
 #include "recovery/checkpoint_manager.h"
 
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <utility>
+#include <vector>
+
 namespace bustub {
 
 void CheckpointManager::BeginCheckpoint() {
   // Block all the transactions and ensure that both the WAL and all dirty buffer pool pages are persisted to disk,
   // creating a consistent checkpoint. Do NOT allow transactions to resume at the end of this method, resume them
   // in CheckpointManager::EndCheckpoint() instead. This is for grading purposes.
+  transaction_manager_->BlockAllTransactions();
+  // No transaction is running, so every record before the next LSN belongs to a finished one.
+  lsn_t redo_lsn = log_manager_->GetNextLSN();
+  log_manager_->Flush(redo_lsn - 1);
+  buffer_pool_manager_->FlushAllPages();
+  log_manager_->TruncateLog(redo_lsn);
 }
 
 void CheckpointManager::EndCheckpoint() {
   // Allow transactions to resume, completing the checkpoint.
+  transaction_manager_->ResumeTransactions();
+}
+
+void CheckpointManager::FuzzyCheckpoint() {
+  std::lock_guard<std::mutex> guard(latch_);
+  auto start = std::chrono::steady_clock::now();
+
+  // Write back what is dirty now, so that the redo point moves forward. FlushPage() latches the page, which keeps a
+  // change that is half done out of the image on disk. Pages may be dirtied again right away, the dirty page table
+  // below covers that.
+  uint64_t pages_flushed = 0;
+  for (const auto &entry : buffer_pool_manager_->GetDirtyPageTable()) {
+    pages_flushed += buffer_pool_manager_->FlushPage(entry.first) ? 1 : 0;
+  }
+
+  std::vector<ActiveTxnEntry> active_txns;
+  lsn_t redo_lsn;
+  lsn_t checkpoint_lsn = log_manager_->AppendBeginCheckpoint(&active_txns, &redo_lsn);
+  // Taken after BEGIN_CHECKPOINT, so that every change logged before it is either on disk or covered by a recLSN.
+  std::vector<DirtyPageEntry> dirty_pages = buffer_pool_manager_->GetDirtyPageTable();
+  for (const auto &entry : dirty_pages) {
+    redo_lsn = std::min(redo_lsn, entry.second);
+  }
+  LogRecord log_record(std::move(active_txns), std::move(dirty_pages));
+  log_manager_->Flush(log_manager_->AppendLogRecord(&log_record));
+  // Analysis starts at the checkpoint, but redo needs the log from the oldest change that may be missing on disk, and
+  // undo from the first record of every transaction that it may have to roll back.
+  log_manager_->TruncateLog(redo_lsn, checkpoint_lsn);
+
+  auto duration =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  stats_.checkpoints_++;
+  stats_.pages_flushed_ += pages_flushed;
+  stats_.total_ns_ += duration;
+  stats_.max_ns_ = std::max<uint64_t>(stats_.max_ns_, duration);
+}
+
+CheckpointStats CheckpointManager::GetStats() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return stats_;
 }
 
 }  // namespace bustub
@@ -12,6 +12,12 @@
 
 #include "recovery/log_manager.h"
 
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <limits>
+
+#include "common/util/lz_util.h"
+
 namespace bustub {
 /*
  * set enable_logging = true
@@ -22,33 +28,502 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (flush_thread_ != nullptr) {
+    return;
+  }
+  enable_logging = true;
+  flush_thread_ = new std::thread([this] {
+    std::unique_lock<std::mutex> lock(latch_);
+    // The timeout counts from the last flush of the active buffer rather than from the last wakeup, so that handed
+    // over buffers cannot postpone it: every record is durable at most log_timeout after it was appended.
+    auto deadline = std::chrono::steady_clock::now() + log_timeout;
+    while (enable_logging) {
+      bool woken = cv_.wait_until(lock, deadline,
+                                  [this] { return flush_size_ > 0 || flush_requested_ || !enable_logging; });
+      bool handed_over = flush_size_ > 0;
+      WriteFlushBuffer();
+      // A full buffer that was handed over needs no further work. On a timeout or an explicit request, whatever
+      // sits in the active buffer must go to disk as well.
+      if (!woken || flush_requested_ || !handed_over) {
+        flush_requested_ = false;
+        deadline = std::chrono::steady_clock::now() + log_timeout;
+        lock.unlock();
+        SealActiveBuffer();
+        lock.lock();
+        WriteFlushBuffer();
+      }
+    }
+  });
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  std::thread *flush_thread;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (flush_thread_ == nullptr) {
+      return;
+    }
+    enable_logging = false;
+    flush_thread = flush_thread_;
+    cv_.notify_one();
+  }
+  flush_thread->join();
+  delete flush_thread;
+
+  // Write out whatever was appended after the flush thread's last pass.
+  SealActiveBuffer();
+  std::lock_guard<std::mutex> guard(latch_);
+  WriteFlushBuffer();
+  flush_thread_ = nullptr;
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
  *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
+ * The LSN and the buffer range are reserved together by one fetch-add in Reserve(), so the record can be serialized
+ * without holding any latch. See the class comment in log_manager.h for the sealing protocol.
  */
-lsn_t LogManager::AppendLogRecord(LogRecord *log_record) { return INVALID_LSN; }
+lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
+  char *dest;
+  lsn_t lsn = Reserve(1, log_record->size_, &dest);
+  log_record->lsn_ = lsn;
+  SerializeLogRecord(log_record, dest);
+  CompleteReservation(log_record->size_);
+  return lsn;
+}
+
+lsn_t LogManager::AppendLogRecord(LogRecord *log_record, Transaction *txn, page_id_t page_id) {
+  if (txn == nullptr) {
+    return AppendLogRecord(log_record);
+  }
+  if (!enable_private_log) {
+    return AppendSharedLogRecord(log_record, txn);
+  }
+  // Register before buffering so that a page write can never miss this record. Only the owning thread touches
+  // log_pages_, so it can be read without the latch.
+  if (page_id != INVALID_PAGE_ID && txn->log_pages_.count(page_id) == 0) {
+    std::lock_guard<std::mutex> guard(private_latch_);
+    private_writers_[page_id].insert(txn);
+    txn->log_pages_.insert(page_id);
+  }
+
+  std::lock_guard<std::mutex> guard(txn->log_latch_);
+  auto size = static_cast<uint32_t>(log_record->size_);
+  if (txn->log_buffer_size_ + size > static_cast<uint32_t>(TXN_LOG_BUFFER_SIZE)) {
+    PublishLocked(txn);
+  }
+  if (size > static_cast<uint32_t>(TXN_LOG_BUFFER_SIZE)) {
+    // Too large to be buffered at all: it goes straight to the shared log, after the records buffered before it.
+    return AppendSharedLocked(log_record, txn);
+  }
+  if (txn->log_buffer_ == nullptr) {
+    txn->log_buffer_.reset(new char[TXN_LOG_BUFFER_SIZE]);
+  }
+  SerializeLogRecord(log_record, txn->log_buffer_.get() + txn->log_buffer_size_);
+  txn->log_buffer_size_ += size;
+  txn->log_record_count_++;
+  txn->log_end_buffered_ = IsEndRecord(log_record->log_record_type_);
+  return INVALID_LSN;
+}
+
+lsn_t LogManager::AppendSharedLogRecord(LogRecord *log_record, Transaction *txn) {
+  std::lock_guard<std::mutex> guard(txn->log_latch_);
+  PublishLocked(txn);
+  return AppendSharedLocked(log_record, txn);
+}
+
+lsn_t LogManager::AppendSharedLocked(LogRecord *log_record, Transaction *txn) {
+  bool ends = IsEndRecord(log_record->log_record_type_);
+  auto active_guard = LatchActiveTxns(txn, ends);
+  char *dest;
+  lsn_t lsn = Reserve(1, log_record->size_, &dest);
+  log_record->lsn_ = lsn;
+  log_record->prev_lsn_ = txn->GetPrevLSN();
+  UpdateActiveTxns(txn, lsn, ends);
+  // Before completing, so that a checkpoint that waited for every record before its own sees this one.
+  txn->SetPrevLSN(lsn);
+  SerializeLogRecord(log_record, dest);
+  CompleteReservation(log_record->size_);
+  return lsn;
+}
+
+lsn_t LogManager::AppendBeginCheckpoint(std::vector<ActiveTxnEntry> *active_txns, lsn_t *oldest_lsn) {
+  LogRecord log_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::BEGIN_CHECKPOINT);
+  {
+    std::lock_guard<std::mutex> guard(active_txns_latch_);
+    AppendLogRecord(&log_record);
+  }
+  // Transactions set their last LSN before completing a record, so once everything up to the checkpoint is on disk,
+  // the table below covers every record before it.
+  Flush(log_record.GetLSN());
+
+  // A transaction that ends from here on has its COMMIT or ABORT after the checkpoint, so it may as well be listed.
+  std::lock_guard<std::mutex> guard(active_txns_latch_);
+  active_txns->clear();
+  *oldest_lsn = log_record.GetLSN();
+  for (const auto &entry : active_txns_) {
+    active_txns->emplace_back(entry.first->GetTransactionId(), entry.first->GetPrevLSN());
+    *oldest_lsn = std::min(*oldest_lsn, entry.second);
+  }
+  return log_record.GetLSN();
+}
+
+lsn_t LogManager::PublishPrivateLog(Transaction *txn) {
+  std::lock_guard<std::mutex> guard(txn->log_latch_);
+  return PublishLocked(txn);
+}
+
+lsn_t LogManager::PublishPageWriters(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(private_latch_);
+  lsn_t max_lsn = INVALID_LSN;
+  // Writers that ended since the last write of the page left their last LSN behind. The caller moves the page LSN
+  // past it, so it is only needed once.
+  auto released = released_lsns_.find(page_id);
+  if (released != released_lsns_.end()) {
+    max_lsn = released->second;
+    released_lsns_.erase(released);
+  }
+  auto it = private_writers_.find(page_id);
+  if (it == private_writers_.end()) {
+    return max_lsn;
+  }
+  // Registrations are only dropped when a transaction ends, so a writer whose buffer was already published still
+  // reports the LSN of its last record, which the page write must wait for as well.
+  for (auto *txn : it->second) {
+    std::lock_guard<std::mutex> txn_guard(txn->log_latch_);
+    max_lsn = std::max(max_lsn, PublishLocked(txn));
+  }
+  return max_lsn;
+}
+
+bool LogManager::IsPageLogDurable(page_id_t page_id, lsn_t page_lsn) {
+  lsn_t persistent_lsn = persistent_lsn_;
+  if (page_lsn > persistent_lsn) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(private_latch_);
+  auto released = released_lsns_.find(page_id);
+  if (released != released_lsns_.end() && released->second > persistent_lsn) {
+    return false;
+  }
+  auto it = private_writers_.find(page_id);
+  if (it == private_writers_.end()) {
+    return true;
+  }
+  for (auto *txn : it->second) {
+    std::lock_guard<std::mutex> txn_guard(txn->log_latch_);
+    if (txn->log_record_count_ > 0 || txn->GetPrevLSN() > persistent_lsn) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LogManager::ReleasePrivateLog(Transaction *txn) {
+  BUSTUB_ASSERT(txn->log_record_count_ == 0, "Releasing a private log with unpublished records.");
+  if (txn->log_pages_.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(private_latch_);
+  for (auto page_id : txn->log_pages_) {
+    auto it = private_writers_.find(page_id);
+    it->second.erase(txn);
+    if (it->second.empty()) {
+      private_writers_.erase(it);
+    }
+    auto released = released_lsns_.emplace(page_id, txn->GetPrevLSN()).first;
+    released->second = std::max(released->second, txn->GetPrevLSN());
+  }
+  txn->log_pages_.clear();
+}
+
+lsn_t LogManager::PublishLocked(Transaction *txn) {
+  if (txn->log_record_count_ == 0) {
+    return txn->GetPrevLSN();
+  }
+  bool ends = txn->log_end_buffered_;
+  auto active_guard = LatchActiveTxns(txn, ends);
+  char *dest;
+  uint32_t size = txn->log_buffer_size_;
+  lsn_t lsn = Reserve(txn->log_record_count_, size, &dest);
+  memcpy(dest, txn->log_buffer_.get(), size);
+  UpdateActiveTxns(txn, lsn, ends);
+
+  // Patch the LSNs in, chaining every record to the one before it.
+  lsn_t prev_lsn = txn->GetPrevLSN();
+  for (uint32_t pos = 0; pos < size; pos += *reinterpret_cast<int32_t *>(dest + pos), lsn++) {
+    memcpy(dest + pos + OFFSET_LSN, &lsn, sizeof(lsn_t));
+    memcpy(dest + pos + OFFSET_PREV_LSN, &prev_lsn, sizeof(lsn_t));
+    prev_lsn = lsn;
+  }
+  txn->SetPrevLSN(prev_lsn);
+  CompleteReservation(size);
+
+  txn->log_buffer_size_ = 0;
+  txn->log_record_count_ = 0;
+  txn->log_end_buffered_ = false;
+  return prev_lsn;
+}
+
+std::unique_lock<std::mutex> LogManager::LatchActiveTxns(Transaction *txn, bool ends) {
+  // Only the first and the last record of a transaction change the table.
+  if (txn->GetPrevLSN() == INVALID_LSN || ends) {
+    return std::unique_lock<std::mutex>(active_txns_latch_);
+  }
+  return std::unique_lock<std::mutex>();
+}
+
+void LogManager::UpdateActiveTxns(Transaction *txn, lsn_t first_lsn, bool ends) {
+  if (ends) {
+    active_txns_.erase(txn);
+  } else if (txn->GetPrevLSN() == INVALID_LSN) {
+    active_txns_[txn] = first_lsn;
+  }
+}
+
+lsn_t LogManager::Reserve(uint32_t count, uint32_t size, char **dest) {
+  BUSTUB_ASSERT(size <= static_cast<uint32_t>(LOG_BUFFER_SIZE), "Reservation does not fit in the log buffer.");
+
+  while (true) {
+    uint64_t old = reservation_.fetch_add(Pack(count, size), std::memory_order_acq_rel);
+    uint32_t offset = UnpackOffset(old);
+    lsn_t lsn = UnpackLSN(old);
+
+    if (offset + size <= static_cast<uint32_t>(LOG_BUFFER_SIZE)) {
+      // Fast path: the reservation fits in the active buffer.
+      *dest = log_buffer_ + offset;
+      return lsn;
+    }
+
+    if (offset <= static_cast<uint32_t>(LOG_BUFFER_SIZE)) {
+      // This reservation crossed the end of the buffer, which makes us responsible for sealing it. Our records keep
+      // their LSNs and go to the start of the next buffer.
+      SealBuffer(offset, lsn, count, size);
+      *dest = log_buffer_;
+      return lsn;
+    }
+
+    // Somebody else is sealing the buffer. Our LSNs will be handed out again once the buffer reopens.
+    std::unique_lock<std::mutex> guard(latch_);
+    reopen_cv_.wait(guard, [this] { return UnpackOffset(reservation_.load()) <= LOG_BUFFER_SIZE; });
+  }
+}
+
+void LogManager::RequestFlush() {
+  std::unique_lock<std::mutex> guard(latch_, std::try_to_lock);
+  if (!guard.owns_lock() || flush_thread_ == nullptr) {
+    return;
+  }
+  flush_requested_ = true;
+  cv_.notify_one();
+}
+
+void LogManager::Flush(lsn_t lsn) {
+  std::unique_lock<std::mutex> guard(latch_);
+  while (persistent_lsn_ < lsn) {
+    if (flush_thread_ == nullptr) {
+      // Nobody to hand the work to, so flush inline.
+      guard.unlock();
+      SealActiveBuffer();
+      guard.lock();
+      WriteFlushBuffer();
+      return;
+    }
+    // Group commit: every waiter piggybacks on the next write of the flush thread.
+    flush_requested_ = true;
+    cv_.notify_one();
+    flushed_cv_.wait(guard);
+  }
+}
+
+void LogManager::SerializeLogRecord(LogRecord *log_record, char *dest) {
+  // First, serialize the must have fields (20 bytes in total).
+  memcpy(dest, log_record, LogRecord::HEADER_SIZE);
+  int pos = LogRecord::HEADER_SIZE;
+
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      memcpy(dest + pos, &log_record->insert_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->insert_tuple_.SerializeTo(dest + pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(dest + pos, &log_record->delete_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->delete_tuple_.SerializeTo(dest + pos);
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(dest + pos, &log_record->update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->old_tuple_.SerializeTo(dest + pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      log_record->new_tuple_.SerializeTo(dest + pos);
+      break;
+    case LogRecordType::NEWPAGE:
+      memcpy(dest + pos, &log_record->prev_page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(dest + pos, &log_record->page_id_, sizeof(page_id_t));
+      break;
+    case LogRecordType::DELTAUPDATE: {
+      memcpy(dest + pos, &log_record->update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      auto delta_size = static_cast<uint32_t>(log_record->delta_.size());
+      memcpy(dest + pos, &log_record->old_size_, sizeof(uint32_t));
+      memcpy(dest + pos + sizeof(uint32_t), &log_record->new_size_, sizeof(uint32_t));
+      memcpy(dest + pos + 2 * sizeof(uint32_t), &delta_size, sizeof(uint32_t));
+      pos += 3 * sizeof(uint32_t);
+      memcpy(dest + pos, log_record->delta_.data(), delta_size);
+      break;
+    }
+    case LogRecordType::END_CHECKPOINT: {
+      auto txn_count = static_cast<uint32_t>(log_record->active_txns_.size());
+      memcpy(dest + pos, &txn_count, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      memcpy(dest + pos, log_record->active_txns_.data(), txn_count * sizeof(ActiveTxnEntry));
+      pos += txn_count * sizeof(ActiveTxnEntry);
+      auto page_count = static_cast<uint32_t>(log_record->dirty_pages_.size());
+      memcpy(dest + pos, &page_count, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      memcpy(dest + pos, log_record->dirty_pages_.data(), page_count * sizeof(DirtyPageEntry));
+      break;
+    }
+    case LogRecordType::INDEXINSERT:
+    case LogRecordType::INDEXDELETE: {
+      auto entry_size = static_cast<uint32_t>(log_record->index_entry_.size());
+      memcpy(dest + pos, &log_record->index_page_id_, sizeof(page_id_t));
+      memcpy(dest + pos + sizeof(page_id_t), &log_record->index_slot_, sizeof(int32_t));
+      memcpy(dest + pos + sizeof(page_id_t) + sizeof(int32_t), &entry_size, sizeof(uint32_t));
+      pos += sizeof(page_id_t) + sizeof(int32_t) + sizeof(uint32_t);
+      memcpy(dest + pos, log_record->index_entry_.data(), entry_size);
+      break;
+    }
+    case LogRecordType::INDEXSMO: {
+      auto write_count = static_cast<uint32_t>(log_record->index_writes_.size());
+      memcpy(dest + pos, &write_count, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      memcpy(dest + pos, log_record->index_writes_.data(), write_count * sizeof(IndexPageWrite));
+      pos += write_count * sizeof(IndexPageWrite);
+      memcpy(dest + pos, log_record->index_data_.data(), log_record->index_data_.size());
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void LogManager::SealBuffer(uint32_t end_offset, lsn_t next_lsn, uint32_t first_count, uint32_t first_size) {
+  // Wait until every appender that reserved space before the seal point has finished serializing.
+  while (filled_.load(std::memory_order_acquire) != end_offset) {
+    std::this_thread::yield();
+  }
+
+  std::lock_guard<std::mutex> guard(latch_);
+  if (end_offset > 0) {
+    // The previously sealed buffer has to reach the disk before its memory can be reused.
+    WriteFlushBuffer();
+    std::swap(log_buffer_, flush_buffer_);
+    flush_size_ = end_offset;
+    flush_lsn_ = next_lsn - 1;
+    cv_.notify_one();
+  }
+  // Reset the watermark before the reopened word becomes visible to appenders.
+  filled_.store(0, std::memory_order_relaxed);
+  reservation_.store(Pack(next_lsn + first_count, first_size), std::memory_order_release);
+  reopen_cv_.notify_all();
+}
+
+void LogManager::SealActiveBuffer() {
+  // Push the offset past the end of the buffer without consuming an LSN.
+  uint64_t old = reservation_.fetch_add(LOG_BUFFER_SIZE + 1, std::memory_order_acq_rel);
+  uint32_t offset = UnpackOffset(old);
+  if (offset <= static_cast<uint32_t>(LOG_BUFFER_SIZE)) {
+    SealBuffer(offset, UnpackLSN(old), 0, 0);
+    return;
+  }
+  // Another thread is already sealing; its buffer is handed over by the time it reopens.
+  std::unique_lock<std::mutex> guard(latch_);
+  reopen_cv_.wait(guard, [this] { return UnpackOffset(reservation_.load()) <= LOG_BUFFER_SIZE; });
+}
+
+void LogManager::WriteFlushBuffer() {
+  if (flush_size_ == 0) {
+    return;
+  }
+  char *block = block_buffers_[next_block_buffer_];
+  next_block_buffer_ ^= 1;
+  char *payload = block + sizeof(LogBlockHeader);
+
+  LogBlockHeader header{};
+  header.uncompressed_size_ = flush_size_;
+  memcpy(&header.first_lsn_, flush_buffer_ + OFFSET_LSN, sizeof(lsn_t));
+  header.last_lsn_ = flush_lsn_;
+  if (enable_log_compression) {
+    auto start = std::chrono::steady_clock::now();
+    // Only keep the compressed form if it is smaller.
+    header.size_ = LZUtil::Compress(flush_buffer_, flush_size_, payload, flush_size_ - 1);
+    compression_stats_.compress_ns_ +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+  if (header.size_ > 0) {
+    header.flags_ = LogBlockHeader::FLAG_COMPRESSED;
+    compression_stats_.compressed_blocks_++;
+  } else {
+    header.size_ = flush_size_;
+    memcpy(payload, flush_buffer_, flush_size_);
+  }
+  header.checksum_ = LogBlockHeader::Checksum(payload, header.size_);
+  memcpy(block, &header, sizeof(LogBlockHeader));
+  disk_manager_->WriteLog(block, sizeof(LogBlockHeader) + header.size_, header.first_lsn_);
+
+  compression_stats_.blocks_++;
+  compression_stats_.raw_bytes_ += flush_size_;
+  compression_stats_.written_bytes_ += sizeof(LogBlockHeader) + header.size_;
+  flush_size_ = 0;
+  persistent_lsn_ = flush_lsn_;
+  flushed_cv_.notify_all();
+}
+
+lsn_t LogManager::FindEndOfLog() {
+  // A block only goes to a new segment if it does not fit in the previous one, so the log ends in the last segment.
+  int offset = disk_manager_->GetLogSegmentOffset(std::numeric_limits<lsn_t>::max());
+  if (offset < 0) {
+    return 0;
+  }
+  lsn_t segment_lsn = disk_manager_->GetLogSegmentLSN(offset);
+  lsn_t next_lsn = segment_lsn;
+  LogBlockHeader header;
+  std::vector<char> payload(LOG_BUFFER_SIZE);
+  while (disk_manager_->ReadLog(reinterpret_cast<char *>(&header), sizeof(LogBlockHeader), offset) &&
+         header.IsValid(offset, segment_lsn) && header.first_lsn_ == next_lsn) {
+    // A torn last block is not part of the log; its LSNs are handed out again so that the log stays dense.
+    disk_manager_->ReadLog(payload.data(), header.size_, offset + sizeof(LogBlockHeader));
+    if (header.checksum_ != LogBlockHeader::Checksum(payload.data(), header.size_)) {
+      break;
+    }
+    next_lsn = header.last_lsn_ + 1;
+    offset += sizeof(LogBlockHeader) + header.size_;
+  }
+  return next_lsn;
+}
+
+void LogManager::TruncateLog(lsn_t redo_lsn, lsn_t checkpoint_lsn) {
+  // The master record moves first, so that recovery never looks for a segment that is gone.
+  disk_manager_->WriteMasterRecord(checkpoint_lsn == INVALID_LSN ? redo_lsn : checkpoint_lsn);
+  disk_manager_->TruncateLog(redo_lsn);
+}
+
+LogCompressionStats LogManager::GetCompressionStats() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return compression_stats_;
+}
 
 }  // namespace bustub
@@ -12,6 +12,15 @@
 
 #include "recovery/log_recovery.h"
 
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <cstring>
+#include <deque>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/util/lz_util.h"
+#include "storage/page/b_plus_tree_leaf_page.h"
 #include "storage/page/table_page.h"
 
 namespace bustub {
@@ -20,21 +29,803 @@ namespace bustub {
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
  */
-bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) { return false; }
+bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) {
+  // The header holds the must have fields (20 bytes in total).
+  memcpy(static_cast<void *>(log_record), data, LogRecord::HEADER_SIZE);
+  if (log_record->size_ < LogRecord::HEADER_SIZE || log_record->lsn_ == INVALID_LSN ||
+      log_record->log_record_type_ <= LogRecordType::INVALID ||
+      log_record->log_record_type_ > LogRecordType::INDEXSMO) {
+    return false;
+  }
+  int pos = LogRecord::HEADER_SIZE;
+
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      memcpy(&log_record->insert_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->insert_tuple_.DeserializeFrom(data + pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(&log_record->delete_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->delete_tuple_.DeserializeFrom(data + pos);
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(&log_record->update_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->old_tuple_.DeserializeFrom(data + pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      log_record->new_tuple_.DeserializeFrom(data + pos);
+      break;
+    case LogRecordType::NEWPAGE:
+      memcpy(&log_record->prev_page_id_, data + pos, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(&log_record->page_id_, data + pos, sizeof(page_id_t));
+      break;
+    case LogRecordType::DELTAUPDATE: {
+      memcpy(&log_record->update_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      uint32_t delta_size;
+      memcpy(&log_record->old_size_, data + pos, sizeof(uint32_t));
+      memcpy(&log_record->new_size_, data + pos + sizeof(uint32_t), sizeof(uint32_t));
+      memcpy(&delta_size, data + pos + 2 * sizeof(uint32_t), sizeof(uint32_t));
+      pos += 3 * sizeof(uint32_t);
+      log_record->delta_.assign(data + pos, data + pos + delta_size);
+      break;
+    }
+    case LogRecordType::END_CHECKPOINT: {
+      uint32_t txn_count;
+      memcpy(&txn_count, data + pos, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      log_record->active_txns_.resize(txn_count);
+      memcpy(static_cast<void *>(log_record->active_txns_.data()), data + pos, txn_count * sizeof(ActiveTxnEntry));
+      pos += txn_count * sizeof(ActiveTxnEntry);
+      uint32_t page_count;
+      memcpy(&page_count, data + pos, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      log_record->dirty_pages_.resize(page_count);
+      memcpy(static_cast<void *>(log_record->dirty_pages_.data()), data + pos, page_count * sizeof(DirtyPageEntry));
+      break;
+    }
+    case LogRecordType::INDEXINSERT:
+    case LogRecordType::INDEXDELETE: {
+      uint32_t entry_size;
+      memcpy(&log_record->index_page_id_, data + pos, sizeof(page_id_t));
+      memcpy(&log_record->index_slot_, data + pos + sizeof(page_id_t), sizeof(int32_t));
+      memcpy(&entry_size, data + pos + sizeof(page_id_t) + sizeof(int32_t), sizeof(uint32_t));
+      pos += sizeof(page_id_t) + sizeof(int32_t) + sizeof(uint32_t);
+      log_record->index_entry_.assign(data + pos, data + pos + entry_size);
+      break;
+    }
+    case LogRecordType::INDEXSMO: {
+      uint32_t write_count;
+      memcpy(&write_count, data + pos, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      log_record->index_writes_.resize(write_count);
+      memcpy(static_cast<void *>(log_record->index_writes_.data()), data + pos, write_count * sizeof(IndexPageWrite));
+      pos += write_count * sizeof(IndexPageWrite);
+      log_record->index_data_.assign(data + pos, data + log_record->size_);
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
+
+/*
+ * analysis phase: read the log from the begin checkpoint record named by the master record (from the start of the log
+ * if there is none) and rebuild active_txn_ & dirty_page_table_
+ */
+void LogRecovery::Analysis() {
+  active_txn_.clear();
+  dirty_page_table_.clear();
+  lsn_mapping_.clear();
+  // Transactions that ended after the checkpoint began, which its active transaction table may still list.
+  std::unordered_set<txn_id_t> ended_txns;
+  std::vector<page_id_t> pages;
+  lsn_t start_lsn = disk_manager_->ReadMasterRecord();
+  ScanLog(start_lsn == INVALID_LSN ? 0 : start_lsn, [&](LogRecord *log_record) {
+    stats_.analyzed_records_++;
+    lsn_t lsn = log_record->GetLSN();
+    switch (log_record->GetLogRecordType()) {
+      case LogRecordType::BEGIN_CHECKPOINT:
+        break;
+      case LogRecordType::END_CHECKPOINT:
+        // The tables were taken after BEGIN_CHECKPOINT, so the records in between may be accounted for already.
+        for (const auto &entry : log_record->GetActiveTxns()) {
+          if (ended_txns.count(entry.first) == 0) {
+            auto it = active_txn_.emplace(entry.first, entry.second).first;
+            it->second = std::max(it->second, entry.second);
+          }
+        }
+        for (const auto &entry : log_record->GetDirtyPages()) {
+          auto it = dirty_page_table_.emplace(entry.first, entry.second).first;
+          it->second = std::min(it->second, entry.second);
+        }
+        break;
+      case LogRecordType::COMMIT:
+      case LogRecordType::ABORT:
+        active_txn_.erase(log_record->GetTxnId());
+        ended_txns.insert(log_record->GetTxnId());
+        break;
+      default: {
+        active_txn_[log_record->GetTxnId()] = lsn;
+        GetRecordPages(log_record, &pages);
+        for (page_id_t page_id : pages) {
+          dirty_page_table_.emplace(page_id, lsn);
+        }
+        break;
+      }
+    }
+    return true;
+  });
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
- *read log file from the beginning to end (you must prefetch log records into
- *log buffer to reduce unnecessary I/O operations), remember to compare page's
- *LSN with log_record's sequence number, and also build active_txn_ table &
- *lsn_mapping_ table
+ *read the log from the smallest recLSN of the dirty page table to its end, skip the records whose page holds them
+ *according to the dirty page table, and compare page's LSN with log_record's sequence number for the others
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  stats_ = RecoveryStats();
+  Analysis();
+  if (dirty_page_table_.empty()) {
+    return;
+  }
+  lsn_t redo_lsn = dirty_page_table_.begin()->second;
+  for (const auto &entry : dirty_page_table_) {
+    redo_lsn = std::min(redo_lsn, entry.second);
+  }
+  auto start = std::chrono::steady_clock::now();
+  int num_workers = std::min<int>(redo_threads, buffer_pool_manager_->GetPoolSize());
+  if (num_workers > 1) {
+    ParallelRedo(redo_lsn, num_workers);
+  } else {
+    std::vector<page_id_t> pages;
+    ScanLog(redo_lsn, [&](LogRecord *log_record) {
+      stats_.redo_records_++;
+      GetRecordPages(log_record, &pages);
+      int num_pages = static_cast<int>(pages.size());
+      bool skipped = num_pages > 0;
+      for (int i = num_pages - 1; i >= 0; i--) {
+        if (NeedsRedo(pages[i], log_record->GetLSN())) {
+          skipped = false;
+          stats_.redone_records_ += RedoLogRecord(log_record, pages[i]) ? 1 : 0;
+        }
+      }
+      stats_.skipped_records_ += skipped ? 1 : 0;
+      return true;
+    });
+  }
+  stats_.redo_ns_ =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/** Records are handed to the redo workers in batches of this many, and each worker queues this many batches. */
+static constexpr size_t REDO_BATCH_SIZE = 64;
+static constexpr size_t REDO_QUEUE_DEPTH = 16;
+
+struct LogRecovery::RedoWorker {
+  std::thread thread_;
+  /** Protects batches_ and done_. */
+  std::mutex latch_;
+  /** Wakes the worker when a batch arrives, and the reader when the queue has room. */
+  std::condition_variable cv_;
+  std::deque<std::vector<std::pair<LogRecord, page_id_t>>> batches_;
+  bool done_{false};
+  /** Only touched by the worker thread until it is joined. */
+  uint64_t redone_records_{0};
+};
+
+void LogRecovery::ParallelRedo(lsn_t redo_lsn, int num_workers) {
+  std::vector<RedoWorker> workers(num_workers);
+  std::vector<std::vector<std::pair<LogRecord, page_id_t>>> batches(num_workers);
+  for (auto &worker : workers) {
+    worker.thread_ = std::thread(&LogRecovery::RunRedoWorker, this, &worker);
+  }
+  auto hand_over = [&](int i) {
+    RedoWorker &worker = workers[i];
+    std::unique_lock<std::mutex> lock(worker.latch_);
+    worker.cv_.wait(lock, [&] { return worker.batches_.size() < REDO_QUEUE_DEPTH; });
+    worker.batches_.push_back(std::move(batches[i]));
+    lock.unlock();
+    worker.cv_.notify_all();
+    batches[i].clear();
+  };
+
+  std::vector<page_id_t> pages;
+  ScanLog(redo_lsn, [&](LogRecord *log_record) {
+    stats_.redo_records_++;
+    GetRecordPages(log_record, &pages);
+    int num_pages = static_cast<int>(pages.size());
+    bool skipped = num_pages > 0;
+    for (int i = num_pages - 1; i >= 0; i--) {
+      if (!NeedsRedo(pages[i], log_record->GetLSN())) {
+        continue;
+      }
+      skipped = false;
+      // The owner of a page sees its records in log order, which is all that redo needs.
+      int owner = static_cast<int>(std::hash<page_id_t>()(pages[i]) % num_workers);
+      batches[owner].emplace_back(*log_record, pages[i]);
+      if (batches[owner].size() == REDO_BATCH_SIZE) {
+        hand_over(owner);
+      }
+    }
+    stats_.skipped_records_ += skipped ? 1 : 0;
+    return true;
+  });
+
+  for (int i = 0; i < num_workers; i++) {
+    if (!batches[i].empty()) {
+      hand_over(i);
+    }
+    {
+      std::lock_guard<std::mutex> guard(workers[i].latch_);
+      workers[i].done_ = true;
+    }
+    workers[i].cv_.notify_all();
+  }
+  for (auto &worker : workers) {
+    worker.thread_.join();
+    stats_.redone_records_ += worker.redone_records_;
+  }
+}
+
+void LogRecovery::RunRedoWorker(RedoWorker *worker) {
+  std::unique_lock<std::mutex> lock(worker->latch_);
+  while (true) {
+    worker->cv_.wait(lock, [&] { return !worker->batches_.empty() || worker->done_; });
+    if (worker->batches_.empty()) {
+      return;
+    }
+    auto batch = std::move(worker->batches_.front());
+    worker->batches_.pop_front();
+    lock.unlock();
+    worker->cv_.notify_all();
+    for (auto &entry : batch) {
+      worker->redone_records_ += RedoLogRecord(&entry.first, entry.second) ? 1 : 0;
+    }
+    lock.lock();
+  }
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
- *iterate through active txn map and undo each operation
+ *iterate through active txn map and undo each operation. Each change undone is logged as a record of the loser that
+ *continues its chain, and the loser ends with an ABORT record, so that recovery after another crash repeats the
+ *rollback with redo instead of undoing the changes again
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  BUSTUB_ASSERT(log_manager_ != nullptr, "Undo logs the changes it rolls back.");
+  LogBlockHeader header;
+  LogRecord log_record;
+  // Consecutive records of a transaction tend to share a block, so keep the last one around.
+  offset_ = -1;
+  for (const auto &txn : active_txn_) {
+    lsn_t lsn = txn.second;
+    lsn_t last_lsn = txn.second;
+    while (lsn != INVALID_LSN) {
+      if (lsn_mapping_.count(lsn) == 0) {
+        // The record comes before anything that analysis and redo read. Finding it leaves its block in log_buffer_.
+        ScanLog(lsn, [](LogRecord *) { return false; });
+      }
+      BUSTUB_ASSERT(lsn_mapping_.count(lsn) > 0, "Undo chain points outside of the log.");
+      auto position = lsn_mapping_[lsn];
+      if (position.first != offset_) {
+        offset_ = position.first;
+        bool read = ReadLogBlock(offset_, log_buffer_, &header) >= 0;
+        BUSTUB_ASSERT(read, "Undo chain points to a broken log block.");
+      }
+      bool deserialized = DeserializeLogRecord(log_buffer_ + position.second, &log_record);
+      BUSTUB_ASSERT(deserialized, "Undo chain points to a broken log record.");
+      last_lsn = UndoLogRecord(&log_record, last_lsn);
+      lsn = log_record.GetPrevLSN();
+    }
+    LogRecord abort_record(txn.first, last_lsn, LogRecordType::ABORT);
+    log_manager_->Flush(log_manager_->AppendLogRecord(&abort_record));
+  }
+  active_txn_.clear();
+  dirty_page_table_.clear();
+  lsn_mapping_.clear();
+}
+
+void LogRecovery::ScanLog(lsn_t start_lsn, const std::function<bool(LogRecord *)> &visit) {
+  LogBlockHeader header;
+  LogRecord log_record;
+  lsn_t expected_lsn = INVALID_LSN;
+  for (offset_ = disk_manager_->GetLogSegmentOffset(start_lsn); offset_ >= 0;) {
+    int next_offset = ReadLogBlockHeader(offset_, &header);
+    bool skip = header.last_lsn_ < start_lsn;
+    if (next_offset >= 0 && !skip) {
+      next_offset = ReadLogBlock(offset_, log_buffer_, &header);
+    }
+    if (next_offset < 0) {
+      // The rest of the segment is unused, the log goes on in the next one.
+      offset_ = disk_manager_->GetNextLogSegmentOffset(offset_);
+      continue;
+    }
+    if (expected_lsn != INVALID_LSN && header.first_lsn_ != expected_lsn) {
+      // End of the log.
+      break;
+    }
+    expected_lsn = header.last_lsn_ + 1;
+    for (uint32_t pos = 0; !skip && pos < header.uncompressed_size_; pos += log_record.GetSize()) {
+      bool deserialized = DeserializeLogRecord(log_buffer_ + pos, &log_record);
+      BUSTUB_ASSERT(deserialized, "Log block holds a broken log record.");
+      lsn_mapping_[log_record.GetLSN()] = std::make_pair(offset_, pos);
+      if (log_record.GetLSN() >= start_lsn && !visit(&log_record)) {
+        return;
+      }
+    }
+    offset_ = next_offset;
+  }
+}
+
+void LogRecovery::StartRedoOnDemand() {
+  stats_ = RecoveryStats();
+  redo_start_ = std::chrono::steady_clock::now();
+  Analysis();
+  if (!dirty_page_table_.empty()) {
+    lsn_t redo_lsn = dirty_page_table_.begin()->second;
+    for (const auto &entry : dirty_page_table_) {
+      redo_lsn = std::min(redo_lsn, entry.second);
+    }
+    std::vector<page_id_t> pages;
+    ScanLog(redo_lsn, [&](LogRecord *log_record) {
+      stats_.redo_records_++;
+      GetRecordPages(log_record, &pages);
+      int num_pages = static_cast<int>(pages.size());
+      bool skipped = num_pages > 0;
+      for (int i = num_pages - 1; i >= 0; i--) {
+        if (NeedsRedo(pages[i], log_record->GetLSN())) {
+          skipped = false;
+          const auto &position = lsn_mapping_[log_record->GetLSN()];
+          pending_records_[pages[i]].push_back(
+              {log_record->GetLSN(), position.first, static_cast<uint32_t>(position.second)});
+        }
+      }
+      stats_.skipped_records_ += skipped ? 1 : 0;
+      return true;
+    });
+  }
+  buffer_pool_manager_->SetRedoOnDemand(this);
+  redo_thread_ = std::thread(&LogRecovery::RunRedoOnDemand, this);
+}
+
+void LogRecovery::FinishRedoOnDemand() {
+  if (redo_thread_.joinable()) {
+    redo_thread_.join();
+    buffer_pool_manager_->SetRedoOnDemand(nullptr);
+  }
+}
+
+lsn_t LogRecovery::RedoPage(Page *page) {
+  std::lock_guard<std::mutex> guard(pending_latch_);
+  auto it = pending_records_.find(page->GetPageId());
+  if (it == pending_records_.end()) {
+    return INVALID_LSN;
+  }
+  LogBlockHeader header;
+  LogRecord log_record;
+  for (const auto &record : it->second) {
+    if (record.block_offset_ != pending_offset_) {
+      pending_offset_ = record.block_offset_;
+      bool read = ReadLogBlock(pending_offset_, pending_log_buffer_, &header, pending_block_buffer_) >= 0;
+      BUSTUB_ASSERT(read, "Pending redo points to a broken log block.");
+    }
+    bool deserialized = DeserializeLogRecord(pending_log_buffer_ + record.pos_, &log_record);
+    BUSTUB_ASSERT(deserialized, "Pending redo points to a broken log record.");
+    stats_.redone_records_ += RedoLogRecord(&log_record, reinterpret_cast<TablePage *>(page)) ? 1 : 0;
+  }
+  lsn_t first_lsn = it->second.front().lsn_;
+  pending_records_.erase(it);
+  return first_lsn;
+}
+
+void LogRecovery::GetPendingPages(std::vector<DirtyPageEntry> *dirty_pages) {
+  std::lock_guard<std::mutex> guard(pending_latch_);
+  for (const auto &entry : pending_records_) {
+    dirty_pages->emplace_back(entry.first, entry.second.front().lsn_);
+  }
+}
+
+void LogRecovery::RunRedoOnDemand() {
+  while (true) {
+    page_id_t page_id;
+    {
+      std::lock_guard<std::mutex> guard(pending_latch_);
+      if (pending_records_.empty()) {
+        break;
+      }
+      page_id = pending_records_.begin()->first;
+    }
+    // Reading the page in is enough, the buffer pool redoes it.
+    if (buffer_pool_manager_->FetchPage(page_id) == nullptr) {
+      // Every frame is pinned, let the pinning threads make progress.
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    buffer_pool_manager_->UnpinPage(page_id, false);
+  }
+  std::lock_guard<std::mutex> guard(pending_latch_);
+  stats_.redo_ns_ =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - redo_start_).count();
+}
+
+int LogRecovery::ReadLogBlockHeader(int offset, LogBlockHeader *header) {
+  if (!disk_manager_->ReadLog(reinterpret_cast<char *>(header), sizeof(LogBlockHeader), offset)) {
+    return -1;
+  }
+  // Zeroes or stale bytes mark the end of the used part of a segment.
+  if (!header->IsValid(offset, disk_manager_->GetLogSegmentLSN(offset))) {
+    return -1;
+  }
+  return offset + sizeof(LogBlockHeader) + header->size_;
+}
+
+int LogRecovery::ReadLogBlock(int offset, char *data, LogBlockHeader *header) {
+  return ReadLogBlock(offset, data, header, block_buffer_);
+}
+
+int LogRecovery::ReadLogBlock(int offset, char *data, LogBlockHeader *header, char *scratch) {
+  int next_offset = ReadLogBlockHeader(offset, header);
+  if (next_offset < 0) {
+    return -1;
+  }
+  bool compressed = (header->flags_ & LogBlockHeader::FLAG_COMPRESSED) != 0;
+  char *payload = compressed ? scratch : data;
+  disk_manager_->ReadLog(payload, header->size_, offset + sizeof(LogBlockHeader));
+  // A payload that does not match its checksum was cut short by a crash, or is still being written.
+  if (header->checksum_ != LogBlockHeader::Checksum(payload, header->size_)) {
+    return -1;
+  }
+  if (!compressed) {
+    return header->size_ == header->uncompressed_size_ ? next_offset : -1;
+  }
+  return LZUtil::Decompress(scratch, header->size_, data, header->uncompressed_size_) ? next_offset : -1;
+}
+
+lsn_t LogRecovery::AnalyzeRedoLSN() {
+  Analysis();
+  // Without dirty pages, everything that the log holds is on disk.
+  lsn_t redo_lsn = 0;
+  for (const auto &entry : lsn_mapping_) {
+    redo_lsn = std::max(redo_lsn, entry.first + 1);
+  }
+  for (const auto &entry : dirty_page_table_) {
+    redo_lsn = std::min(redo_lsn, entry.second);
+  }
+  active_txn_.clear();
+  dirty_page_table_.clear();
+  lsn_mapping_.clear();
+  return redo_lsn;
+}
+
+int LogRecovery::ReplayLogBlock(int offset, LogBlockHeader *header, lsn_t first_lsn, lsn_t last_lsn) {
+  int next_offset = ReadLogBlock(offset, log_buffer_, header);
+  if (next_offset < 0) {
+    return -1;
+  }
+  LogRecord log_record;
+  std::vector<page_id_t> pages;
+  for (uint32_t pos = 0; pos < header->uncompressed_size_; pos += log_record.GetSize()) {
+    bool deserialized = DeserializeLogRecord(log_buffer_ + pos, &log_record);
+    BUSTUB_ASSERT(deserialized, "Log block holds a broken log record.");
+    if (log_record.GetLSN() < first_lsn) {
+      continue;
+    }
+    if (log_record.GetLSN() > last_lsn) {
+      break;
+    }
+    stats_.redo_records_++;
+    GetRecordPages(&log_record, &pages);
+    for (int i = static_cast<int>(pages.size()) - 1; i >= 0; i--) {
+      stats_.redone_records_ += RedoLogRecord(&log_record, pages[i]) ? 1 : 0;
+    }
+  }
+  return next_offset;
+}
+
+int LogRecovery::ScanLogBlockTxns(int offset, LogBlockHeader *header, std::unordered_set<txn_id_t> *open_txns,
+                                  lsn_t *closed_lsn) {
+  int next_offset = ReadLogBlock(offset, log_buffer_, header);
+  if (next_offset < 0) {
+    return -1;
+  }
+  LogRecord log_record;
+  for (uint32_t pos = 0; pos < header->uncompressed_size_; pos += log_record.GetSize()) {
+    bool deserialized = DeserializeLogRecord(log_buffer_ + pos, &log_record);
+    BUSTUB_ASSERT(deserialized, "Log block holds a broken log record.");
+    LogRecordType type = log_record.GetLogRecordType();
+    if (type == LogRecordType::COMMIT || type == LogRecordType::ABORT) {
+      open_txns->erase(log_record.GetTxnId());
+    } else if (log_record.GetTxnId() != INVALID_TXN_ID) {
+      open_txns->insert(log_record.GetTxnId());
+    }
+    if (open_txns->empty()) {
+      *closed_lsn = log_record.GetLSN();
+    }
+  }
+  return next_offset;
+}
+
+bool LogRecovery::NeedsRedo(page_id_t page_id, lsn_t lsn) {
+  auto it = dirty_page_table_.find(page_id);
+  return it != dirty_page_table_.end() && it->second <= lsn;
+}
+
+void LogRecovery::GetRecordPages(LogRecord *log_record, std::vector<page_id_t> *pages) {
+  pages->clear();
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::NEWPAGE:
+      // Linking the previous page is not logged on its own, so the record covers it as well.
+      pages->push_back(log_record->GetNewPageId());
+      if (log_record->GetNewPageRecord() != INVALID_PAGE_ID) {
+        pages->push_back(log_record->GetNewPageRecord());
+      }
+      break;
+    case LogRecordType::INSERT:
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+    case LogRecordType::UPDATE:
+    case LogRecordType::DELTAUPDATE:
+      pages->push_back(GetRecordRID(log_record).GetPageId());
+      break;
+    case LogRecordType::INDEXINSERT:
+    case LogRecordType::INDEXDELETE:
+      pages->push_back(log_record->GetIndexPageId());
+      break;
+    case LogRecordType::INDEXSMO:
+      for (const auto &write : log_record->GetIndexPageWrites()) {
+        if (std::find(pages->begin(), pages->end(), write.page_id_) == pages->end()) {
+          pages->push_back(write.page_id_);
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+bool LogRecovery::RedoLogRecord(LogRecord *log_record, page_id_t page_id) {
+  auto *page = FetchTablePage(page_id);
+  bool redo = RedoLogRecord(log_record, page);
+  buffer_pool_manager_->UnpinPage(page_id, redo);
+  return redo;
+}
+
+bool LogRecovery::RedoLogRecord(LogRecord *log_record, TablePage *page) {
+  lsn_t lsn = log_record->GetLSN();
+  page_id_t page_id = page->GetPageId();
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::NEWPAGE: {
+      page_id_t new_page_id = log_record->GetNewPageId();
+      page_id_t prev_page_id = log_record->GetNewPageRecord();
+      if (page_id != new_page_id) {
+        // The link does not move the LSN of the previous page, so compare the link itself.
+        bool relink = page->GetNextPageId() != new_page_id;
+        if (relink) {
+          page->SetNextPageId(new_page_id);
+        }
+        return relink;
+      }
+      // A page that never reached the disk reads back as zeroes and does not even carry its own id.
+      bool redo = page->GetTablePageId() != page_id || page->GetLSN() < lsn;
+      if (redo) {
+        page->Init(page_id, PAGE_SIZE, prev_page_id, nullptr, nullptr);
+        page->SetLSN(lsn);
+      }
+      return redo;
+    }
+    case LogRecordType::INSERT:
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+    case LogRecordType::UPDATE:
+    case LogRecordType::DELTAUPDATE: {
+      bool redo = page->GetLSN() < lsn;
+      if (redo) {
+        ApplyLogRecord(page, log_record);
+        page->SetLSN(lsn);
+      }
+      return redo;
+    }
+    case LogRecordType::INDEXINSERT:
+    case LogRecordType::INDEXDELETE:
+    case LogRecordType::INDEXSMO: {
+      // An index page keeps its LSN where a table page does, see BPlusTreePage.
+      bool redo = page->GetLSN() < lsn;
+      if (redo) {
+        ApplyIndexRecord(page, log_record);
+        page->SetLSN(lsn);
+      }
+      return redo;
+    }
+    default:
+      return false;
+  }
+}
+
+lsn_t LogRecovery::UndoLogRecord(LogRecord *log_record, lsn_t prev_lsn) {
+  page_id_t page_id;
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::INSERT:
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+    case LogRecordType::UPDATE:
+    case LogRecordType::DELTAUPDATE:
+      page_id = GetRecordRID(log_record).GetPageId();
+      break;
+    case LogRecordType::INDEXINSERT:
+    case LogRecordType::INDEXDELETE:
+      page_id = log_record->GetIndexPageId();
+      break;
+    default:
+      // A structure modification is a nested top action, which stays even if its transaction rolls back.
+      return prev_lsn;
+  }
+  auto *page = FetchTablePage(page_id);
+  LogRecord compensation;
+  bool undone = MakeCompensation(page, log_record, prev_lsn, &compensation);
+  if (undone) {
+    // The buffer pool does not enforce the write-ahead rule while recovery runs with logging off, so the record is
+    // made durable before the page can be written.
+    prev_lsn = log_manager_->AppendLogRecord(&compensation);
+    log_manager_->Flush(prev_lsn);
+    RedoLogRecord(&compensation, page);
+    stats_.undone_records_++;
+  }
+  buffer_pool_manager_->UnpinPage(page_id, undone);
+  return prev_lsn;
+}
+
+bool LogRecovery::MakeCompensation(TablePage *page, LogRecord *log_record, lsn_t prev_lsn, LogRecord *compensation) {
+  txn_id_t txn_id = log_record->GetTxnId();
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::INSERT:
+      *compensation = LogRecord(txn_id, prev_lsn, LogRecordType::APPLYDELETE, log_record->GetInsertRID(),
+                                log_record->GetInsertTuple());
+      return true;
+    case LogRecordType::MARKDELETE:
+      *compensation = LogRecord(txn_id, prev_lsn, LogRecordType::ROLLBACKDELETE, log_record->GetDeleteRID(),
+                                log_record->GetDeleteTuple());
+      return true;
+    case LogRecordType::APPLYDELETE:
+      *compensation =
+          LogRecord(txn_id, prev_lsn, LogRecordType::INSERT, log_record->GetDeleteRID(), log_record->GetDeleteTuple());
+      return true;
+    case LogRecordType::ROLLBACKDELETE:
+      *compensation = LogRecord(txn_id, prev_lsn, LogRecordType::MARKDELETE, log_record->GetDeleteRID(),
+                                log_record->GetDeleteTuple());
+      return true;
+    case LogRecordType::UPDATE:
+      *compensation = LogRecord(txn_id, prev_lsn, LogRecordType::UPDATE, log_record->GetUpdateRID(),
+                                log_record->GetUpdateTuple(), log_record->GetOriginalTuple());
+      return true;
+    case LogRecordType::DELTAUPDATE: {
+      // The delta only makes sense against the current image of the tuple.
+      Tuple current;
+      page->GetTuple(log_record->GetUpdateRID(), &current, nullptr, nullptr);
+      *compensation = LogRecord(txn_id, prev_lsn, LogRecordType::DELTAUPDATE, log_record->GetUpdateRID(), current,
+                                log_record->GetDeltaUndoTuple(current));
+      return true;
+    }
+    case LogRecordType::INDEXINSERT: {
+      // Later inserts and deletes on the page may have shifted the entry, so remove it where it is now.
+      const std::vector<char> &entry = log_record->GetIndexEntry();
+      int slot = FindIndexEntry(page, entry);
+      if (slot < 0) {
+        return false;
+      }
+      *compensation = LogRecord(txn_id, prev_lsn, LogRecordType::INDEXDELETE, page->GetPageId(), slot, entry.data(),
+                                entry.size());
+      return true;
+    }
+    case LogRecordType::INDEXDELETE: {
+      const std::vector<char> &entry = log_record->GetIndexEntry();
+      *compensation = LogRecord(txn_id, prev_lsn, LogRecordType::INDEXINSERT, page->GetPageId(),
+                                log_record->GetIndexSlot(), entry.data(), entry.size());
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+void LogRecovery::ApplyLogRecord(TablePage *page, LogRecord *log_record) {
+  RID rid = GetRecordRID(log_record);
+  Tuple tuple;
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::INSERT:
+      page->InsertTuple(log_record->GetInsertTuple(), &rid, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::MARKDELETE:
+      page->MarkDelete(rid, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      page->ApplyDelete(rid, nullptr, nullptr);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      page->RollbackDelete(rid, nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE:
+      page->UpdateTuple(log_record->GetUpdateTuple(), &tuple, rid, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::DELTAUPDATE: {
+      // The delta only makes sense against the current image of the tuple.
+      Tuple current;
+      page->GetTuple(rid, &current, nullptr, nullptr);
+      page->UpdateTuple(log_record->GetDeltaRedoTuple(current), &tuple, rid, nullptr, nullptr, nullptr);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void LogRecovery::ApplyIndexRecord(Page *page, LogRecord *log_record) {
+  char *data = page->GetData();
+  if (log_record->GetLogRecordType() == LogRecordType::INDEXSMO) {
+    const char *bytes = log_record->GetIndexPageData().data();
+    for (const auto &write : log_record->GetIndexPageWrites()) {
+      if (write.page_id_ == page->GetPageId()) {
+        memcpy(data + write.offset_, bytes, write.length_);
+      }
+      bytes += write.length_;
+    }
+    return;
+  }
+
+  auto *node = reinterpret_cast<BPlusTreePage *>(data);
+  char *array = data + LEAF_PAGE_HEADER_SIZE;
+  const std::vector<char> &entry = log_record->GetIndexEntry();
+  size_t entry_size = entry.size();
+  int size = node->GetSize();
+  int slot = std::min(log_record->GetIndexSlot(), size);
+  if (log_record->GetLogRecordType() == LogRecordType::INDEXINSERT) {
+    memmove(array + (slot + 1) * entry_size, array + slot * entry_size, (size - slot) * entry_size);
+    memcpy(array + slot * entry_size, entry.data(), entry_size);
+    node->IncreaseSize(1);
+    return;
+  }
+  memmove(array + slot * entry_size, array + (slot + 1) * entry_size, (size - slot - 1) * entry_size);
+  node->IncreaseSize(-1);
+}
+
+int LogRecovery::FindIndexEntry(Page *page, const std::vector<char> &entry) {
+  // The key and the value together are unique in the index.
+  char *data = page->GetData();
+  char *array = data + LEAF_PAGE_HEADER_SIZE;
+  int size = reinterpret_cast<BPlusTreePage *>(data)->GetSize();
+  for (int i = 0; i < size; i++) {
+    if (memcmp(array + i * entry.size(), entry.data(), entry.size()) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+RID LogRecovery::GetRecordRID(LogRecord *log_record) {
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::INSERT:
+      return log_record->GetInsertRID();
+    case LogRecordType::UPDATE:
+    case LogRecordType::DELTAUPDATE:
+      return log_record->GetUpdateRID();
+    default:
+      return log_record->GetDeleteRID();
+  }
+}
+
+TablePage *LogRecovery::FetchTablePage(page_id_t page_id) {
+  auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  BUSTUB_ASSERT(page != nullptr, "Recovery ran out of buffer pool frames.");
+  return page;
+}
 
 }  // namespace bustub
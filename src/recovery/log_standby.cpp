@@ -0,0 +1,193 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_standby.cpp
+//
+// Identification: src/recovery/log_standby.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_standby.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#include "common/exception.h"
+
+namespace bustub {
+
+LogStandby::LogStandby(const std::string &primary_db_file, BufferPoolManager *buffer_pool_manager) {
+  // A disk manager that finds no database file starts a new one and deletes the log next to it.
+  if (!std::filesystem::exists(primary_db_file)) {
+    throw Exception("can't find primary db file");
+  }
+  primary_disk_manager_ = std::make_unique<DiskManager>(primary_db_file);
+  replayer_ = std::make_unique<LogRecovery>(primary_disk_manager_.get(), buffer_pool_manager);
+}
+
+LogStandby::~LogStandby() {
+  Stop();
+  primary_disk_manager_->ShutDown();
+}
+
+void LogStandby::Start(std::chrono::milliseconds poll_interval) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (poll_thread_.joinable()) {
+    return;
+  }
+  stop_ = false;
+  poll_thread_ = std::thread([this, poll_interval] {
+    std::unique_lock<std::mutex> lock(latch_);
+    while (!stop_) {
+      lock.unlock();
+      bool replayed = Poll();
+      lock.lock();
+      // Keep going without a pause while the standby is catching up.
+      if (!replayed) {
+        cv_.wait_for(lock, poll_interval, [this] { return stop_; });
+      }
+    }
+  });
+}
+
+void LogStandby::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (!poll_thread_.joinable()) {
+      return;
+    }
+    stop_ = true;
+    cv_.notify_one();
+  }
+  poll_thread_.join();
+}
+
+/*
+ * Replay the complete blocks that continue the replayed part of the log, up to the last LSN after which no transaction
+ * is open. A block is only read once its payload matches its checksum, so a block that the primary is still writing
+ * waits for the next poll, and a block that ends with a transaction open is replayed in two parts.
+ */
+bool LogStandby::Poll() {
+  std::lock_guard<std::mutex> poll_guard(poll_latch_);
+  primary_disk_manager_->RescanLog();
+  ScanReceived();
+  ScanTxns();
+
+  lsn_t replay_lsn;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    replay_lsn = stats_.replay_lsn_;
+  }
+  if (closed_lsn_ <= replay_lsn) {
+    return false;
+  }
+  // Readers wait until the whole span is replayed, since transactions may be open in between.
+  replay_latch_.WLock();
+  uint64_t blocks = 0;
+  LogBlockHeader header;
+  for (;;) {
+    int offset = FindBlock(replay_offset_, replay_next_lsn_, &header);
+    int next_offset = offset < 0 ? -1 : replayer_->ReplayLogBlock(offset, &header, replay_lsn + 1, closed_lsn_);
+    BUSTUB_ASSERT(next_offset >= 0, "The transactions were followed through this block, so it is complete.");
+    if (header.last_lsn_ > closed_lsn_) {
+      // The rest of the block waits for its transactions to end.
+      replay_offset_ = offset;
+      replay_next_lsn_ = header.first_lsn_;
+      break;
+    }
+    replay_offset_ = next_offset;
+    replay_next_lsn_ = header.last_lsn_ + 1;
+    blocks++;
+    if (header.last_lsn_ == closed_lsn_) {
+      break;
+    }
+  }
+  {
+    // Together with the replay LSN, so that the counters never show a lag for a block that is replayed.
+    std::lock_guard<std::mutex> guard(latch_);
+    stats_.replay_lsn_ = closed_lsn_;
+    stats_.replayed_blocks_ += blocks;
+    stats_.replayed_records_ += closed_lsn_ - replay_lsn;
+    auto now = std::chrono::steady_clock::now();
+    while (!received_blocks_.empty() && received_blocks_.front().first <= closed_lsn_) {
+      auto lag = std::chrono::duration_cast<std::chrono::nanoseconds>(now - received_blocks_.front().second).count();
+      stats_.max_replay_lag_ns_ = std::max<uint64_t>(stats_.max_replay_lag_ns_, lag);
+      received_blocks_.pop_front();
+    }
+  }
+  replay_latch_.WUnlock();
+  return true;
+}
+
+lsn_t LogStandby::BeginRead() {
+  replay_latch_.RLock();
+  std::lock_guard<std::mutex> guard(latch_);
+  return stats_.replay_lsn_;
+}
+
+void LogStandby::EndRead() { replay_latch_.RUnlock(); }
+
+ReplicationStats LogStandby::GetStats() {
+  std::lock_guard<std::mutex> guard(latch_);
+  ReplicationStats stats = stats_;
+  if (!received_blocks_.empty()) {
+    stats.replay_lag_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                received_blocks_.front().second)
+                               .count();
+  }
+  return stats;
+}
+
+int LogStandby::FindBlock(int offset, lsn_t next_lsn, LogBlockHeader *header) {
+  if (offset < 0) {
+    // Nothing found yet, start at the oldest segment.
+    offset = primary_disk_manager_->GetLogSegmentOffset(0);
+  }
+  while (offset >= 0) {
+    // The primary only starts a segment once the previous one is full, so if the next segment exists before the read,
+    // a block missing from this one will never come.
+    int next_segment = primary_disk_manager_->GetNextLogSegmentOffset(offset);
+    if (replayer_->ReadLogBlockHeader(offset, header) >= 0 &&
+        (next_lsn == INVALID_LSN || header->first_lsn_ == next_lsn)) {
+      return offset;
+    }
+    offset = next_segment;
+  }
+  return -1;
+}
+
+void LogStandby::ScanTxns() {
+  LogBlockHeader header;
+  for (;;) {
+    int offset = FindBlock(txn_scan_offset_, txn_scan_next_lsn_, &header);
+    if (offset < 0) {
+      return;
+    }
+    int next_offset = replayer_->ScanLogBlockTxns(offset, &header, &open_txns_, &closed_lsn_);
+    if (next_offset < 0) {
+      return;
+    }
+    txn_scan_offset_ = next_offset;
+    txn_scan_next_lsn_ = header.last_lsn_ + 1;
+  }
+}
+
+void LogStandby::ScanReceived() {
+  LogBlockHeader header;
+  for (;;) {
+    int offset = FindBlock(scan_offset_, scan_next_lsn_, &header);
+    if (offset < 0) {
+      return;
+    }
+    scan_offset_ = offset + sizeof(LogBlockHeader) + header.size_;
+    scan_next_lsn_ = header.last_lsn_ + 1;
+    std::lock_guard<std::mutex> guard(latch_);
+    received_blocks_.emplace_back(header.last_lsn_, std::chrono::steady_clock::now());
+    stats_.received_lsn_ = header.last_lsn_;
+  }
+}
+
+}  // namespace bustub
@@ -10,9 +10,15 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <string>
 #include <thread>  // NOLINT
@@ -26,31 +32,17 @@ namespace bustub {
 static char *buffer_used;
 
 /**
- * Constructor: open/create a single database file & log file
+ * Constructor: open/create a single database file & find its log segments
  * @input db_file: database file name
  */
 DiskManager::DiskManager(const std::string &db_file)
     : file_name_(db_file), next_page_id_(0), num_flushes_(0), num_writes_(0), flush_log_(false), flush_log_f_(nullptr) {
-  std::string::size_type n = file_name_.rfind('.');
-  if (n == std::string::npos) {
+  log_name_ = GetLogName(file_name_);
+  if (log_name_.empty()) {
     LOG_DEBUG("wrong file format");
     return;
   }
-  log_name_ = file_name_.substr(0, n) + ".log";
-
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app | std::ios::out);
-    log_io_.close();
-    // reopen with original mode
-    log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-    if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
-    }
-  }
+  bool new_database = GetFileSize(db_file) < 0;
 
   db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
   // directory or file does not exist
@@ -65,6 +57,7 @@ DiskManager::DiskManager(const std::string &db_file)
       throw Exception("can't open db file");
     }
   }
+  OpenLog(new_database);
   buffer_used = nullptr;
 }
 
@@ -73,7 +66,9 @@ DiskManager::DiskManager(const std::string &db_file)
  */
 void DiskManager::ShutDown() {
   db_io_.close();
+  std::lock_guard<std::mutex> guard(log_latch_);
   log_io_.close();
+  log_read_io_.close();
 }
 
 /**
@@ -102,7 +97,8 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   // check if read beyond file length
   if (offset > GetFileSize(file_name_)) {
     LOG_DEBUG("I/O error reading past end of file");
-    // std::cerr << "I/O error while reading" << std::endl;
+    // The page was allocated but never written, so it is all zeroes.
+    memset(page_data, 0, PAGE_SIZE);
   } else {
     // set read cursor to offset
     db_io_.seekp(offset);
@@ -122,11 +118,16 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   }
 }
 
+int DiskManager::GetNumPages() {
+  int size = GetFileSize(file_name_);
+  return size < 0 ? 0 : (size + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
 /**
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
  */
-void DiskManager::WriteLog(char *log_data, int size) {
+void DiskManager::WriteLog(char *log_data, int size, lsn_t first_lsn) {
   // enforce swap log buffer
   assert(log_data != buffer_used);
   buffer_used = log_data;
@@ -142,9 +143,17 @@ void DiskManager::WriteLog(char *log_data, int size) {
     assert(flush_log_f_->wait_for(std::chrono::seconds(10)) == std::future_status::ready);
   }
 
+  assert(size <= LOG_SEGMENT_SIZE);
+  std::lock_guard<std::mutex> guard(log_latch_);
+  if (log_write_offset_ < 0 || log_write_offset_ + size > LOG_SEGMENT_SIZE) {
+    StartLogSegment(first_lsn);
+  }
+
   num_flushes_ += 1;
   // sequence write
+  log_io_.seekp(log_write_offset_);
   log_io_.write(log_data, size);
+  log_write_offset_ += size;
 
   // check for I/O error
   if (log_io_.bad()) {
@@ -162,28 +171,132 @@ void DiskManager::WriteLog(char *log_data, int size) {
  * @return: false means already reach the end
  */
 bool DiskManager::ReadLog(char *log_data, int size, int offset) {
-  if (offset >= GetFileSize(log_name_)) {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  int segment = offset / LOG_SEGMENT_SIZE;
+  if (offset < 0 || segment < log_segment_base_ ||
+      segment - log_segment_base_ >= static_cast<int>(log_segments_.size())) {
     // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
     return false;
   }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
+  if (log_read_segment_ != segment) {
+    log_read_io_.close();
+    log_read_io_.clear();
+    log_read_io_.open(GetLogSegmentName(log_segments_[segment - log_segment_base_]), std::ios::binary | std::ios::in);
+    if (!log_read_io_.is_open()) {
+      LOG_DEBUG("can't open log segment");
+      log_read_segment_ = -1;
+      return false;
+    }
+    log_read_segment_ = segment;
+  }
+  log_read_io_.seekg(offset % LOG_SEGMENT_SIZE);
+  log_read_io_.read(log_data, size);
 
-  if (log_io_.bad()) {
+  if (log_read_io_.bad()) {
     LOG_DEBUG("I/O error while reading log");
     return false;
   }
   // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
+  int read_count = log_read_io_.gcount();
   if (read_count < size) {
-    log_io_.clear();
+    log_read_io_.clear();
     memset(log_data + read_count, 0, size - read_count);
   }
 
   return true;
 }
 
+int DiskManager::GetLogSegmentOffset(lsn_t lsn) {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  if (log_segments_.empty()) {
+    return -1;
+  }
+  auto next = std::upper_bound(log_segments_.begin(), log_segments_.end(), lsn);
+  int index = next == log_segments_.begin() ? 0 : static_cast<int>(next - log_segments_.begin()) - 1;
+  return (log_segment_base_ + index) * LOG_SEGMENT_SIZE;
+}
+
+int DiskManager::GetNextLogSegmentOffset(int offset) {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  int segment = std::max(offset / LOG_SEGMENT_SIZE + 1, log_segment_base_);
+  if (segment - log_segment_base_ >= static_cast<int>(log_segments_.size())) {
+    return -1;
+  }
+  return segment * LOG_SEGMENT_SIZE;
+}
+
+lsn_t DiskManager::GetLogSegmentLSN(int offset) {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  int index = offset / LOG_SEGMENT_SIZE - log_segment_base_;
+  if (offset < 0 || index < 0 || index >= static_cast<int>(log_segments_.size())) {
+    return INVALID_LSN;
+  }
+  return log_segments_[index];
+}
+
+/**
+ * Recycle the segments whose successor starts at or before lsn, keeping up to LOG_SPARE_SEGMENTS of them as spares
+ */
+void DiskManager::TruncateLog(lsn_t lsn) {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  while (log_segments_.size() > 1 && log_segments_[1] <= lsn) {
+    if (log_read_segment_ == log_segment_base_) {
+      log_read_io_.close();
+      log_read_segment_ = -1;
+    }
+    std::string segment_name = GetLogSegmentName(log_segments_.front());
+    std::error_code error;
+    if (spare_log_segments_.size() < LOG_SPARE_SEGMENTS) {
+      std::string spare_name = log_name_ + ".spare." + std::to_string(next_spare_id_++);
+      std::filesystem::rename(segment_name, spare_name, error);
+      if (!error) {
+        spare_log_segments_.push_back(spare_name);
+      }
+    } else {
+      std::filesystem::remove(segment_name, error);
+    }
+    if (error) {
+      LOG_DEBUG("I/O error while recycling log segment");
+    }
+    log_segments_.pop_front();
+    log_segment_base_++;
+  }
+}
+
+size_t DiskManager::GetNumLogSegments() {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  return log_segments_.size();
+}
+
+size_t DiskManager::GetNumSpareLogSegments() {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  return spare_log_segments_.size();
+}
+
+/**
+ * Write the master record to a temporary file and rename it over the old one, so that a crash leaves either of them
+ */
+void DiskManager::WriteMasterRecord(lsn_t lsn) {
+  std::string master_name = log_name_ + ".master";
+  std::string temp_name = master_name + ".tmp";
+  std::ofstream master_io(temp_name, std::ios::binary | std::ios::trunc);
+  master_io.write(reinterpret_cast<const char *>(&lsn), sizeof(lsn_t));
+  master_io.close();
+  if (master_io.fail()) {
+    throw Exception("can't write log master record");
+  }
+  std::filesystem::rename(temp_name, master_name);
+}
+
+lsn_t DiskManager::ReadMasterRecord() {
+  lsn_t lsn = INVALID_LSN;
+  std::ifstream master_io(log_name_ + ".master", std::ios::binary);
+  if (!master_io.read(reinterpret_cast<char *>(&lsn), sizeof(lsn_t))) {
+    return INVALID_LSN;
+  }
+  return lsn;
+}
+
 /**
  * Allocate new page (operations like create index/table)
  * For now just keep an increasing counter
@@ -212,6 +325,128 @@ int DiskManager::GetNumWrites() const { return num_writes_; }
  */
 bool DiskManager::GetFlushState() const { return flush_log_; }
 
+/**
+ * Private helper function to collect the log files next to the database file
+ */
+void DiskManager::OpenLog(bool new_database) {
+  std::string spare_prefix = "spare.";
+  std::error_code error;
+  for (const auto &suffix : ListLogFiles(log_name_)) {
+    if (new_database) {
+      // The log of an older database with the same name must never be replayed against this one.
+      std::filesystem::remove(log_name_ + "." + suffix, error);
+    } else if (suffix.compare(0, spare_prefix.size(), spare_prefix) == 0) {
+      spare_log_segments_.push_back(log_name_ + "." + suffix);
+      next_spare_id_ = std::max(next_spare_id_, std::atoi(suffix.c_str() + spare_prefix.size()) + 1);
+    } else if (!suffix.empty() && std::all_of(suffix.begin(), suffix.end(), ::isdigit)) {
+      log_segments_.push_back(static_cast<lsn_t>(std::stol(suffix)));
+    }
+  }
+  std::sort(log_segments_.begin(), log_segments_.end());
+}
+
+/**
+ * Segments only leave the log at the front and join it at the back, so the first known segment that is still there
+ * keeps its position and the offsets of the segments after it stay valid
+ */
+void DiskManager::RescanLog() {
+  std::vector<lsn_t> segments;
+  for (const auto &suffix : ListLogFiles(log_name_)) {
+    if (!suffix.empty() && std::all_of(suffix.begin(), suffix.end(), ::isdigit)) {
+      segments.push_back(static_cast<lsn_t>(std::stol(suffix)));
+    }
+  }
+  std::sort(segments.begin(), segments.end());
+
+  std::lock_guard<std::mutex> guard(log_latch_);
+  size_t dropped = 0;
+  while (dropped < log_segments_.size() &&
+         !std::binary_search(segments.begin(), segments.end(), log_segments_[dropped])) {
+    dropped++;
+  }
+  if (log_read_segment_ >= 0 && log_read_segment_ < log_segment_base_ + static_cast<int>(dropped)) {
+    log_read_io_.close();
+    log_read_segment_ = -1;
+  }
+  log_segment_base_ += static_cast<int>(dropped);
+  log_segments_.assign(segments.begin(), segments.end());
+}
+
+void DiskManager::RemoveLog(const std::string &db_file) {
+  std::string log_name = GetLogName(db_file);
+  if (log_name.empty()) {
+    return;
+  }
+  std::error_code error;
+  for (const auto &suffix : ListLogFiles(log_name)) {
+    std::filesystem::remove(log_name + "." + suffix, error);
+  }
+}
+
+std::string DiskManager::GetLogName(const std::string &db_file) {
+  std::string::size_type n = db_file.rfind('.');
+  return n == std::string::npos ? "" : db_file.substr(0, n) + ".log";
+}
+
+std::vector<std::string> DiskManager::ListLogFiles(const std::string &log_name) {
+  namespace fs = std::filesystem;
+  fs::path log_path(log_name);
+  fs::path log_dir = log_path.has_parent_path() ? log_path.parent_path() : fs::path(".");
+  std::string prefix = log_path.filename().string() + ".";
+  std::vector<std::string> suffixes;
+  std::error_code error;
+  for (const auto &entry : fs::directory_iterator(log_dir, error)) {
+    std::string file_name = entry.path().filename().string();
+    if (file_name.compare(0, prefix.size(), prefix) == 0) {
+      suffixes.push_back(file_name.substr(prefix.size()));
+    }
+  }
+  return suffixes;
+}
+
+std::string DiskManager::GetLogSegmentName(lsn_t lsn) const {
+  // Zero padded, so that the segments of a log list in order.
+  std::string digits = std::to_string(lsn);
+  return log_name_ + "." + std::string(std::max<int>(10 - static_cast<int>(digits.size()), 0), '0') + digits;
+}
+
+/**
+ * Private helper function to switch the log writer to a new segment, reusing a spare one if there is any
+ */
+void DiskManager::StartLogSegment(lsn_t first_lsn) {
+  log_io_.close();
+  log_io_.clear();
+  std::string segment_name = GetLogSegmentName(first_lsn);
+  if (!log_segments_.empty() && log_segments_.back() == first_lsn) {
+    // The last segment does not hold a complete block, so it is simply overwritten.
+    if (log_read_segment_ == log_segment_base_ + static_cast<int>(log_segments_.size()) - 1) {
+      log_read_io_.close();
+      log_read_segment_ = -1;
+    }
+  } else if (!spare_log_segments_.empty()) {
+    // Its old blocks stay in place, but their LSNs are all below first_lsn so readers can tell them apart.
+    std::filesystem::rename(spare_log_segments_.back(), segment_name);
+    spare_log_segments_.pop_back();
+    log_segments_.push_back(first_lsn);
+  } else {
+    // Allocate the whole segment up front, so that appending never has to grow the file.
+    int fd = open(segment_name.c_str(), O_CREAT | O_WRONLY, 0644);
+    bool allocated = fd >= 0 && posix_fallocate(fd, 0, LOG_SEGMENT_SIZE) == 0;
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (!allocated) {
+      throw Exception("can't allocate log segment");
+    }
+    log_segments_.push_back(first_lsn);
+  }
+  log_io_.open(segment_name, std::ios::binary | std::ios::in | std::ios::out);
+  if (!log_io_.is_open()) {
+    throw Exception("can't open log segment");
+  }
+  log_write_offset_ = 0;
+}
+
 /**
  * Private helper function to get disk file size
  */
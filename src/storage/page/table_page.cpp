@@ -22,11 +22,12 @@ void TablePage::Init(page_id_t page_id, uint32_t page_size, page_id_t prev_page_
   memcpy(GetData(), &page_id, sizeof(page_id));
   // Log that we are creating a new page.
   if (enable_logging) {
+    // NEWPAGE also links the previous page, which the private log does not track, so it goes straight to the shared
+    // log after the transaction's earlier records.
     LogRecord log_record =
         LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::NEWPAGE, prev_page_id, page_id);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
+    lsn_t lsn = log_manager->AppendSharedLogRecord(&log_record, txn);
     SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
   }
   // Set the previous and next page IDs.
   SetPrevPageId(prev_page_id);
@@ -74,13 +75,15 @@ bool TablePage::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, Lock
   // Write the log record.
   if (enable_logging) {
     BUSTUB_ASSERT(!txn->IsSharedLocked(*rid) && !txn->IsExclusiveLocked(*rid), "A new tuple should not be locked.");
-    // Acquire an exclusive lock on the new tuple.
-    bool locked = lock_manager->LockExclusive(txn, *rid);
+    // Acquire an exclusive lock on the new tuple, unless a table lock covers it.
+    bool locked = lock_manager == nullptr || lock_manager->LockExclusive(txn, *rid);
     BUSTUB_ASSERT(locked, "Locking a new tuple should always work.");
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::INSERT, *rid, tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    lsn_t lsn = log_manager->AppendLogRecord(&log_record, txn, GetTablePageId());
+    if (lsn != INVALID_LSN) {
+      SetLSN(lsn);
+      txn->SetPrevLSN(lsn);
+    }
   }
   return true;
 }
@@ -106,18 +109,20 @@ bool TablePage::MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_m
 
   if (enable_logging) {
     // Acquire an exclusive lock, upgrading from a shared lock if necessary.
-    if (txn->IsSharedLocked(rid)) {
+    if (lock_manager != nullptr && txn->IsSharedLocked(rid)) {
       if (!lock_manager->LockUpgrade(txn, rid)) {
         return false;
       }
-    } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
+    } else if (lock_manager != nullptr && !txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
       return false;
     }
     Tuple dummy_tuple;
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::MARKDELETE, rid, dummy_tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    lsn_t lsn = log_manager->AppendLogRecord(&log_record, txn, GetTablePageId());
+    if (lsn != INVALID_LSN) {
+      SetLSN(lsn);
+      txn->SetPrevLSN(lsn);
+    }
   }
 
   // Mark the tuple as deleted.
@@ -164,17 +169,20 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
 
   if (enable_logging) {
     // Acquire an exclusive lock, upgrading from shared if necessary.
-    if (txn->IsSharedLocked(rid)) {
+    if (lock_manager != nullptr && txn->IsSharedLocked(rid)) {
       if (!lock_manager->LockUpgrade(txn, rid)) {
         return false;
       }
-    } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
+    } else if (lock_manager != nullptr && !txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
       return false;
     }
-    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::UPDATE, rid, *old_tuple, new_tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    LogRecordType type = enable_delta_update ? LogRecordType::DELTAUPDATE : LogRecordType::UPDATE;
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), type, rid, *old_tuple, new_tuple);
+    lsn_t lsn = log_manager->AppendLogRecord(&log_record, txn, GetTablePageId());
+    if (lsn != INVALID_LSN) {
+      SetLSN(lsn);
+      txn->SetPrevLSN(lsn);
+    }
   }
 
   // Perform the update.
@@ -218,12 +226,12 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
   delete_tuple.allocated_ = true;
 
   if (enable_logging) {
-    BUSTUB_ASSERT(txn->IsExclusiveLocked(rid), "We must own the exclusive lock!");
-
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::APPLYDELETE, rid, delete_tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    lsn_t lsn = log_manager->AppendLogRecord(&log_record, txn, GetTablePageId());
+    if (lsn != INVALID_LSN) {
+      SetLSN(lsn);
+      txn->SetPrevLSN(lsn);
+    }
   }
 
   uint32_t free_space_pointer = GetFreeSpacePointer();
@@ -247,12 +255,13 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
 void TablePage::RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager) {
   // Log the rollback.
   if (enable_logging) {
-    BUSTUB_ASSERT(txn->IsExclusiveLocked(rid), "We must own an exclusive lock on the RID.");
     Tuple dummy_tuple;
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ROLLBACKDELETE, rid, dummy_tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    lsn_t lsn = log_manager->AppendLogRecord(&log_record, txn, GetTablePageId());
+    if (lsn != INVALID_LSN) {
+      SetLSN(lsn);
+      txn->SetPrevLSN(lsn);
+    }
   }
 
   uint32_t slot_num = rid.GetSlotNum();
@@ -287,7 +296,8 @@ bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
 
   // Otherwise we have a valid tuple, try to acquire at least a shared lock.
   if (enable_logging) {
-    if (!txn->IsSharedLocked(rid) && !txn->IsExclusiveLocked(rid) && !lock_manager->LockShared(txn, rid)) {
+    if (lock_manager != nullptr && !txn->IsSharedLocked(rid) && !txn->IsExclusiveLocked(rid) &&
+        !lock_manager->LockShared(txn, rid)) {
       return false;
     }
   }
@@ -305,10 +315,10 @@ bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
   return true;
 }
 
-bool TablePage::GetFirstTupleRid(RID *first_rid) {
+bool TablePage::GetFirstTupleRid(RID *first_rid, bool empty_slots) {
   // Find and return the first valid tuple.
   for (uint32_t i = 0; i < GetTupleCount(); ++i) {
-    if (GetTupleSize(i) > 0) {
+    if (empty_slots || GetTupleSize(i) > 0) {
       first_rid->Set(GetTablePageId(), i);
       return true;
     }
@@ -317,11 +327,11 @@ bool TablePage::GetFirstTupleRid(RID *first_rid) {
   return false;
 }
 
-bool TablePage::GetNextTupleRid(const RID &cur_rid, RID *next_rid) {
+bool TablePage::GetNextTupleRid(const RID &cur_rid, RID *next_rid, bool empty_slots) {
   BUSTUB_ASSERT(cur_rid.GetPageId() == GetTablePageId(), "Wrong table!");
   // Find and return the first valid tuple after our current slot number.
   for (auto i = cur_rid.GetSlotNum() + 1; i < GetTupleCount(); ++i) {
-    if (GetTupleSize(i) > 0) {
+    if (empty_slots || GetTupleSize(i) > 0) {
       next_rid->Set(GetTablePageId(), i);
       return true;
     }
@@ -13,6 +13,7 @@
 #include <cassert>
 
 #include "common/logger.h"
+#include "concurrency/version_store.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
@@ -41,6 +42,17 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
+  if (txn->BuffersWrites()) {
+    // The row gets its RID once the transaction commits.
+    *rid = RID();
+    txn->GetWriteSet()->emplace_back(*rid, WType::INSERT, tuple, this);
+    return true;
+  }
+
+  LockManager *row_lock_manager;
+  if (!LockForRow(nullptr, txn, true, &row_lock_manager)) {
+    return false;
+  }
 
   auto cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
   if (cur_page == nullptr) {
@@ -51,7 +63,7 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
   cur_page->WLatch();
   // Insert into the first page with enough space. If no such page exists, create a new page and insert into that.
   // INVARIANT: cur_page is WLatched if you leave the loop normally.
-  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_)) {
+  while (!cur_page->InsertTuple(tuple, rid, txn, nullptr, log_manager_)) {
     auto next_page_id = cur_page->GetNextPageId();
     // If the next page is a valid page,
     if (next_page_id != INVALID_PAGE_ID) {
@@ -81,6 +93,15 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
       cur_page = new_page;
     }
   }
+  // Nobody else can hold a lock on a new row, and counting it towards escalation takes the table. The lock only fails
+  // if another transaction has wounded this one meanwhile, and its rollback removes the tuple.
+  if (enable_logging && row_lock_manager != nullptr) {
+    bool locked = row_lock_manager->LockExclusive(txn, *rid, first_page_id_);
+    BUSTUB_ASSERT(locked || txn->GetState() == TransactionState::ABORTED, "Locking a new tuple should always work.");
+  }
+  if (txn->GetVersionStore() != nullptr) {
+    txn->GetVersionStore()->AddVersion(txn, *rid, nullptr);
+  }
   // This line has caused most of us to double-take and "whoa double unlatch".
   // We are not, in fact, double unlatching. See the invariant above.
   cur_page->WUnlatch();
@@ -92,6 +113,13 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
 
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   // TODO(Amadou): remove empty page
+  if (txn->BuffersWrites()) {
+    return BufferWrite(rid, WType::DELETE, Tuple{}, txn);
+  }
+  LockManager *row_lock_manager;
+  if (!LockForRow(&rid, txn, true, &row_lock_manager) || (txn->IsSnapshot() && !CheckSnapshotWrite(rid, txn))) {
+    return false;
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -101,7 +129,14 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   }
   // Otherwise, mark the tuple as deleted.
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  Tuple old_tuple;
+  bool versioned = txn->GetVersionStore() != nullptr && page->HasTuple(rid);
+  if (versioned) {
+    page->GetTuple(rid, &old_tuple, txn, nullptr);
+  }
+  if (page->MarkDelete(rid, txn, row_lock_manager, log_manager_) && versioned) {
+    txn->GetVersionStore()->AddVersion(txn, rid, &old_tuple);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   // Update the transaction's write set.
@@ -110,6 +145,13 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) {
+  if (txn->BuffersWrites()) {
+    return BufferWrite(rid, WType::UPDATE, tuple, txn);
+  }
+  LockManager *row_lock_manager;
+  if (!LockForRow(&rid, txn, true, &row_lock_manager) || (txn->IsSnapshot() && !CheckSnapshotWrite(rid, txn))) {
+    return false;
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -120,11 +162,15 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
   page->WLatch();
-  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, row_lock_manager, log_manager_);
+  if (is_updated && txn->GetVersionStore() != nullptr) {
+    txn->GetVersionStore()->AddVersion(txn, rid, &old_tuple);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
-  // Update the transaction's write set.
-  if (is_updated && txn->GetState() != TransactionState::ABORTED) {
+  // Update the transaction's write set. Another transaction may have wounded this one meanwhile, and its rollback must
+  // still undo the update.
+  if (is_updated) {
     txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, old_tuple, this);
   }
   return is_updated;
@@ -136,6 +182,8 @@ void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Delete the tuple from the page.
   page->WLatch();
+  BUSTUB_ASSERT(!enable_logging || txn->IsExclusiveLocked(rid) || TableLockCovers(txn, true),
+                "We must own the exclusive lock!");
   page->ApplyDelete(rid, txn, log_manager_);
   lock_manager_->Unlock(txn, rid);
   page->WUnlatch();
@@ -148,12 +196,21 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Rollback the delete.
   page->WLatch();
+  BUSTUB_ASSERT(!enable_logging || txn->IsExclusiveLocked(rid) || TableLockCovers(txn, true),
+                "We must own an exclusive lock on the RID.");
   page->RollbackDelete(rid, txn, log_manager_);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
 bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
+  if (txn->IsSnapshot()) {
+    return GetSnapshotTuple(rid, tuple, txn);
+  }
+  LockManager *row_lock_manager;
+  if (!LockForRow(&rid, txn, false, &row_lock_manager)) {
+    return false;
+  }
   // Find the page which contains the tuple.
   auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -163,19 +220,36 @@ bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   }
   // Read the tuple from the page.
   page->RLatch();
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool res;
+  if (txn->GetIsolationLevel() != IsolationLevel::REPEATABLE_READ && !page->HasTuple(rid)) {
+    // Without a lock on the table, rows may go while a scan runs, which skips them.
+    res = false;
+  } else {
+    res = page->GetTuple(rid, tuple, txn, row_lock_manager);
+  }
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED && row_lock_manager != nullptr &&
+      txn->IsSharedLocked(rid)) {
+    row_lock_manager->Unlock(txn, rid);
+  }
   return res;
 }
 
 TableIterator TableHeap::Begin(Transaction *txn) {
+  // A scan reads every row, so one shared lock on the table replaces a lock per row. A snapshot needs none, and
+  // weaker isolation levels lock each row while they read it, if at all.
+  if (enable_logging && !txn->IsSnapshot() && txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ &&
+      !lock_manager_->LockTable(txn, LockMode::SHARED, first_page_id_)) {
+    return End();
+  }
   // Start an iterator from the first page.
   auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
   page->RLatch();
   RID rid;
   // If this fails because there is no tuple, then RID will be the default-constructed value, which means EOF.
-  page->GetFirstTupleRid(&rid);
+  // A snapshot may see rows that were deleted since, so its scan visits empty slots too.
+  page->GetFirstTupleRid(&rid, txn->IsSnapshot());
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(first_page_id_, false);
   return TableIterator(this, rid, txn);
@@ -183,4 +257,94 @@ TableIterator TableHeap::Begin(Transaction *txn) {
 
 TableIterator TableHeap::End() { return TableIterator(this, RID(INVALID_PAGE_ID, 0), nullptr); }
 
+bool TableHeap::LockForRow(const RID *rid, Transaction *txn, bool exclusive, LockManager **row_lock_manager) {
+  *row_lock_manager = lock_manager_;
+  if (!enable_logging) {
+    return true;
+  }
+  bool unlocked_read = !exclusive && txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED;
+  if (unlocked_read || TableLockCovers(txn, exclusive)) {
+    *row_lock_manager = nullptr;
+    return true;
+  }
+  if (!lock_manager_->LockTable(txn, exclusive ? LockMode::INTENTION_EXCLUSIVE : LockMode::INTENTION_SHARED,
+                                first_page_id_)) {
+    return false;
+  }
+  if (rid == nullptr || txn->IsExclusiveLocked(*rid) || (!exclusive && txn->IsSharedLocked(*rid))) {
+    return true;
+  }
+  bool locked;
+  if (!exclusive) {
+    // The shared locks of READ_COMMITTED only last for a read, which escalation would make last longer.
+    bool counted = txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ;
+    locked = lock_manager_->LockShared(txn, *rid, counted ? first_page_id_ : INVALID_PAGE_ID);
+  } else if (txn->IsSharedLocked(*rid)) {
+    locked = lock_manager_->LockUpgrade(txn, *rid);
+  } else {
+    locked = lock_manager_->LockExclusive(txn, *rid, first_page_id_);
+  }
+  // The row lock may have been escalated to a table lock.
+  if (locked && TableLockCovers(txn, exclusive)) {
+    *row_lock_manager = nullptr;
+  }
+  return locked;
+}
+
+bool TableHeap::TableLockCovers(Transaction *txn, bool exclusive) {
+  auto table_lock_set = txn->GetTableLockSet();
+  auto held = table_lock_set->find(first_page_id_);
+  return held != table_lock_set->end() &&
+         LockManager::Covers(held->second, exclusive ? LockMode::EXCLUSIVE : LockMode::SHARED);
+}
+
+bool TableHeap::CheckSnapshotWrite(const RID &rid, Transaction *txn) {
+  // The row lock made a writer that got there first finish, so that its commit counts.
+  if (!txn->GetVersionStore()->CanWrite(txn, rid)) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  return true;
+}
+
+bool TableHeap::BufferWrite(const RID &rid, WType wtype, const Tuple &tuple, Transaction *txn) {
+  // The row has to exist for the write to succeed, so the transaction reads it.
+  Tuple current;
+  if (!GetTuple(rid, &current, txn)) {
+    return false;
+  }
+  txn->GetWriteSet()->emplace_back(rid, wtype, tuple, this);
+  return true;
+}
+
+bool TableHeap::GetSnapshotTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
+  if (txn->BuffersWrites()) {
+    // The last buffered write of the row is what the transaction sees.
+    auto write_set = txn->GetWriteSet();
+    for (auto item = write_set->rbegin(); item != write_set->rend(); ++item) {
+      if (item->rid_ == rid) {
+        *tuple = item->tuple_;
+        tuple->rid_ = rid;
+        return item->wtype_ != WType::DELETE;
+      }
+    }
+    txn->GetReadSet()->insert(rid);
+  }
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  if (page == nullptr) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  // Writers add versions under the write latch, so the page and the version store agree here.
+  page->RLatch();
+  VersionVisibility visibility = txn->GetVersionStore()->GetVersion(txn, rid, tuple);
+  bool res = visibility == VersionVisibility::OLD;
+  if (visibility == VersionVisibility::CURRENT && page->HasTuple(rid)) {
+    res = page->GetTuple(rid, tuple, txn, nullptr);
+  }
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  return res;
+}
+
 }  // namespace bustub
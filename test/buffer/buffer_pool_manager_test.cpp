@@ -14,6 +14,7 @@
 #include <cstdio>
 #include <string>
 #include "gtest/gtest.h"
+#include "recovery/log_manager.h"
 #include <iostream>
 
 namespace bustub {
@@ -166,4 +167,62 @@ TEST(BufferPoolManagerTest, BasicTest) {
   
 }
 
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, WalAwareEvictionTest) {
+  remove("test.db");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  auto *bpm = new BufferPoolManager(3, disk_manager, log_manager);
+  // Log without a flush thread, so that records only become durable when the test or the buffer pool flushes.
+  enable_logging = true;
+
+  page_id_t page_ids[3];
+  Page *pages[3];
+  for (int i = 0; i < 3; i++) {
+    pages[i] = bpm->NewPage(&page_ids[i]);
+    ASSERT_NE(nullptr, pages[i]);
+  }
+  LogRecord durable_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::BEGIN);
+  log_manager->Flush(log_manager->AppendLogRecord(&durable_record));
+  LogRecord pending_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::BEGIN);
+  lsn_t pending_lsn = log_manager->AppendLogRecord(&pending_record);
+  pages[0]->SetLSN(pending_lsn);
+  pages[1]->SetLSN(durable_record.GetLSN());
+  EXPECT_TRUE(bpm->UnpinPage(page_ids[0], true));
+  EXPECT_TRUE(bpm->UnpinPage(page_ids[1], true));
+
+  // Scenario: the clock reaches page 0 first, but its log is not durable. Page 1 is evicted instead, and the log of
+  // page 0 is left to the flush thread.
+  page_id_t page_id;
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+  BufferPoolStats stats = bpm->GetStats();
+  EXPECT_EQ(1U, stats.evictions_);
+  EXPECT_EQ(1U, stats.dirty_evictions_);
+  EXPECT_EQ(1U, stats.async_flush_requests_);
+  EXPECT_EQ(0U, stats.wal_forced_flushes_);
+  EXPECT_LT(log_manager->GetPersistentLSN(), pending_lsn);
+
+  // Scenario: page 0 is the only candidate left, so eviction has to wait for the log, but not under the latch.
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+  stats = bpm->GetStats();
+  EXPECT_EQ(2U, stats.evictions_);
+  EXPECT_EQ(1U, stats.wal_forced_flushes_);
+  EXPECT_LE(pending_lsn, log_manager->GetPersistentLSN());
+
+  // Scenario: flushing a pinned page forces its log too, with the page latched instead of the buffer pool.
+  LogRecord page_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::BEGIN);
+  lsn_t page_lsn = log_manager->AppendLogRecord(&page_record);
+  pages[2]->SetLSN(page_lsn);
+  EXPECT_TRUE(bpm->FlushPage(page_ids[2]));
+  EXPECT_EQ(2U, bpm->GetStats().wal_forced_flushes_);
+  EXPECT_LE(page_lsn, log_manager->GetPersistentLSN());
+
+  enable_logging = false;
+  delete bpm;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+  remove("test.db");
+}
+
 }  // namespace bustub
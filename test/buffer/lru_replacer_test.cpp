@@ -59,4 +59,23 @@ TEST(LRUReplacerTest, DISABLED_SampleTest) {
   EXPECT_EQ(4, value);
 }
 
+TEST(LRUReplacerTest, DISABLED_PreferredVictimTest) {
+  LRUReplacer lru_replacer(7);
+  for (int i = 1; i <= 4; i++) {
+    lru_replacer.Unpin(i);
+  }
+
+  // Scenario: the least recently used frames are passed over if they are not preferred, and stay in the replacer.
+  int value;
+  EXPECT_TRUE(lru_replacer.PreferredVictim(&value, [](frame_id_t frame_id) { return frame_id >= 3; }));
+  EXPECT_EQ(3, value);
+  EXPECT_EQ(3, lru_replacer.Size());
+
+  // Scenario: no victim if no frame is preferred, and the replacer keeps all of them.
+  EXPECT_FALSE(lru_replacer.PreferredVictim(&value, [](frame_id_t) { return false; }));
+  EXPECT_EQ(3, lru_replacer.Size());
+  lru_replacer.Victim(&value);
+  EXPECT_EQ(4, value);
+}
+
 }  // namespace bustub
@@ -0,0 +1,83 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lz_util_test.cpp
+//
+// Identification: test/common/lz_util_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "common/util/lz_util.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+/** Compresses and decompresses input, checking that the round trip is lossless. Returns the compressed size. */
+uint32_t RoundTrip(const std::vector<char> &input) {
+  auto size = static_cast<uint32_t>(input.size());
+  // Incompressible input grows by a little more than 1/255.
+  std::vector<char> compressed(size + size / 255 + 16);
+  uint32_t compressed_size = LZUtil::Compress(input.data(), size, compressed.data(), compressed.size());
+  EXPECT_GT(compressed_size, 0);
+
+  std::vector<char> output(size);
+  EXPECT_TRUE(LZUtil::Decompress(compressed.data(), compressed_size, output.data(), size));
+  EXPECT_EQ(input, output);
+  return compressed_size;
+}
+
+// NOLINTNEXTLINE
+TEST(LZUtilTest, RoundTripTest) {
+  std::mt19937 generator(15445);
+
+  // Scenario: empty and tiny inputs.
+  RoundTrip({});
+  RoundTrip({'a'});
+  RoundTrip({'a', 'b', 'c', 'a', 'b', 'c', 'a'});
+
+  // Scenario: random bytes do not compress but survive.
+  std::vector<char> random(10000);
+  for (auto &c : random) {
+    c = static_cast<char>(generator());
+  }
+  RoundTrip(random);
+
+  // Scenario: long runs and repeated patterns compress well, including matches longer than 15 + 255 bytes.
+  std::vector<char> runs(10000, 'x');
+  EXPECT_LT(RoundTrip(runs), 100);
+  std::vector<char> pattern;
+  for (int i = 0; i < 1000; i++) {
+    pattern.push_back(static_cast<char>(i % 7));
+    pattern.push_back(static_cast<char>(generator() % 4));
+  }
+  RoundTrip(pattern);
+}
+
+// NOLINTNEXTLINE
+TEST(LZUtilTest, CapacityAndCorruptionTest) {
+  std::vector<char> input(4096);
+  for (size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<char>(i % 13);
+  }
+  std::vector<char> compressed(input.size());
+  uint32_t size = LZUtil::Compress(input.data(), input.size(), compressed.data(), compressed.size());
+  ASSERT_GT(size, 0);
+
+  // Scenario: output that does not fit is reported instead of overflowing.
+  EXPECT_EQ(0, LZUtil::Compress(input.data(), input.size(), compressed.data(), size - 1));
+
+  // Scenario: truncated blocks and wrong sizes are rejected.
+  std::vector<char> output(input.size());
+  EXPECT_FALSE(LZUtil::Decompress(compressed.data(), size - 1, output.data(), output.size()));
+  EXPECT_FALSE(LZUtil::Decompress(compressed.data(), size, output.data(), output.size() - 1));
+  EXPECT_TRUE(LZUtil::Decompress(compressed.data(), size, output.data(), output.size()));
+}
+
+}  // namespace bustub
@@ -0,0 +1,160 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// isolation_level_test.cpp
+//
+// Identification: test/concurrency/isolation_level_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <random>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "common/logger.h"
+#include "gtest/gtest.h"
+#include "table_test_util.h"  // NOLINT
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(IsolationLevelTest, ReadCommittedTest) {
+  TestTable table(2, 0);
+  auto *txn_mgr = table.txn_mgr_;
+  const auto &rids = table.rids_;
+
+  // Scenario: a read keeps no lock on its row, so a writer does not wait for the reader, which sees the new value
+  // once it is committed.
+  Transaction *reader = txn_mgr->Begin(nullptr, ConcurrencyControl::LOCKING, IsolationLevel::READ_COMMITTED);
+  EXPECT_EQ(0, table.Read(rids[0], reader));
+  EXPECT_TRUE(reader->GetSharedLockSet()->empty());
+  EXPECT_EQ(LockMode::INTENTION_SHARED, reader->GetTableLockSet()->at(table.table_->GetFirstPageId()));
+  Transaction *writer = txn_mgr->Begin();
+  EXPECT_TRUE(table.Write(rids[0], 1, writer));
+
+  // A read of a row that is being written waits for the commit.
+  std::atomic<int> value{-2};
+  std::thread t([&] { value = table.Read(rids[0], reader); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(-2, value);
+  txn_mgr->Commit(writer);
+  delete writer;
+  t.join();
+  EXPECT_EQ(1, value);
+  EXPECT_EQ(TransactionState::GROWING, reader->GetState());
+
+  // Scenario: a scan locks no table either, and skips rows deleted under it.
+  writer = txn_mgr->Begin();
+  EXPECT_TRUE(table.table_->MarkDelete(rids[1], writer));
+  txn_mgr->Commit(writer);
+  delete writer;
+  int count = 0;
+  for (auto it = table.table_->Begin(reader); it != table.table_->End(); ++it) {
+    count++;
+  }
+  EXPECT_EQ(1, count);
+  EXPECT_EQ(LockMode::INTENTION_SHARED, reader->GetTableLockSet()->at(table.table_->GetFirstPageId()));
+
+  // Writes keep their locks until the end.
+  EXPECT_TRUE(table.Write(rids[0], 2, reader));
+  EXPECT_TRUE(reader->IsExclusiveLocked(rids[0]));
+  txn_mgr->Commit(reader);
+  delete reader;
+}
+
+// NOLINTNEXTLINE
+TEST(IsolationLevelTest, ReadUncommittedTest) {
+  TestTable table(1, 0);
+  auto *txn_mgr = table.txn_mgr_;
+  auto *lock_mgr = table.bustub_instance_->lock_manager_;
+  const RID &rid = table.rids_[0];
+
+  // Scenario: reads take no locks and see what a writer has not committed.
+  Transaction *writer = txn_mgr->Begin();
+  EXPECT_TRUE(table.Write(rid, 1, writer));
+  Transaction *reader = txn_mgr->Begin(nullptr, ConcurrencyControl::LOCKING, IsolationLevel::READ_UNCOMMITTED);
+  EXPECT_EQ(1, table.Read(rid, reader));
+  int count = 0;
+  for (auto it = table.table_->Begin(reader); it != table.table_->End(); ++it) {
+    count++;
+  }
+  EXPECT_EQ(1, count);
+  EXPECT_TRUE(reader->GetSharedLockSet()->empty());
+  EXPECT_TRUE(reader->GetTableLockSet()->empty());
+  txn_mgr->Abort(writer);
+  delete writer;
+  EXPECT_EQ(0, table.Read(rid, reader));
+
+  // Scenario: asking for a shared lock aborts the transaction.
+  EXPECT_FALSE(lock_mgr->LockShared(reader, rid));
+  EXPECT_EQ(TransactionState::ABORTED, reader->GetState());
+  txn_mgr->Abort(reader);
+  delete reader;
+}
+
+// NOLINTNEXTLINE
+TEST(IsolationLevelTest, ReportingScanBenchmark) {
+  const int num_rows = 200;
+  const int num_writers = 4;
+  TestTable table(num_rows, 0);
+  auto *txn_mgr = table.txn_mgr_;
+  const auto &rids = table.rids_;
+
+  // Scenario: a reporting query scans the table over and over while writers update single rows.
+  const std::vector<std::pair<IsolationLevel, const char *>> levels{
+      {IsolationLevel::REPEATABLE_READ, "repeatable read"},
+      {IsolationLevel::READ_COMMITTED, "read committed"},
+      {IsolationLevel::READ_UNCOMMITTED, "read uncommitted"}};
+  for (const auto &[level, name] : levels) {
+    std::atomic<bool> stop{false};
+    std::atomic<int> writes{0};
+    std::vector<std::thread> writers;
+    for (int w = 0; w < num_writers; w++) {
+      writers.emplace_back([&, w] {
+        std::mt19937 rng(w);
+        while (!stop) {
+          Transaction *txn = txn_mgr->Begin();
+          txn->SetAsyncCommit(true);
+          if (table.Write(rids[rng() % num_rows], w, txn)) {
+            txn_mgr->Commit(txn);
+            writes++;
+          } else {
+            txn_mgr->Abort(txn);
+          }
+          delete txn;
+        }
+      });
+    }
+    int scans = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(300)) {
+      Transaction *scanner = txn_mgr->Begin(nullptr, ConcurrencyControl::LOCKING, level);
+      int count = 0;
+      for (auto it = table.table_->Begin(scanner); it != table.table_->End(); ++it) {
+        count++;
+      }
+      if (scanner->GetState() == TransactionState::ABORTED) {
+        txn_mgr->Abort(scanner);
+      } else {
+        EXPECT_EQ(num_rows, count);
+        txn_mgr->Commit(scanner);
+        scans++;
+      }
+      delete scanner;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stop = true;
+    for (auto &t : writers) {
+      t.join();
+    }
+    LOG_INFO("%s: %.0f scans/s, %.0f writes/s", name, scans / seconds, writes / seconds);
+  }
+}
+
+}  // namespace bustub
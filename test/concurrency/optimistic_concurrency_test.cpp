@@ -0,0 +1,193 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// optimistic_concurrency_test.cpp
+//
+// Identification: test/concurrency/optimistic_concurrency_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <random>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "common/logger.h"
+#include "gtest/gtest.h"
+#include "table_test_util.h"  // NOLINT
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(OptimisticConcurrencyTest, BufferedWriteTest) {
+  TestTable table(2, 0, 1);
+  auto *txn_mgr = table.txn_mgr_;
+  const auto &rids = table.rids_;
+
+  // Scenario: writes stay in the write set, where only the transaction itself sees them, and take no locks.
+  Transaction *optimistic = txn_mgr->Begin(nullptr, ConcurrencyControl::OPTIMISTIC);
+  EXPECT_TRUE(table.Write(rids[0], 10, optimistic));
+  EXPECT_TRUE(table.table_->MarkDelete(rids[1], optimistic));
+  EXPECT_FALSE(table.Write(rids[1], 11, optimistic));
+  RID new_rid;
+  EXPECT_TRUE(table.Insert(2, &new_rid, optimistic));
+  EXPECT_EQ(INVALID_PAGE_ID, new_rid.GetPageId());
+  EXPECT_EQ(10, table.Read(rids[0], optimistic));
+  EXPECT_EQ(-1, table.Read(rids[1], optimistic));
+  EXPECT_TRUE(optimistic->GetExclusiveLockSet()->empty());
+  EXPECT_TRUE(optimistic->GetTableLockSet()->empty());
+
+  Transaction *reader = txn_mgr->Begin();
+  EXPECT_EQ(0, table.Read(rids[0], reader));
+  EXPECT_EQ(1, table.Read(rids[1], reader));
+  txn_mgr->Commit(reader);
+  delete reader;
+
+  // Scenario: the commit applies them.
+  txn_mgr->Commit(optimistic);
+  EXPECT_EQ(TransactionState::COMMITTED, optimistic->GetState());
+  delete optimistic;
+  reader = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+  int count;
+  EXPECT_EQ(12, table.Scan(reader, &count));
+  EXPECT_EQ(2, count);
+  txn_mgr->Commit(reader);
+  delete reader;
+
+  // Scenario: an abort drops them without touching the table.
+  optimistic = txn_mgr->Begin(nullptr, ConcurrencyControl::OPTIMISTIC);
+  EXPECT_TRUE(table.Write(rids[0], 20, optimistic));
+  txn_mgr->Abort(optimistic);
+  delete optimistic;
+  reader = txn_mgr->Begin();
+  EXPECT_EQ(10, table.Read(rids[0], reader));
+  txn_mgr->Commit(reader);
+  delete reader;
+}
+
+// NOLINTNEXTLINE
+TEST(OptimisticConcurrencyTest, ValidationTest) {
+  TestTable table(2, 0);
+  auto *txn_mgr = table.txn_mgr_;
+  const auto &rids = table.rids_;
+
+  // Scenario: a transaction fails validation if a row it read changed since it started.
+  Transaction *optimistic = txn_mgr->Begin(nullptr, ConcurrencyControl::OPTIMISTIC);
+  EXPECT_EQ(0, table.Read(rids[0], optimistic));
+  EXPECT_TRUE(table.Write(rids[1], 1, optimistic));
+  Transaction *writer = txn_mgr->Begin();
+  EXPECT_TRUE(table.Write(rids[0], 1, writer));
+  txn_mgr->Commit(writer);
+  delete writer;
+  txn_mgr->Commit(optimistic);
+  EXPECT_EQ(TransactionState::ABORTED, optimistic->GetState());
+  delete optimistic;
+
+  // Scenario: write skew. Each transaction reads both rows and writes one of them. Snapshot isolation lets both
+  // commit, validation only the first one.
+  for (auto concurrency_control : {ConcurrencyControl::SNAPSHOT, ConcurrencyControl::OPTIMISTIC}) {
+    Transaction *txns[2];
+    for (int i = 0; i < 2; i++) {
+      txns[i] = txn_mgr->Begin(nullptr, concurrency_control);
+      int total = table.Read(rids[0], txns[i]) + table.Read(rids[1], txns[i]);
+      EXPECT_TRUE(table.Write(rids[i], total + 1, txns[i]));
+    }
+    for (auto *t : txns) {
+      txn_mgr->Commit(t);
+    }
+    EXPECT_EQ(TransactionState::COMMITTED, txns[0]->GetState());
+    EXPECT_EQ(concurrency_control == ConcurrencyControl::SNAPSHOT ? TransactionState::COMMITTED
+                                                                   : TransactionState::ABORTED,
+              txns[1]->GetState());
+    for (auto *t : txns) {
+      delete t;
+    }
+  }
+}
+
+/** Throughput of a mix of transactions, see RunTableMix(). */
+struct TableMixResult {
+  int committed_{0};
+  int aborted_{0};
+  double seconds_{0};
+};
+
+/**
+ * Run transactions that each access rows_per_txn random rows of a table, and write each with write_percent
+ * probability. Aborted transactions are retried until they commit.
+ */
+TableMixResult RunTableMix(TestTable *table, ConcurrencyControl concurrency_control, int write_percent) {
+  const int num_threads = 4;
+  const int txns_per_thread = 1000;
+  const int rows_per_txn = 8;
+  auto *txn_mgr = table->txn_mgr_;
+  const auto &rids = table->rids_;
+  std::atomic<int> committed{0};
+  std::atomic<int> aborted{0};
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      for (int i = 0; i < txns_per_thread;) {
+        Transaction *txn = txn_mgr->Begin(nullptr, concurrency_control);
+        // The log is not what this compares.
+        txn->SetAsyncCommit(true);
+        bool ok = true;
+        for (int j = 0; ok && j < rows_per_txn; j++) {
+          const RID &rid = rids[rng() % rids.size()];
+          int value = table->Read(rid, txn);
+          ok = value >= 0;
+          if (ok && static_cast<int>(rng() % 100) < write_percent) {
+            ok = table->Write(rid, value + 1, txn);
+          }
+        }
+        if (ok && txn->GetState() != TransactionState::ABORTED) {
+          txn_mgr->Commit(txn);
+        } else {
+          txn_mgr->Abort(txn);
+        }
+        if (txn->GetState() == TransactionState::COMMITTED) {
+          committed++;
+          i++;
+        } else {
+          aborted++;
+        }
+        delete txn;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  TableMixResult result;
+  result.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.committed_ = committed;
+  result.aborted_ = aborted;
+  EXPECT_EQ(num_threads * txns_per_thread, result.committed_);
+  return result;
+}
+
+// NOLINTNEXTLINE
+TEST(OptimisticConcurrencyTest, MixBenchmark) {
+  const int num_rows = 1000;
+  TestTable table(num_rows, 0);
+
+  // Scenario: short transactions on a table, mostly reading or writing half of the rows they access.
+  const std::vector<std::pair<ConcurrencyControl, const char *>> modes{{ConcurrencyControl::LOCKING, "locking"},
+                                                                       {ConcurrencyControl::OPTIMISTIC, "optimistic"}};
+  for (int write_percent : {5, 50}) {
+    for (const auto &[mode, name] : modes) {
+      auto result = RunTableMix(&table, mode, write_percent);
+      LOG_INFO("%d%% writes, %s: %.0f txn/s, %.1f%% of transactions aborted", write_percent, name,
+               result.committed_ / result.seconds_, 100.0 * result.aborted_ / (result.committed_ + result.aborted_));
+    }
+  }
+}
+
+}  // namespace bustub
@@ -0,0 +1,193 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// snapshot_isolation_test.cpp
+//
+// Identification: test/concurrency/snapshot_isolation_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <random>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/logger.h"
+#include "concurrency/version_store.h"
+#include "gtest/gtest.h"
+#include "table_test_util.h"  // NOLINT
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, SnapshotReadTest) {
+  const int num_rows = 10;
+  TestTable table(num_rows, 0, 1);
+  auto *txn_mgr = table.txn_mgr_;
+  const auto &rids = table.rids_;
+  EXPECT_EQ(0U, txn_mgr->GetVersionStore()->GetVersionedRowCount());
+
+  // Scenario: a snapshot reads without locks, so a writer of the same row does not wait for it.
+  Transaction *snapshot = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+  EXPECT_EQ(0, table.Read(rids[0], snapshot));
+  Transaction *writer = txn_mgr->Begin();
+  EXPECT_TRUE(table.Write(rids[0], 100, writer));
+  EXPECT_TRUE(table.table_->MarkDelete(rids[1], writer));
+  RID new_rid;
+  EXPECT_TRUE(table.Insert(1000, &new_rid, writer));
+  // The snapshot does not see what the writer has not committed.
+  EXPECT_EQ(0, table.Read(rids[0], snapshot));
+  EXPECT_EQ(1, table.Read(rids[1], snapshot));
+  txn_mgr->Commit(writer);
+  delete writer;
+
+  // Scenario: nor what it committed after the snapshot was taken, in point reads and in scans.
+  EXPECT_EQ(0, table.Read(rids[0], snapshot));
+  EXPECT_EQ(1, table.Read(rids[1], snapshot));
+  EXPECT_EQ(-1, table.Read(new_rid, snapshot));
+  int count;
+  EXPECT_EQ(num_rows * (num_rows - 1) / 2, table.Scan(snapshot, &count));
+  EXPECT_EQ(num_rows, count);
+  EXPECT_TRUE(snapshot->GetSharedLockSet()->empty());
+  EXPECT_TRUE(snapshot->GetTableLockSet()->empty());
+
+  // A new snapshot sees the commit.
+  Transaction *later = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+  EXPECT_EQ(100, table.Read(rids[0], later));
+  EXPECT_EQ(-1, table.Read(rids[1], later));
+  EXPECT_EQ(1000, table.Read(new_rid, later));
+  EXPECT_EQ(num_rows * (num_rows - 1) / 2 - 1 + 100 + 1000, table.Scan(later, &count));
+  EXPECT_EQ(num_rows, count);
+  txn_mgr->Commit(later);
+  delete later;
+
+  // Scenario: the old versions go once the last snapshot that sees them ends.
+  EXPECT_EQ(3U, txn_mgr->GetVersionStore()->GetVersionedRowCount());
+  txn_mgr->Commit(snapshot);
+  delete snapshot;
+  EXPECT_EQ(0U, txn_mgr->GetVersionStore()->GetVersionedRowCount());
+}
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, FirstUpdaterWinsTest) {
+  TestTable table(2, 0);
+  auto *txn_mgr = table.txn_mgr_;
+  const auto &rids = table.rids_;
+
+  // Scenario: the second writer of a row waits for the first one, and aborts once the first one commits.
+  Transaction *first = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+  Transaction *second = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+  EXPECT_TRUE(table.Write(rids[0], 1, first));
+  std::atomic<bool> done{false};
+  std::thread t([&] {
+    EXPECT_FALSE(table.Write(rids[0], 2, second));
+    done = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(done);
+  txn_mgr->Commit(first);
+  t.join();
+  EXPECT_EQ(TransactionState::ABORTED, second->GetState());
+  txn_mgr->Abort(second);
+  delete first;
+  delete second;
+
+  // Scenario: a writer that got there first and aborted does not count.
+  first = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+  second = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+  EXPECT_TRUE(table.Write(rids[1], 3, first));
+  t = std::thread([&] {
+    EXPECT_TRUE(table.Write(rids[1], 4, second));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  txn_mgr->Abort(first);
+  t.join();
+  txn_mgr->Commit(second);
+  delete first;
+  delete second;
+
+  // Scenario: a row committed after the snapshot was taken cannot be written, even though nobody holds it now.
+  Transaction *snapshot = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+  Transaction *writer = txn_mgr->Begin();
+  EXPECT_TRUE(table.table_->MarkDelete(rids[0], writer));
+  txn_mgr->Commit(writer);
+  delete writer;
+  EXPECT_FALSE(table.table_->MarkDelete(rids[0], snapshot));
+  EXPECT_EQ(TransactionState::ABORTED, snapshot->GetState());
+  txn_mgr->Abort(snapshot);
+  delete snapshot;
+
+  Transaction *txn = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+  EXPECT_EQ(-1, table.Read(rids[0], txn));
+  EXPECT_EQ(4, table.Read(rids[1], txn));
+  txn_mgr->Commit(txn);
+  delete txn;
+  EXPECT_EQ(0U, txn_mgr->GetVersionStore()->GetVersionedRowCount());
+}
+
+// NOLINTNEXTLINE
+TEST(SnapshotIsolationTest, ConsistentScanBenchmark) {
+  const int num_rows = 64;
+  const int initial = 100;
+  const int num_writers = 4;
+  TestTable table(num_rows, initial);
+  auto *txn_mgr = table.txn_mgr_;
+  const auto &rids = table.rids_;
+
+  // Scenario: writers move amounts between rows while scans run; every scan sees the same total and none waits.
+  std::atomic<bool> stop{false};
+  std::atomic<int> transfers{0};
+  std::atomic<int> conflicts{0};
+  std::vector<std::thread> writers;
+  for (int w = 0; w < num_writers; w++) {
+    writers.emplace_back([&, w] {
+      std::mt19937 gen(w);
+      std::uniform_int_distribution<int> row(0, num_rows - 1);
+      while (!stop) {
+        int from = row(gen);
+        int to = row(gen);
+        if (from == to) {
+          continue;
+        }
+        Transaction *txn = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+        int from_value = table.Read(rids[from], txn);
+        int to_value = table.Read(rids[to], txn);
+        bool ok = table.Write(rids[from], from_value - 1, txn) && table.Write(rids[to], to_value + 1, txn);
+        if (ok && txn->GetState() != TransactionState::ABORTED) {
+          txn_mgr->Commit(txn);
+          transfers++;
+        } else {
+          txn_mgr->Abort(txn);
+          conflicts++;
+        }
+        delete txn;
+      }
+    });
+  }
+  int scans = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500)) {
+    Transaction *scanner = txn_mgr->Begin(nullptr, ConcurrencyControl::SNAPSHOT);
+    int count;
+    EXPECT_EQ(num_rows * initial, table.Scan(scanner, &count));
+    EXPECT_EQ(num_rows, count);
+    txn_mgr->Commit(scanner);
+    delete scanner;
+    scans++;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stop = true;
+  for (auto &t : writers) {
+    t.join();
+  }
+  EXPECT_LT(0, transfers);
+  EXPECT_EQ(0U, txn_mgr->GetVersionStore()->GetVersionedRowCount());
+  LOG_INFO("%d consistent scans and %d transfers in %.2f s, %d transfers aborted by conflicts", scans,
+           transfers.load(), seconds, conflicts.load());
+}
+
+}  // namespace bustub
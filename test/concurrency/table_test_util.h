@@ -0,0 +1,93 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// table_test_util.h
+//
+// Identification: test/concurrency/table_test_util.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "common/bustub_instance.h"
+#include "concurrency/transaction_manager.h"
+#include "gtest/gtest.h"
+#include "storage/disk/disk_manager.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+/**
+ * A table of one INTEGER column in a fresh test.db, with the log flush thread running, for the tests of concurrency
+ * control. Row i starts out as first_value + i * step, inserted by a transaction that committed.
+ */
+class TestTable {
+ public:
+  TestTable(int num_rows, int first_value, int step = 0) : rids_(num_rows) {
+    remove("test.db");
+    DiskManager::RemoveLog("test.db");
+    bustub_instance_ = new BustubInstance("test.db");
+    bustub_instance_->log_manager_->RunFlushThread();
+    txn_mgr_ = bustub_instance_->transaction_manager_;
+    Transaction *txn = txn_mgr_->Begin();
+    table_ = std::make_unique<TableHeap>(bustub_instance_->buffer_pool_manager_, bustub_instance_->lock_manager_,
+                                         bustub_instance_->log_manager_, txn);
+    for (int i = 0; i < num_rows; i++) {
+      EXPECT_TRUE(table_->InsertTuple(Tuple({ValueFactory::GetIntegerValue(first_value + i * step)}, &schema_),
+                                      &rids_[i], txn));
+    }
+    txn_mgr_->Commit(txn);
+    delete txn;
+  }
+
+  ~TestTable() {
+    table_.reset();
+    delete bustub_instance_;
+    remove("test.db");
+    DiskManager::RemoveLog("test.db");
+  }
+
+  /** @return the value of the row, or -1 if the transaction does not see it or could not read it */
+  int Read(const RID &rid, Transaction *txn) {
+    Tuple tuple;
+    return table_->GetTuple(rid, &tuple, txn) ? tuple.GetValue(&schema_, 0).GetAs<int32_t>() : -1;
+  }
+
+  /** Write value to the row. */
+  bool Write(const RID &rid, int value, Transaction *txn) {
+    return table_->UpdateTuple(Tuple({ValueFactory::GetIntegerValue(value)}, &schema_), rid, txn);
+  }
+
+  /** Insert a row of value, whose RID goes to rid. */
+  bool Insert(int value, RID *rid, Transaction *txn) {
+    return table_->InsertTuple(Tuple({ValueFactory::GetIntegerValue(value)}, &schema_), rid, txn);
+  }
+
+  /** @return the sum of the values that a scan sees, and their number in count */
+  int Scan(Transaction *txn, int *count) {
+    int sum = 0;
+    *count = 0;
+    for (auto it = table_->Begin(txn); it != table_->End(); ++it) {
+      sum += it->GetValue(&schema_, 0).GetAs<int32_t>();
+      (*count)++;
+    }
+    return sum;
+  }
+
+  BustubInstance *bustub_instance_;
+  TransactionManager *txn_mgr_;
+  Schema schema_{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  std::unique_ptr<TableHeap> table_;
+  /** The rows in the order they were inserted. */
+  std::vector<RID> rids_;
+};
+
+}  // namespace bustub
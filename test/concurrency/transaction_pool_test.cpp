@@ -0,0 +1,122 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_pool_test.cpp
+//
+// Identification: test/concurrency/transaction_pool_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+#include <unordered_set>
+#include <vector>
+
+#include "common/logger.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction.h"
+#include "concurrency/transaction_manager.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(TransactionPoolTest, ReuseTest) {
+  LockManager lock_mgr{TwoPLMode::REGULAR, DeadlockMode::DETECTION};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid{0, 0};
+
+  // Scenario: a recycled transaction begins again under a new ID, with nothing left of its last run.
+  Transaction *txn = txn_mgr.Begin(nullptr, ConcurrencyControl::LOCKING, IsolationLevel::READ_COMMITTED);
+  txn_id_t txn_id = txn->GetTransactionId();
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn, rid));
+  txn->SetAsyncCommit(!enable_async_commit);
+  txn_mgr.Commit(txn);
+  TransactionManager::Recycle(txn);
+  Transaction *reused = txn_mgr.Begin();
+  EXPECT_EQ(txn, reused);
+  EXPECT_NE(txn_id, reused->GetTransactionId());
+  EXPECT_EQ(TransactionState::GROWING, reused->GetState());
+  EXPECT_EQ(IsolationLevel::REPEATABLE_READ, reused->GetIsolationLevel());
+  EXPECT_EQ(enable_async_commit.load(), reused->IsAsyncCommit());
+  EXPECT_EQ(INVALID_LSN, reused->GetPrevLSN());
+  EXPECT_TRUE(reused->GetExclusiveLockSet()->empty());
+  EXPECT_TRUE(reused->GetTableRowLockSet()->empty());
+  EXPECT_EQ(reused, TransactionManager::GetTransaction(reused->GetTransactionId()));
+  EXPECT_TRUE(lock_mgr.LockShared(reused, rid));
+  txn_mgr.Abort(reused);
+  TransactionManager::Recycle(reused);
+
+  // Scenario: each thread keeps at most TXN_POOL_SIZE transactions, and only reuses its own.
+  std::vector<Transaction *> txns;
+  for (int i = 0; i < TXN_POOL_SIZE + 1; i++) {
+    txns.push_back(txn_mgr.Begin());
+  }
+  for (auto *t : txns) {
+    txn_mgr.Commit(t);
+    TransactionManager::Recycle(t);
+  }
+  std::thread([&] {
+    Transaction *other = txn_mgr.Begin();
+    for (auto *t : txns) {
+      EXPECT_NE(t, other);
+    }
+    txn_mgr.Commit(other);
+    delete other;
+  }).join();
+  // The last one was deleted, and a new transaction may take its memory.
+  std::unordered_set<Transaction *> pooled(txns.begin(), txns.end() - 1);
+  txns.clear();
+  for (int i = 0; i < TXN_POOL_SIZE + 1; i++) {
+    txns.push_back(txn_mgr.Begin());
+    EXPECT_EQ(i < TXN_POOL_SIZE, pooled.count(txns.back()) == 1);
+  }
+  for (auto *t : txns) {
+    txn_mgr.Commit(t);
+    delete t;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TransactionPoolTest, BeginCommitBenchmark) {
+  const int num_threads = 4;
+  const int txns_per_thread = 20000;
+  const int rows_per_txn = 4;
+  LockManager lock_mgr{TwoPLMode::REGULAR, DeadlockMode::DETECTION};
+  TransactionManager txn_mgr{&lock_mgr};
+
+  // Scenario: short transactions that each lock a few rows, deleted after they commit or handed back to the pool.
+  double throughput[2];
+  for (int recycle = 0; recycle < 2; recycle++) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < txns_per_thread; i++) {
+          Transaction *txn = txn_mgr.Begin();
+          for (int j = 0; j < rows_per_txn; j++) {
+            EXPECT_TRUE(lock_mgr.LockExclusive(txn, RID(t, i % 64 * rows_per_txn + j)));
+          }
+          txn_mgr.Commit(txn);
+          if (recycle != 0) {
+            TransactionManager::Recycle(txn);
+          } else {
+            delete txn;
+          }
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    throughput[recycle] = num_threads * txns_per_thread / seconds;
+  }
+  LOG_INFO("%d threads: %.0f txn/s deleting transactions, %.0f txn/s recycling them", num_threads, throughput[0],
+           throughput[1]);
+}
+
+}  // namespace bustub
@@ -0,0 +1,189 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// transaction_registry_test.cpp
+//
+// Identification: test/concurrency/transaction_registry_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <deque>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <random>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "common/logger.h"
+#include "concurrency/transaction.h"
+#include "concurrency/transaction_manager.h"
+#include "concurrency/transaction_registry.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+// NOLINTNEXTLINE
+TEST(TransactionRegistryTest, BasicTest) {
+  TransactionRegistry registry;
+  std::vector<std::unique_ptr<Transaction>> txns;
+  for (txn_id_t txn_id = 0; txn_id < 1000; txn_id++) {
+    txns.emplace_back(new Transaction(txn_id));
+    registry.Register(txns.back().get());
+  }
+  EXPECT_EQ(1000U, registry.Size());
+  for (auto &txn : txns) {
+    EXPECT_EQ(txn.get(), registry.Find(txn->GetTransactionId()));
+  }
+  EXPECT_EQ(nullptr, registry.Find(1000));
+
+  // Scenario: removed transactions are gone, the others stay, and the tables shrink back.
+  for (txn_id_t txn_id = 0; txn_id < 1000; txn_id += 2) {
+    registry.Remove(txn_id);
+  }
+  EXPECT_EQ(500U, registry.Size());
+  for (auto &txn : txns) {
+    txn_id_t txn_id = txn->GetTransactionId();
+    EXPECT_EQ(txn_id % 2 == 0 ? nullptr : txn.get(), registry.Find(txn_id));
+  }
+  for (txn_id_t txn_id = 1; txn_id < 1000; txn_id += 2) {
+    registry.Remove(txn_id);
+  }
+  EXPECT_EQ(0U, registry.Size());
+  EXPECT_GE(2U * TXN_REGISTRY_SHARDS * 16, registry.GetCapacity());
+
+  // Scenario: registering an ID again replaces the transaction.
+  Transaction other(7);
+  registry.Register(txns[7].get());
+  registry.Register(&other);
+  EXPECT_EQ(&other, registry.Find(7));
+  EXPECT_EQ(1U, registry.Size());
+}
+
+// NOLINTNEXTLINE
+TEST(TransactionRegistryTest, ChurnTest) {
+  const int num_writers = 4;
+  const int num_readers = 4;
+  const int txns_per_writer = 5000;
+  const size_t running = 32;
+  TransactionRegistry registry;
+  // Readers may find a transaction that is removed right after, so none of them is freed before the end.
+  std::vector<std::unique_ptr<Transaction>> txns;
+  for (txn_id_t txn_id = 0; txn_id < num_writers * txns_per_writer; txn_id++) {
+    txns.emplace_back(new Transaction(txn_id));
+  }
+
+  // Scenario: writers keep a window of running transactions, and readers look up IDs while tables are rebuilt.
+  std::atomic<bool> stop{false};
+  std::atomic<txn_id_t> next_txn_id{0};
+  std::vector<std::thread> threads;
+  for (int w = 0; w < num_writers; w++) {
+    threads.emplace_back([&] {
+      std::deque<txn_id_t> window;
+      for (int i = 0; i < txns_per_writer; i++) {
+        txn_id_t txn_id = next_txn_id++;
+        registry.Register(txns[txn_id].get());
+        EXPECT_EQ(txns[txn_id].get(), registry.Find(txn_id));
+        window.push_back(txn_id);
+        if (window.size() == running) {
+          registry.Remove(window.front());
+          window.pop_front();
+        }
+      }
+      for (txn_id_t txn_id : window) {
+        registry.Remove(txn_id);
+      }
+    });
+  }
+  std::atomic<int> found{0};
+  for (int r = 0; r < num_readers; r++) {
+    threads.emplace_back([&, r] {
+      std::mt19937 rng(r);
+      while (!stop) {
+        txn_id_t txn_id = static_cast<txn_id_t>(rng() % txns.size());
+        Transaction *txn = registry.Find(txn_id);
+        if (txn != nullptr) {
+          EXPECT_EQ(txns[txn_id].get(), txn);
+          found++;
+        }
+      }
+    });
+  }
+  for (int w = 0; w < num_writers; w++) {
+    threads[w].join();
+  }
+  stop = true;
+  for (size_t t = num_writers; t < threads.size(); t++) {
+    threads[t].join();
+  }
+
+  // The registry does not grow with the number of transactions that ran. Tables that the last lookups could still
+  // read are freed by the next writes to their shards.
+  EXPECT_EQ(0U, registry.Size());
+  EXPECT_LT(0, found);
+  for (txn_id_t txn_id = 0; txn_id < TXN_REGISTRY_SHARDS; txn_id++) {
+    registry.Register(txns[txn_id].get());
+    registry.Remove(txn_id);
+  }
+  EXPECT_EQ(TXN_REGISTRY_SHARDS * 16U, registry.GetCapacity());
+}
+
+// NOLINTNEXTLINE
+TEST(TransactionRegistryTest, LookupBenchmark) {
+  const int num_threads = 8;
+  const int lookups_per_thread = 1000000;
+  const int num_txns = 256;
+  std::vector<std::unique_ptr<Transaction>> txns;
+  TransactionRegistry registry;
+  std::unordered_map<txn_id_t, Transaction *> map;
+  std::mutex map_latch;
+  for (txn_id_t txn_id = 0; txn_id < num_txns; txn_id++) {
+    txns.emplace_back(new Transaction(txn_id));
+    registry.Register(txns.back().get());
+    map[txn_id] = txns.back().get();
+  }
+
+  // Scenario: many threads look up running transactions, in a map behind one latch and in the registry.
+  double throughput[2];
+  for (int registry_lookup = 0; registry_lookup < 2; registry_lookup++) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < lookups_per_thread; i++) {
+          txn_id_t txn_id = (i * 7 + t) % num_txns;
+          Transaction *txn;
+          if (registry_lookup != 0) {
+            txn = registry.Find(txn_id);
+          } else {
+            std::lock_guard<std::mutex> guard(map_latch);
+            txn = map[txn_id];
+          }
+          ASSERT_NE(nullptr, txn);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    throughput[registry_lookup] = num_threads * lookups_per_thread / seconds;
+  }
+  LOG_INFO("%d threads: %.1fM lookups/s in a latched map, %.1fM lookups/s in the registry", num_threads,
+           throughput[0] / 1e6, throughput[1] / 1e6);
+
+  // Scenario: TransactionManager registers transactions while they run.
+  TransactionManager txn_mgr{nullptr};
+  Transaction *txn = txn_mgr.Begin();
+  EXPECT_EQ(txn, TransactionManager::GetTransaction(txn->GetTransactionId()));
+  txn_mgr.Commit(txn);
+  EXPECT_EQ(nullptr, TransactionManager::txn_registry.Find(txn->GetTransactionId()));
+  delete txn;
+}
+
+}  // namespace bustub
@@ -0,0 +1,144 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// backup_manager_test.cpp
+//
+// Identification: test/recovery/backup_manager_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <cstdio>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/bustub_instance.h"
+#include "common/logger.h"
+#include "gtest/gtest.h"
+#include "recovery/backup_manager.h"
+#include "recovery/checkpoint_manager.h"
+#include "recovery/log_recovery.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+static const int NUM_BACKUP_TABLES = 8;
+
+/** Set the row of table t to value in a transaction of its own. */
+void SetRow(BustubInstance *bustub_instance, const std::vector<page_id_t> &first_page_ids,
+            const std::vector<RID> &rids, int t, int value) {
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_, bustub_instance->log_manager_,
+                  first_page_ids[t]);
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  EXPECT_TRUE(table.UpdateTuple(Tuple({ValueFactory::GetIntegerValue(value)}, &schema), rids[t], txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+}
+
+// NOLINTNEXTLINE
+TEST(BackupManagerTest, IncrementalBackupTest) {
+  remove("test.db");
+  remove("restore.db");
+  DiskManager::RemoveLog("test.db");
+  DiskManager::RemoveLog("restore.db");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  std::vector<page_id_t> first_page_ids;
+  std::vector<RID> rids(NUM_BACKUP_TABLES);
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  for (int t = 0; t < NUM_BACKUP_TABLES; t++) {
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, txn);
+    EXPECT_TRUE(table.InsertTuple(Tuple({ValueFactory::GetIntegerValue(t)}, &schema), &rids[t], txn));
+    first_page_ids.push_back(table.GetFirstPageId());
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  std::vector<int> expected(NUM_BACKUP_TABLES);
+  for (int t = 0; t < NUM_BACKUP_TABLES; t++) {
+    expected[t] = t;
+  }
+  bustub_instance->checkpoint_manager_->FuzzyCheckpoint();
+
+  // Scenario: a throttled full backup never holds up a writer that keeps changing tables 0 and 1.
+  std::atomic<bool> stop{false};
+  std::atomic<int> commits{0};
+  std::thread writer([&] {
+    for (int i = 0; !stop; i++) {
+      SetRow(bustub_instance, first_page_ids, rids, i % 2, 1000 + i);
+      bustub_instance->buffer_pool_manager_->FlushAllPages();
+      commits++;
+    }
+  });
+  BackupManager backup_manager("test.db");
+  BackupStats full = backup_manager.Backup("test.backup.0", INVALID_LSN, 40 * PAGE_SIZE);
+  stop = true;
+  writer.join();
+  EXPECT_LT(0, commits);
+  EXPECT_LT(0U, full.throttle_ns_);
+  EXPECT_EQ(full.pages_read_, full.pages_written_);
+  LOG_INFO("full backup: %lu pages, %lu log bytes, %lu rereads, %d commits meanwhile", full.pages_written_,
+           full.log_bytes_, full.page_rereads_, commits.load());
+
+  // Scenario: after a checkpoint, the increment only holds the pages changed since the full backup.
+  txn = bustub_instance->transaction_manager_->Begin();
+  for (int t = 0; t < 2; t++) {
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, first_page_ids[t]);
+    Tuple result;
+    EXPECT_TRUE(table.GetTuple(rids[t], &result, txn));
+    expected[t] = result.GetValue(&schema, 0).GetAs<int32_t>();
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  SetRow(bustub_instance, first_page_ids, rids, 5, 5000);
+  expected[5] = 5000;
+  bustub_instance->checkpoint_manager_->FuzzyCheckpoint();
+  BackupStats increment = backup_manager.Backup("test.backup.1", full.backup_lsn_);
+  EXPECT_LT(full.backup_lsn_, increment.backup_lsn_);
+  EXPECT_LT(increment.pages_written_, full.pages_written_);
+  LOG_INFO("incremental backup: %lu of %lu pages, %lu log bytes", increment.pages_written_, increment.pages_read_,
+           increment.log_bytes_);
+
+  // Scenario: an increment must follow the backup it was taken against.
+  EXPECT_THROW(BackupManager::Restore({"test.backup.1", "test.backup.1"}, "restore.db"), Exception);
+
+  // Changes after the last backup are not part of the restore.
+  SetRow(bustub_instance, first_page_ids, rids, 6, 6000);
+  delete bustub_instance;
+
+  // Scenario: the restored database holds what was committed when the increment was taken.
+  BackupManager::Restore({"test.backup.0", "test.backup.1"}, "restore.db");
+  bustub_instance = new BustubInstance("restore.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                           bustub_instance->log_manager_);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  txn = bustub_instance->transaction_manager_->Begin();
+  for (int t = 0; t < NUM_BACKUP_TABLES; t++) {
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, first_page_ids[t]);
+    Tuple result;
+    EXPECT_TRUE(table.GetTuple(rids[t], &result, txn));
+    EXPECT_EQ(expected[t], result.GetValue(&schema, 0).GetAs<int32_t>());
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete bustub_instance;
+
+  remove("test.db");
+  remove("restore.db");
+  DiskManager::RemoveLog("test.db");
+  DiskManager::RemoveLog("restore.db");
+  remove("test.backup.0");
+  remove("test.backup.1");
+}
+
+}  // namespace bustub
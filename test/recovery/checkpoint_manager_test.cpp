@@ -0,0 +1,131 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// checkpoint_manager_test.cpp
+//
+// Identification: test/recovery/checkpoint_manager_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/bustub_instance.h"
+#include "common/logger.h"
+#include "gtest/gtest.h"
+#include "recovery/checkpoint_manager.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+enum class CheckpointMode { NONE, BLOCKING, FUZZY };
+
+/**
+ * Runs short update transactions from several threads while another thread keeps taking checkpoints in the given
+ * mode, and reports the latency of the transactions.
+ * @param[out] max_checkpoint_us the longest checkpoint, including the wait for running transactions when blocking
+ * @return the 99th percentile transaction latency in microseconds
+ */
+double CheckpointLatencyP99(CheckpointMode mode, double *max_checkpoint_us) {
+  const int num_threads = 4;
+  const int rows_per_thread = 50;
+  const int updates_per_txn = 5;
+  const auto run_time = std::chrono::milliseconds(300);
+  const auto checkpoint_interval = std::chrono::milliseconds(20);
+
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}, Column{"b", TypeId::INTEGER}}};
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  std::vector<RID> rids(num_threads * rows_per_thread);
+  for (auto &rid : rids) {
+    std::vector<Value> values{ValueFactory::GetIntegerValue(0), ValueFactory::GetIntegerValue(0)};
+    EXPECT_TRUE(test_table->InsertTuple(Tuple(values, &schema), &rid, txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  std::atomic<bool> stop{false};
+  std::vector<std::vector<double>> latencies(num_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      // Every thread updates its own rows, so that the transactions never conflict.
+      for (int i = 0; !stop; i++) {
+        auto start = std::chrono::steady_clock::now();
+        Transaction *txn = bustub_instance->transaction_manager_->Begin();
+        for (int k = 0; k < updates_per_txn; k++) {
+          std::vector<Value> values{ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(k)};
+          const RID &rid = rids[t * rows_per_thread + (i * updates_per_txn + k) % rows_per_thread];
+          EXPECT_TRUE(test_table->UpdateTuple(Tuple(values, &schema), rid, txn));
+        }
+        bustub_instance->transaction_manager_->Commit(txn);
+        delete txn;
+        auto latency = std::chrono::steady_clock::now() - start;
+        latencies[t].push_back(std::chrono::duration<double, std::micro>(latency).count());
+      }
+    });
+  }
+
+  *max_checkpoint_us = 0;
+  auto end = std::chrono::steady_clock::now() + run_time;
+  while (std::chrono::steady_clock::now() < end) {
+    std::this_thread::sleep_for(checkpoint_interval);
+    auto start = std::chrono::steady_clock::now();
+    if (mode == CheckpointMode::BLOCKING) {
+      bustub_instance->checkpoint_manager_->BeginCheckpoint();
+      bustub_instance->checkpoint_manager_->EndCheckpoint();
+    } else if (mode == CheckpointMode::FUZZY) {
+      bustub_instance->checkpoint_manager_->FuzzyCheckpoint();
+    }
+    auto duration = std::chrono::steady_clock::now() - start;
+    *max_checkpoint_us = std::max(*max_checkpoint_us, std::chrono::duration<double, std::micro>(duration).count());
+  }
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (mode == CheckpointMode::FUZZY) {
+    EXPECT_LT(0U, bustub_instance->checkpoint_manager_->GetStats().checkpoints_);
+  }
+
+  std::vector<double> all;
+  for (const auto &thread_latencies : latencies) {
+    all.insert(all.end(), thread_latencies.begin(), thread_latencies.end());
+  }
+  EXPECT_FALSE(all.empty());
+  std::sort(all.begin(), all.end());
+  double p99 = all.empty() ? 0 : all[all.size() * 99 / 100];
+
+  delete test_table;
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  return p99;
+}
+
+// NOLINTNEXTLINE
+TEST(CheckpointManagerTest, LatencyTest) {
+  double max_checkpoint_us;
+  double p99 = CheckpointLatencyP99(CheckpointMode::NONE, &max_checkpoint_us);
+  LOG_INFO("no checkpoints:       p99 %8.0f us", p99);
+  p99 = CheckpointLatencyP99(CheckpointMode::BLOCKING, &max_checkpoint_us);
+  LOG_INFO("blocking checkpoints: p99 %8.0f us, longest checkpoint %8.0f us", p99, max_checkpoint_us);
+  p99 = CheckpointLatencyP99(CheckpointMode::FUZZY, &max_checkpoint_us);
+  LOG_INFO("fuzzy checkpoints:    p99 %8.0f us, longest checkpoint %8.0f us", p99, max_checkpoint_us);
+}
+
+}  // namespace bustub
@@ -0,0 +1,364 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_manager_test.cpp
+//
+// Identification: test/recovery/log_manager_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/bustub_instance.h"
+#include "common/logger.h"
+#include "gtest/gtest.h"
+#include "logging/common.h"
+#include "recovery/log_manager.h"
+#include "recovery/log_recovery.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+/**
+ * Appends records from num_threads threads, then reads the log file back and checks that every LSN appears exactly
+ * once and in increasing order, i.e. that LSN order matches log order.
+ * @param[out] stats if not null, receives the counters of the block writer
+ * @return the append throughput in records per second
+ */
+double AppendAndVerify(int num_threads, int records_per_thread, LogCompressionStats *stats = nullptr) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  auto *disk_manager = new DiskManager("test.db");
+  auto *log_manager = new LogManager(disk_manager);
+  log_manager->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&, tid] {
+      lsn_t prev_lsn = INVALID_LSN;
+      for (int i = 0; i < records_per_thread; i++) {
+        if (i % 2 == 0) {
+          LogRecord record(tid, prev_lsn, LogRecordType::BEGIN);
+          prev_lsn = log_manager->AppendLogRecord(&record);
+        } else {
+          LogRecord record(tid, prev_lsn, LogRecordType::INSERT, RID(tid, i), tuple);
+          prev_lsn = log_manager->AppendLogRecord(&record);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  lsn_t total = num_threads * records_per_thread;
+  EXPECT_EQ(total, log_manager->GetNextLSN());
+  log_manager->Flush(total - 1);
+  EXPECT_EQ(total - 1, log_manager->GetPersistentLSN());
+  log_manager->StopFlushThread();
+  if (stats != nullptr) {
+    *stats = log_manager->GetCompressionStats();
+  }
+
+  // Read the whole log back.
+  LogRecovery log_recovery(disk_manager, nullptr);
+  auto *buffer = new char[LOG_BUFFER_SIZE];
+  LogBlockHeader header;
+  lsn_t expected_lsn = 0;
+  for (int offset = 0; offset >= 0;) {
+    int next_offset = log_recovery.ReadLogBlock(offset, buffer, &header);
+    if (next_offset < 0) {
+      offset = disk_manager->GetNextLogSegmentOffset(offset);
+      continue;
+    }
+    offset = next_offset;
+    EXPECT_EQ(expected_lsn, header.first_lsn_);
+    LogRecord record;
+    for (uint32_t pos = 0; pos < header.uncompressed_size_; pos += record.GetSize()) {
+      if (!log_recovery.DeserializeLogRecord(buffer + pos, &record)) {
+        ADD_FAILURE() << "Unreadable log record at LSN " << expected_lsn;
+        break;
+      }
+      EXPECT_EQ(expected_lsn, record.GetLSN());
+      expected_lsn++;
+    }
+    EXPECT_EQ(expected_lsn - 1, header.last_lsn_);
+  }
+  EXPECT_EQ(total, expected_lsn);
+
+  delete[] buffer;
+  delete log_manager;
+  disk_manager->ShutDown();
+  delete disk_manager;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  return total / elapsed;
+}
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, SingleThreadAppendTest) { AppendAndVerify(1, 5000); }
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, ScalingAppendTest) {
+  const int records_per_thread = 2000;
+  for (int num_threads = 1; num_threads <= 64; num_threads *= 2) {
+    double throughput = AppendAndVerify(num_threads, records_per_thread);
+    LOG_INFO("%2d threads: %.0f records/s", num_threads, throughput);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, PrivateLogTest) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_TRUE(enable_private_log);
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+
+  // Scenario: inserts stay in the private buffer, so the shared log does not move until commit.
+  lsn_t next_lsn = bustub_instance->log_manager_->GetNextLSN();
+  const int num_inserts = 10;
+  RID rid;
+  for (int i = 0; i < num_inserts; i++) {
+    ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+  }
+  EXPECT_EQ(next_lsn, bustub_instance->log_manager_->GetNextLSN());
+
+  // Scenario: commit publishes the inserts and the COMMIT record in one dense range and makes them durable.
+  bustub_instance->transaction_manager_->Commit(txn);
+  EXPECT_EQ(next_lsn + num_inserts + 1, bustub_instance->log_manager_->GetNextLSN());
+  EXPECT_EQ(next_lsn + num_inserts, txn->GetPrevLSN());
+  EXPECT_LE(txn->GetPrevLSN(), bustub_instance->log_manager_->GetPersistentLSN());
+
+  // Scenario: the published records are chained through their prev LSNs.
+  LogRecovery log_recovery(bustub_instance->disk_manager_, nullptr);
+  auto *buffer = new char[LOG_BUFFER_SIZE];
+  LogBlockHeader header;
+  ASSERT_GE(log_recovery.ReadLogBlock(0, buffer, &header), 0);
+  lsn_t prev_lsn = INVALID_LSN;
+  LogRecordType last_type = LogRecordType::INVALID;
+  LogRecord record;
+  for (uint32_t pos = 0; pos < header.uncompressed_size_; pos += record.GetSize()) {
+    ASSERT_TRUE(log_recovery.DeserializeLogRecord(buffer + pos, &record));
+    EXPECT_EQ(prev_lsn, record.GetPrevLSN());
+    prev_lsn = record.GetLSN();
+    last_type = record.GetLogRecordType();
+  }
+  EXPECT_EQ(txn->GetPrevLSN(), prev_lsn);
+  EXPECT_EQ(LogRecordType::COMMIT, last_type);
+
+  delete[] buffer;
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, PrivateLogWALTest) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  lsn_t next_lsn = bustub_instance->log_manager_->GetNextLSN();
+  RID rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+  EXPECT_EQ(next_lsn, bustub_instance->log_manager_->GetNextLSN());
+
+  // Scenario: writing the page of an uncommitted transaction publishes its insert and forces it to disk first.
+  ASSERT_TRUE(bustub_instance->buffer_pool_manager_->FlushPage(rid.GetPageId()));
+  EXPECT_EQ(next_lsn, txn->GetPrevLSN());
+  EXPECT_LE(next_lsn, bustub_instance->log_manager_->GetPersistentLSN());
+
+  // Scenario: the rest of the transaction continues the chain after the published prefix.
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  EXPECT_EQ(next_lsn + 2, txn->GetPrevLSN());
+
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, PrivateLogWALConcurrentTest) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *flushed_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                      bustub_instance->log_manager_, txn);
+  auto *other_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                    bustub_instance->log_manager_, txn);
+  RID rid;
+  ASSERT_TRUE(flushed_table->InsertTuple(tuple, &rid, txn));
+
+  // Keep the page resident while the other table grows. Only the buffer pool changes its LSN from here on.
+  Page *page = bustub_instance->buffer_pool_manager_->FetchPage(rid.GetPageId());
+  ASSERT_NE(nullptr, page);
+
+  // Scenario: the writer of a page keeps logging changes to other pages while the page is written over and over.
+  // Every write leaves the page with an LSN that is durable, although the writer's last LSN may not be.
+  const int num_inserts = 5000;
+  std::atomic<int> inserts{0};
+  std::thread writer([&] {
+    RID other_rid;
+    for (; inserts < num_inserts; inserts++) {
+      EXPECT_TRUE(other_table->InsertTuple(tuple, &other_rid, txn));
+    }
+  });
+  while (inserts < num_inserts) {
+    EXPECT_TRUE(bustub_instance->buffer_pool_manager_->FlushPage(rid.GetPageId()));
+    EXPECT_LE(page->GetLSN(), bustub_instance->log_manager_->GetPersistentLSN());
+  }
+  writer.join();
+  bustub_instance->buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  bustub_instance->transaction_manager_->Commit(txn);
+
+  delete txn;
+  delete flushed_table;
+  delete other_table;
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, CompressionTest) {
+  LogCompressionStats plain;
+  LogCompressionStats compressed;
+  AppendAndVerify(4, 5000, &plain);
+  enable_log_compression = true;
+  AppendAndVerify(4, 5000, &compressed);
+  enable_log_compression = false;
+
+  // Scenario: without compression every block is stored as is.
+  EXPECT_EQ(0, plain.compressed_blocks_);
+  EXPECT_EQ(plain.raw_bytes_ + plain.blocks_ * sizeof(LogBlockHeader), plain.written_bytes_);
+
+  // Scenario: the records shrink with compression and still read back in LSN order.
+  EXPECT_EQ(compressed.blocks_, compressed.compressed_blocks_);
+  EXPECT_LT(compressed.written_bytes_, compressed.raw_bytes_);
+  LOG_INFO("%lu blocks, %lu -> %lu bytes, ratio %.2f, %.1f ns per input byte", compressed.blocks_,
+           compressed.raw_bytes_, compressed.written_bytes_,
+           static_cast<double>(compressed.raw_bytes_) / compressed.written_bytes_,
+           static_cast<double>(compressed.compress_ns_) / compressed.raw_bytes_);
+}
+
+/**
+ * Inserts wide rows, then updates a single column of them over and over in one transaction.
+ * @param[out] seconds the time the updates took, including the commit
+ * @return the number of log bytes written for the updates
+ */
+int WideRowUpdateLogBytes(int num_rows, int num_updates, double *seconds) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  const uint32_t num_columns = 32;
+  std::vector<Column> cols;
+  for (uint32_t i = 0; i < num_columns; i++) {
+    cols.emplace_back("c" + std::to_string(i), TypeId::BIGINT);
+  }
+  Schema schema{cols};
+  std::vector<Value> values;
+  for (uint32_t i = 0; i < num_columns; i++) {
+    values.emplace_back(ValueFactory::GetBigIntValue(i));
+  }
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  std::vector<RID> rids(num_rows);
+  for (auto &rid : rids) {
+    EXPECT_TRUE(test_table->InsertTuple(Tuple(values, &schema), &rid, txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  uint64_t log_size = bustub_instance->log_manager_->GetCompressionStats().written_bytes_;
+
+  auto start = std::chrono::steady_clock::now();
+  txn = bustub_instance->transaction_manager_->Begin();
+  for (int i = 0; i < num_updates; i++) {
+    values[0] = ValueFactory::GetBigIntValue(i);
+    EXPECT_TRUE(test_table->UpdateTuple(Tuple(values, &schema), rids[i % num_rows], txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  log_size = bustub_instance->log_manager_->GetCompressionStats().written_bytes_ - log_size;
+
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  return static_cast<int>(log_size);
+}
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, DeltaUpdateLogSizeTest) {
+  const int num_rows = 10;
+  const int num_updates = 5000;
+  double full_seconds;
+  double delta_seconds;
+  enable_delta_update = false;
+  int full_bytes = WideRowUpdateLogBytes(num_rows, num_updates, &full_seconds);
+  enable_delta_update = true;
+  int delta_bytes = WideRowUpdateLogBytes(num_rows, num_updates, &delta_seconds);
+
+  LOG_INFO("full images: %d log bytes, %.3f s", full_bytes, full_seconds);
+  LOG_INFO("deltas:      %d log bytes, %.3f s", delta_bytes, delta_seconds);
+  // One changed 8-byte column out of 256 bytes should shrink the log several times over.
+  EXPECT_LT(delta_bytes * 4, full_bytes);
+}
+
+}  // namespace bustub
@@ -0,0 +1,329 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_standby_test.cpp
+//
+// Identification: test/recovery/log_standby_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/bustub_instance.h"
+#include "common/logger.h"
+#include "gtest/gtest.h"
+#include "recovery/log_standby.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+static const int NUM_STANDBY_ROWS = 8;
+
+/**
+ * Runs the primary: creates a table of NUM_STANDBY_ROWS rows and sends its first page id and RIDs over fd, then sets
+ * every row to i in transaction i for num_txns transactions and sends the LSN of the last commit.
+ * @return the exit status of the primary process
+ */
+int RunPrimary(const std::string &db_file, int num_txns, int fd) {
+  auto *bustub_instance = new BustubInstance(db_file);
+  bustub_instance->log_manager_->RunFlushThread();
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_, bustub_instance->log_manager_,
+                  txn);
+  std::vector<RID> rids(NUM_STANDBY_ROWS);
+  for (auto &rid : rids) {
+    if (!table.InsertTuple(Tuple({ValueFactory::GetIntegerValue(-1)}, &schema), &rid, txn)) {
+      return 1;
+    }
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  page_id_t first_page_id = table.GetFirstPageId();
+  if (write(fd, &first_page_id, sizeof(page_id_t)) != sizeof(page_id_t) ||
+      write(fd, rids.data(), rids.size() * sizeof(RID)) != static_cast<ssize_t>(rids.size() * sizeof(RID))) {
+    return 1;
+  }
+
+  lsn_t last_lsn = INVALID_LSN;
+  for (int i = 0; i < num_txns; i++) {
+    txn = bustub_instance->transaction_manager_->Begin();
+    for (const auto &rid : rids) {
+      if (!table.UpdateTuple(Tuple({ValueFactory::GetIntegerValue(i)}, &schema), rid, txn)) {
+        return 1;
+      }
+    }
+    bustub_instance->transaction_manager_->Commit(txn);
+    last_lsn = txn->GetPrevLSN();
+    delete txn;
+  }
+  if (write(fd, &last_lsn, sizeof(lsn_t)) != sizeof(lsn_t)) {
+    return 1;
+  }
+  delete bustub_instance;
+  return 0;
+}
+
+// NOLINTNEXTLINE
+TEST(LogStandbyTest, ReplicationTest) {
+  const int num_txns = 2000;
+  char dir_template[] = "/tmp/bustub_standby_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir_template));
+  std::string dir(dir_template);
+  std::string primary_db = dir + "/primary.db";
+  std::string standby_db = dir + "/standby.db";
+
+  // The primary runs in its own process, which writes the log that the standby follows through the shared directory.
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  pid_t pid = fork();
+  ASSERT_LE(0, pid);
+  if (pid == 0) {
+    close(fds[0]);
+    _exit(RunPrimary(primary_db, num_txns, fds[1]));
+  }
+  close(fds[1]);
+
+  page_id_t first_page_id;
+  std::vector<RID> rids(NUM_STANDBY_ROWS);
+  ASSERT_EQ(sizeof(page_id_t), read(fds[0], &first_page_id, sizeof(page_id_t)));
+  ASSERT_EQ(rids.size() * sizeof(RID), read(fds[0], rids.data(), rids.size() * sizeof(RID)));
+
+  auto *bustub_instance = new BustubInstance(standby_db);
+  auto *standby = new LogStandby(primary_db, bustub_instance->buffer_pool_manager_);
+  standby->Start(std::chrono::milliseconds(1));
+
+  // Scenario: while the primary runs, every read sees the rows of one committed transaction, and never goes back.
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_, bustub_instance->log_manager_,
+                  first_page_id);
+  auto read_rows = [&](lsn_t *replay_lsn) {
+    std::vector<int> values;
+    Transaction *txn = bustub_instance->transaction_manager_->Begin();
+    *replay_lsn = standby->BeginRead();
+    for (const auto &rid : rids) {
+      Tuple tuple;
+      values.push_back(table.GetTuple(rid, &tuple, txn) ? tuple.GetValue(&schema, 0).GetAs<int32_t>() : -2);
+    }
+    standby->EndRead();
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+    return values;
+  };
+  int last_value = -2;
+  int reads = 0;
+  lsn_t last_lsn = INVALID_LSN;
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  for (;;) {
+    ssize_t n = read(fds[0], &last_lsn, sizeof(lsn_t));
+    if (n >= 0) {
+      // The LSN of the last commit, or the end of the pipe if the primary failed.
+      break;
+    }
+    lsn_t replay_lsn;
+    std::vector<int> values = read_rows(&replay_lsn);
+    if (replay_lsn != INVALID_LSN && values[0] != -2) {
+      EXPECT_EQ(std::vector<int>(NUM_STANDBY_ROWS, values[0]), values);
+      EXPECT_LE(last_value, values[0]);
+      last_value = values[0];
+      reads++;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  // Scenario: the standby catches up with the last commit of the primary.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (standby->GetStats().replay_lsn_ < last_lsn && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  lsn_t replay_lsn;
+  EXPECT_EQ(std::vector<int>(NUM_STANDBY_ROWS, num_txns - 1), read_rows(&replay_lsn));
+  EXPECT_LE(last_lsn, replay_lsn);
+
+  ReplicationStats stats = standby->GetStats();
+  EXPECT_EQ(stats.received_lsn_, stats.replay_lsn_);
+  EXPECT_EQ(0U, stats.replay_lag_ns_);
+  LOG_INFO("%d consistent reads during replay; %lu blocks, %lu records replayed, max lag %.2f ms", reads,
+           stats.replayed_blocks_, stats.replayed_records_, static_cast<double>(stats.max_replay_lag_ns_) / 1e6);
+
+  delete standby;
+  delete bustub_instance;
+  close(fds[0]);
+  std::filesystem::remove_all(dir);
+}
+
+/** Read a value that the other process sends over fd. */
+template <typename T>
+bool ReadMessage(int fd, T *value) {
+  return read(fd, value, sizeof(T)) == sizeof(T);
+}
+
+/** Send value over fd. */
+template <typename T>
+bool WriteMessage(int fd, const T &value) {
+  return write(fd, &value, sizeof(T)) == sizeof(T);
+}
+
+/**
+ * Runs a primary whose transactions have their records forced into the log before they end: creates a table of
+ * NUM_STANDBY_ROWS rows of -1, then in one transaction that aborts and one that commits, sets every row and writes
+ * the page back. After each page write it sends the persistent LSN over out_fd and waits for a byte on in_fd. Last it
+ * sends the LSN of the commit.
+ * @return the exit status of the primary process
+ */
+int RunEarlyPublishPrimary(const std::string &db_file, int in_fd, int out_fd) {
+  auto *bustub_instance = new BustubInstance(db_file);
+  bustub_instance->log_manager_->RunFlushThread();
+  auto *txn_mgr = bustub_instance->transaction_manager_;
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  Transaction *txn = txn_mgr->Begin();
+  TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_, bustub_instance->log_manager_,
+                  txn);
+  std::vector<RID> rids(NUM_STANDBY_ROWS);
+  for (auto &rid : rids) {
+    if (!table.InsertTuple(Tuple({ValueFactory::GetIntegerValue(-1)}, &schema), &rid, txn)) {
+      return 1;
+    }
+  }
+  txn_mgr->Commit(txn);
+  delete txn;
+  if (!WriteMessage(out_fd, table.GetFirstPageId())) {
+    return 1;
+  }
+  for (const auto &rid : rids) {
+    if (!WriteMessage(out_fd, rid)) {
+      return 1;
+    }
+  }
+
+  lsn_t commit_lsn = INVALID_LSN;
+  for (int value : {1, 2}) {
+    txn = txn_mgr->Begin();
+    for (const auto &rid : rids) {
+      if (!table.UpdateTuple(Tuple({ValueFactory::GetIntegerValue(value)}, &schema), rid, txn)) {
+        return 1;
+      }
+    }
+    // The write-ahead rule publishes the private log buffer of the transaction and flushes it.
+    char go;
+    if (!bustub_instance->buffer_pool_manager_->FlushPage(table.GetFirstPageId()) ||
+        !WriteMessage(out_fd, bustub_instance->log_manager_->GetPersistentLSN()) || !ReadMessage(in_fd, &go)) {
+      return 1;
+    }
+    if (value == 1) {
+      txn_mgr->Abort(txn);
+    } else {
+      txn_mgr->Commit(txn);
+      commit_lsn = txn->GetPrevLSN();
+    }
+    delete txn;
+  }
+  if (!WriteMessage(out_fd, commit_lsn)) {
+    return 1;
+  }
+  delete bustub_instance;
+  return 0;
+}
+
+// NOLINTNEXTLINE
+TEST(LogStandbyTest, EarlyPublishTest) {
+  char dir_template[] = "/tmp/bustub_standby_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir_template));
+  std::string dir(dir_template);
+  std::string primary_db = dir + "/primary.db";
+  std::string standby_db = dir + "/standby.db";
+
+  int to_primary[2];
+  int from_primary[2];
+  ASSERT_EQ(0, pipe(to_primary));
+  ASSERT_EQ(0, pipe(from_primary));
+  pid_t pid = fork();
+  ASSERT_LE(0, pid);
+  if (pid == 0) {
+    close(to_primary[1]);
+    close(from_primary[0]);
+    _exit(RunEarlyPublishPrimary(primary_db, to_primary[0], from_primary[1]));
+  }
+  close(to_primary[0]);
+  close(from_primary[1]);
+
+  page_id_t first_page_id;
+  std::vector<RID> rids(NUM_STANDBY_ROWS);
+  ASSERT_TRUE(ReadMessage(from_primary[0], &first_page_id));
+  for (auto &rid : rids) {
+    ASSERT_TRUE(ReadMessage(from_primary[0], &rid));
+  }
+
+  // The standby is polled by hand, so that it has replayed everything in the log when the rows are read.
+  auto *bustub_instance = new BustubInstance(standby_db);
+  auto *standby = new LogStandby(primary_db, bustub_instance->buffer_pool_manager_);
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_, bustub_instance->log_manager_,
+                  first_page_id);
+  auto read_rows = [&](lsn_t durable_lsn, lsn_t *replay_lsn) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (standby->GetStats().received_lsn_ < durable_lsn && std::chrono::steady_clock::now() < deadline) {
+      standby->Poll();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    standby->Poll();
+    std::vector<int> values;
+    Transaction *txn = bustub_instance->transaction_manager_->Begin();
+    *replay_lsn = standby->BeginRead();
+    for (const auto &rid : rids) {
+      Tuple tuple;
+      values.push_back(table.GetTuple(rid, &tuple, txn) ? tuple.GetValue(&schema, 0).GetAs<int32_t>() : -2);
+    }
+    standby->EndRead();
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+    return values;
+  };
+
+  // Scenario: the records of a running transaction are in the log, but neither its changes nor their LSNs show on
+  // the standby. Once it aborts, its rollback does not show either.
+  lsn_t durable_lsn;
+  lsn_t replay_lsn;
+  ASSERT_TRUE(ReadMessage(from_primary[0], &durable_lsn));
+  EXPECT_EQ(std::vector<int>(NUM_STANDBY_ROWS, -1), read_rows(durable_lsn, &replay_lsn));
+  EXPECT_LT(replay_lsn, durable_lsn);
+  EXPECT_EQ(durable_lsn, standby->GetStats().received_lsn_);
+  ASSERT_TRUE(WriteMessage(to_primary[1], 'g'));
+
+  // Scenario: the same for a transaction that goes on to commit, which shows as a whole afterwards.
+  ASSERT_TRUE(ReadMessage(from_primary[0], &durable_lsn));
+  EXPECT_EQ(std::vector<int>(NUM_STANDBY_ROWS, -1), read_rows(durable_lsn, &replay_lsn));
+  EXPECT_LT(replay_lsn, durable_lsn);
+  ASSERT_TRUE(WriteMessage(to_primary[1], 'g'));
+  lsn_t commit_lsn;
+  ASSERT_TRUE(ReadMessage(from_primary[0], &commit_lsn));
+  EXPECT_EQ(std::vector<int>(NUM_STANDBY_ROWS, 2), read_rows(commit_lsn, &replay_lsn));
+  EXPECT_EQ(commit_lsn, replay_lsn);
+
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  delete standby;
+  delete bustub_instance;
+  close(to_primary[1]);
+  close(from_primary[0]);
+  std::filesystem::remove_all(dir);
+}
+
+}  // namespace bustub
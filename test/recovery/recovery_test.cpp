@@ -10,7 +10,12 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstring>
 #include <string>
+#include <thread>  // NOLINT
+#include <utility>
 #include <vector>
 
 #include "common/bustub_instance.h"
@@ -20,16 +25,18 @@
 #include "gtest/gtest.h"
 #include "logging/common.h"
 #include "recovery/log_recovery.h"
+#include "storage/page/b_plus_tree_leaf_page.h"
 #include "storage/table/table_heap.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 
 // NOLINTNEXTLINE
-TEST(RecoveryTest, DISABLED_RedoTest) {
+TEST(RecoveryTest, RedoTest) {
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
@@ -88,7 +95,8 @@ TEST(RecoveryTest, DISABLED_RedoTest) {
   delete txn;
 
   LOG_INFO("Begin recovery");
-  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
 
   ASSERT_FALSE(enable_logging);
 
@@ -118,13 +126,13 @@ TEST(RecoveryTest, DISABLED_RedoTest) {
   delete bustub_instance;
   LOG_INFO("Tearing down the system..");
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 
 // NOLINTNEXTLINE
-TEST(RecoveryTest, DISABLED_UndoTest) {
+TEST(RecoveryTest, UndoTest) {
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -177,7 +185,8 @@ TEST(RecoveryTest, DISABLED_UndoTest) {
   delete txn;
 
   LOG_INFO("Recovery started..");
-  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_);
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
 
   ASSERT_FALSE(enable_logging);
 
@@ -202,13 +211,174 @@ TEST(RecoveryTest, DISABLED_UndoTest) {
   delete bustub_instance;
   LOG_INFO("Tearing down the system..");
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 
 // NOLINTNEXTLINE
-TEST(RecoveryTest, DISABLED_CheckpointTest) {
+TEST(RecoveryTest, DeltaUpdateTest) {
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  ASSERT_TRUE(enable_delta_update);
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+  const Tuple tuple1 = ConstructTuple(&schema);
+  const Tuple new_tuple = ConstructTuple(&schema);
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  RID rid;
+  RID rid1;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+  ASSERT_TRUE(test_table->InsertTuple(tuple1, &rid1, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  LOG_INFO("Committed update that never reaches the table file");
+  txn = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(test_table->UpdateTuple(new_tuple, rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  LOG_INFO("Uncommitted update that is written to the table file");
+  txn = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(test_table->UpdateTuple(new_tuple, rid1, txn));
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  delete txn;
+  delete test_table;
+
+  LOG_INFO("System crash");
+  delete bustub_instance;
+  bustub_instance = new BustubInstance("test.db");
+
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple result;
+  Tuple result1;
+  ASSERT_TRUE(test_table->GetTuple(rid, &result, txn));
+  ASSERT_TRUE(test_table->GetTuple(rid1, &result1, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+
+  // Scenario: redo applied the committed delta, undo reverted the uncommitted one.
+  ASSERT_EQ(new_tuple.GetLength(), result.GetLength());
+  EXPECT_EQ(0, memcmp(new_tuple.GetData(), result.GetData(), new_tuple.GetLength()));
+  ASSERT_EQ(tuple1.GetLength(), result1.GetLength());
+  EXPECT_EQ(0, memcmp(tuple1.GetData(), result1.GetData(), tuple1.GetLength()));
+
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(RecoveryTest, DoubleCrashTest) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+  const Tuple tuple1 = ConstructTuple(&schema);
+  const Tuple tuple2 = ConstructTuple(&schema);
+  const Tuple tuple3 = ConstructTuple(&schema);
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  RID rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  LOG_INFO("Uncommitted update and insert that are written to the table file");
+  txn = bustub_instance->transaction_manager_->Begin();
+  RID rid1;
+  ASSERT_TRUE(test_table->UpdateTuple(tuple1, rid, txn));
+  ASSERT_TRUE(test_table->InsertTuple(tuple1, &rid1, txn));
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  delete txn;
+  delete test_table;
+
+  LOG_INFO("System crash");
+  delete bustub_instance;
+  bustub_instance = new BustubInstance("test.db");
+  auto *log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                       bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+  bustub_instance->log_manager_->RunFlushThread();
+
+  LOG_INFO("Committed update of the row and insert into the slot that undo freed");
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  RID rid2;
+  ASSERT_TRUE(test_table->UpdateTuple(tuple2, rid, txn));
+  ASSERT_TRUE(test_table->InsertTuple(tuple3, &rid2, txn));
+  ASSERT_EQ(rid1, rid2);
+  bustub_instance->transaction_manager_->Commit(txn);
+  bustub_instance->buffer_pool_manager_->FlushPage(first_page_id);
+  delete txn;
+  delete test_table;
+
+  LOG_INFO("System crash again");
+  delete bustub_instance;
+  bustub_instance = new BustubInstance("test.db");
+  log_recovery = new LogRecovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                                 bustub_instance->log_manager_);
+  log_recovery->Redo();
+  log_recovery->Undo();
+  delete log_recovery;
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple result;
+  Tuple result2;
+  ASSERT_TRUE(test_table->GetTuple(rid, &result, txn));
+  ASSERT_TRUE(test_table->GetTuple(rid2, &result2, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+
+  // Scenario: the loser was rolled back once. Undoing it again would flip the delta of the row back and delete the
+  // tuple that reused its slot.
+  ASSERT_EQ(tuple2.GetLength(), result.GetLength());
+  EXPECT_EQ(0, memcmp(tuple2.GetData(), result.GetData(), tuple2.GetLength()));
+  ASSERT_EQ(tuple3.GetLength(), result2.GetLength());
+  EXPECT_EQ(0, memcmp(tuple3.GetData(), result2.GetData(), tuple3.GetLength()));
+
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(RecoveryTest, CheckpointTest) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   EXPECT_FALSE(enable_logging);
@@ -312,6 +482,625 @@ TEST(RecoveryTest, DISABLED_CheckpointTest) {
 
   LOG_INFO("Tearing down the system..");
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
+}
+// NOLINTNEXTLINE
+TEST(RecoveryTest, CheckpointTruncateTest) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  page_id_t first_page_id = test_table->GetFirstPageId();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  // Scenario: fill a few log segments with committed updates, then checkpoint.
+  const Tuple tuple1 = ConstructTuple(&schema);
+  RID old_rid;
+  txn = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &old_rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  while (bustub_instance->disk_manager_->GetNumLogSegments() < 3) {
+    txn = bustub_instance->transaction_manager_->Begin();
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_TRUE(test_table->UpdateTuple(i % 2 == 0 ? tuple1 : tuple, old_rid, txn));
+    }
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+  }
+  bustub_instance->checkpoint_manager_->BeginCheckpoint();
+  bustub_instance->checkpoint_manager_->EndCheckpoint();
+  EXPECT_EQ(1U, bustub_instance->disk_manager_->GetNumLogSegments());
+  EXPECT_LT(0U, bustub_instance->disk_manager_->GetNumSpareLogSegments());
+
+  // Scenario: an insert after the checkpoint only survives the crash through the log.
+  txn = bustub_instance->transaction_manager_->Begin();
+  RID new_rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &new_rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  lsn_t next_lsn = bustub_instance->log_manager_->GetNextLSN();
+  delete test_table;
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  EXPECT_EQ(next_lsn, bustub_instance->log_manager_->GetNextLSN());
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple result;
+  txn = bustub_instance->transaction_manager_->Begin();
+  EXPECT_TRUE(test_table->GetTuple(old_rid, &result, txn));
+  EXPECT_FALSE(test_table->GetTuple(new_rid, &result, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                           bustub_instance->log_manager_);
+  log_recovery.Redo();
+  log_recovery.Undo();
+
+  txn = bustub_instance->transaction_manager_->Begin();
+  EXPECT_TRUE(test_table->GetTuple(old_rid, &result, txn));
+  EXPECT_TRUE(test_table->GetTuple(new_rid, &result, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  delete test_table;
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+// NOLINTNEXTLINE
+TEST(RecoveryTest, FuzzyCheckpointTest) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  RID committed_rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &committed_rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // Scenario: a transaction that is still running when the checkpoint is taken, with records in the shared log.
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  RID loser_rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &loser_rid, loser));
+  lsn_t loser_lsn = bustub_instance->log_manager_->PublishPrivateLog(loser);
+
+  bustub_instance->checkpoint_manager_->FuzzyCheckpoint();
+  EXPECT_EQ(1U, bustub_instance->checkpoint_manager_->GetStats().checkpoints_);
+  // Recovery starts at the checkpoint, but the log of the running transaction must survive truncation.
+  EXPECT_LT(loser_lsn, bustub_instance->disk_manager_->ReadMasterRecord());
+  int first_offset = bustub_instance->disk_manager_->GetLogSegmentOffset(0);
+  EXPECT_LE(bustub_instance->disk_manager_->GetLogSegmentLSN(first_offset), loser_lsn);
+
+  // Scenario: the END_CHECKPOINT record lists the running transaction with its last LSN.
+  LogRecovery reader(bustub_instance->disk_manager_, nullptr);
+  auto *buffer = new char[LOG_BUFFER_SIZE];
+  LogBlockHeader header;
+  LogRecord record;
+  bool found = false;
+  for (int offset = bustub_instance->disk_manager_->GetLogSegmentOffset(0); offset >= 0;) {
+    int next_offset = reader.ReadLogBlock(offset, buffer, &header);
+    if (next_offset < 0) {
+      offset = bustub_instance->disk_manager_->GetNextLogSegmentOffset(offset);
+      continue;
+    }
+    for (uint32_t pos = 0; pos < header.uncompressed_size_; pos += record.GetSize()) {
+      ASSERT_TRUE(reader.DeserializeLogRecord(buffer + pos, &record));
+      if (record.GetLogRecordType() == LogRecordType::END_CHECKPOINT) {
+        found = true;
+        std::vector<ActiveTxnEntry> expected{{loser->GetTransactionId(), loser_lsn}};
+        EXPECT_EQ(expected, record.GetActiveTxns());
+      }
+    }
+    offset = next_offset;
+  }
+  EXPECT_TRUE(found);
+  delete[] buffer;
+
+  // Scenario: a transaction that commits after the checkpoint, then a crash.
+  txn = bustub_instance->transaction_manager_->Begin();
+  RID late_rid;
+  ASSERT_TRUE(test_table->InsertTuple(tuple, &late_rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                           bustub_instance->log_manager_);
+  log_recovery.Redo();
+  log_recovery.Undo();
+
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  Tuple result;
+  txn = bustub_instance->transaction_manager_->Begin();
+  EXPECT_TRUE(test_table->GetTuple(committed_rid, &result, txn));
+  EXPECT_TRUE(test_table->GetTuple(late_rid, &result, txn));
+  EXPECT_FALSE(test_table->GetTuple(loser_rid, &result, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  delete loser;
+  delete test_table;
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+// NOLINTNEXTLINE
+TEST(RecoveryTest, AnalysisTest) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  BustubInstance *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  const Tuple tuple = ConstructTuple(&schema);
+  const Tuple tuple1 = ConstructTuple(&schema);
+
+  // Two tables, so that the rows live on different pages.
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  auto *pinned_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                     bustub_instance->log_manager_, txn);
+  auto *busy_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  RID pinned_rid;
+  RID busy_rid;
+  ASSERT_TRUE(pinned_table->InsertTuple(tuple, &pinned_rid, txn));
+  ASSERT_TRUE(busy_table->InsertTuple(tuple, &busy_rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // Scenario: a checkpoint whose dirty page table lists a page with an old recLSN, as for a page that is changed
+  // again while the checkpoint runs. The log in between mostly changes another page, which is on disk.
+  page_id_t pinned_page_id = pinned_table->GetFirstPageId();
+  page_id_t busy_page_id = busy_table->GetFirstPageId();
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+  lsn_t rec_lsn = bustub_instance->log_manager_->GetNextLSN();
+  txn = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(pinned_table->UpdateTuple(tuple1, pinned_rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  const int num_updates = 200;
+  for (int i = 0; i < num_updates; i++) {
+    txn = bustub_instance->transaction_manager_->Begin();
+    ASSERT_TRUE(busy_table->UpdateTuple(i % 2 == 0 ? tuple1 : tuple, busy_rid, txn));
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+  }
+  bustub_instance->buffer_pool_manager_->FlushPage(busy_page_id);
+  std::vector<ActiveTxnEntry> active_txns;
+  lsn_t oldest_lsn;
+  lsn_t checkpoint_lsn = bustub_instance->log_manager_->AppendBeginCheckpoint(&active_txns, &oldest_lsn);
+  EXPECT_TRUE(active_txns.empty());
+  LogRecord end_record(std::move(active_txns), std::vector<DirtyPageEntry>{{pinned_page_id, rec_lsn}});
+  bustub_instance->log_manager_->Flush(bustub_instance->log_manager_->AppendLogRecord(&end_record));
+  bustub_instance->log_manager_->TruncateLog(std::min(oldest_lsn, rec_lsn), checkpoint_lsn);
+
+  // Scenario: a committed change and a loser after the checkpoint, then a crash.
+  txn = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(pinned_table->UpdateTuple(tuple, pinned_rid, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  RID loser_rid;
+  ASSERT_TRUE(pinned_table->InsertTuple(tuple, &loser_rid, loser));
+  bustub_instance->log_manager_->Flush(bustub_instance->log_manager_->PublishPrivateLog(loser));
+  delete pinned_table;
+  delete busy_table;
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                           bustub_instance->log_manager_);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  RecoveryStats stats = log_recovery.GetStats();
+  LOG_INFO("analyzed %lu, redo read %lu, skipped %lu, redone %lu, undone %lu", stats.analyzed_records_,
+           stats.redo_records_, stats.skipped_records_, stats.redone_records_, stats.undone_records_);
+  // Analysis only reads the log from the checkpoint on, and redo skips the updates of the busy page by the dirty page
+  // table alone. The two updates and the insert on the other page are redone.
+  EXPECT_GT(20U, stats.analyzed_records_);
+  EXPECT_LE(static_cast<uint64_t>(num_updates), stats.skipped_records_);
+  EXPECT_EQ(3U, stats.redone_records_);
+  EXPECT_EQ(1U, stats.undone_records_);
+
+  pinned_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                               bustub_instance->log_manager_, pinned_page_id);
+  busy_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, busy_page_id);
+  Tuple result;
+  txn = bustub_instance->transaction_manager_->Begin();
+  ASSERT_TRUE(pinned_table->GetTuple(pinned_rid, &result, txn));
+  EXPECT_EQ(tuple.GetValue(&schema, 0).CompareEquals(result.GetValue(&schema, 0)), CmpBool::CmpTrue);
+  ASSERT_TRUE(busy_table->GetTuple(busy_rid, &result, txn));
+  const Tuple &busy_tuple = num_updates % 2 == 0 ? tuple : tuple1;
+  EXPECT_EQ(busy_tuple.GetValue(&schema, 0).CompareEquals(result.GetValue(&schema, 0)), CmpBool::CmpTrue);
+  EXPECT_FALSE(pinned_table->GetTuple(loser_rid, &result, txn));
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  delete loser;
+  delete pinned_table;
+  delete busy_table;
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+/** Number of tables of CrashAfterUpdates(), twice as many as the buffer pool holds. */
+static const int NUM_CRASH_TABLES = 2 * BUFFER_POOL_SIZE;
+
+/** Commit num_updates updates, each to the single row of the next of NUM_CRASH_TABLES tables in turn, then crash. */
+void CrashAfterUpdates(int num_updates, std::vector<page_id_t> *first_page_ids, std::vector<RID> *rids) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  first_page_ids->clear();
+  rids->resize(NUM_CRASH_TABLES);
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  for (int t = 0; t < NUM_CRASH_TABLES; t++) {
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, txn);
+    EXPECT_TRUE(table.InsertTuple(Tuple({ValueFactory::GetIntegerValue(-1)}, &schema), &(*rids)[t], txn));
+    first_page_ids->push_back(table.GetFirstPageId());
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  for (int i = 0; i < num_updates; i++) {
+    int t = i % NUM_CRASH_TABLES;
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, (*first_page_ids)[t]);
+    txn = bustub_instance->transaction_manager_->Begin();
+    EXPECT_TRUE(table.UpdateTuple(Tuple({ValueFactory::GetIntegerValue(i)}, &schema), (*rids)[t], txn));
+    bustub_instance->transaction_manager_->Commit(txn);
+    delete txn;
+  }
+  delete bustub_instance;
+}
+
+/** Check that every table of CrashAfterUpdates() holds the last value committed to it. */
+void CheckLastValues(BustubInstance *bustub_instance, int num_updates, const std::vector<page_id_t> &first_page_ids,
+                     const std::vector<RID> &rids) {
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  for (int t = 0; t < NUM_CRASH_TABLES; t++) {
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, first_page_ids[t]);
+    Tuple result;
+    EXPECT_TRUE(table.GetTuple(rids[t], &result, txn));
+    EXPECT_EQ(num_updates - NUM_CRASH_TABLES + t, result.GetValue(&schema, 0).GetAs<int32_t>());
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+}
+
+// NOLINTNEXTLINE
+TEST(RecoveryTest, ParallelRedoTest) {
+  const int num_updates = 3000;
+  std::vector<page_id_t> first_page_ids;
+  std::vector<RID> rids;
+  for (int num_threads : {1, 4}) {
+    CrashAfterUpdates(num_updates, &first_page_ids, &rids);
+    auto *bustub_instance = new BustubInstance("test.db");
+    redo_threads = num_threads;
+    LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                             bustub_instance->log_manager_);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    redo_threads = 1;
+    CheckLastValues(bustub_instance, num_updates, first_page_ids, rids);
+
+    RecoveryStats stats = log_recovery.GetStats();
+    EXPECT_LT(0U, stats.redone_records_);
+    double seconds = static_cast<double>(stats.redo_ns_) / 1e9;
+    LOG_INFO("%d redo threads: %lu records in %.1f ms, %.0f records/s", num_threads, stats.redo_records_,
+             seconds * 1e3, stats.redo_records_ / seconds);
+    delete bustub_instance;
+  }
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+
+// NOLINTNEXTLINE
+TEST(RecoveryTest, RedoOnDemandTest) {
+  const int num_updates = 3000;
+  std::vector<page_id_t> first_page_ids;
+  std::vector<RID> rids;
+  CrashAfterUpdates(num_updates, &first_page_ids, &rids);
+  auto *bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                           bustub_instance->log_manager_);
+  auto start = std::chrono::steady_clock::now();
+  log_recovery.StartRedoOnDemand();
+  double open_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  log_recovery.Undo();
+
+  // Scenario: reads right after the restart find every committed change, whether the page is redone by the read or
+  // by the background thread. A checkpoint in the meantime must not lose the pages that are not redone yet.
+  std::vector<DirtyPageEntry> dirty_pages = bustub_instance->buffer_pool_manager_->GetDirtyPageTable();
+  EXPECT_FALSE(dirty_pages.empty());
+  CheckLastValues(bustub_instance, num_updates, first_page_ids, rids);
+  log_recovery.FinishRedoOnDemand();
+  RecoveryStats stats = log_recovery.GetStats();
+  EXPECT_LT(0U, stats.redone_records_);
+  LOG_INFO("open after %.1f ms, redo done after %.1f ms", open_ms, static_cast<double>(stats.redo_ns_) / 1e6);
+
+  // Scenario: once the background thread is done, no page waits for redo outside of the buffer pool.
+  EXPECT_GE(bustub_instance->buffer_pool_manager_->GetPoolSize(),
+            bustub_instance->buffer_pool_manager_->GetDirtyPageTable().size());
+  CheckLastValues(bustub_instance, num_updates, first_page_ids, rids);
+
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+
+/** Update the rows of tables t1 and t2 to value in one transaction and commit it. */
+void UpdatePair(BustubInstance *bustub_instance, const std::vector<page_id_t> &first_page_ids,
+                const std::vector<RID> &rids, int t1, int t2, int value) {
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  for (int t : {t1, t2}) {
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, first_page_ids[t]);
+    EXPECT_TRUE(table.UpdateTuple(Tuple({ValueFactory::GetIntegerValue(value)}, &schema), rids[t], txn));
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+}
+
+// NOLINTNEXTLINE
+TEST(RecoveryTest, AsyncCommitTest) {
+  const int num_txns = 200;
+  const auto saved_log_timeout = log_timeout;
+  log_timeout = std::chrono::milliseconds(100);
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  std::vector<page_id_t> first_page_ids;
+  std::vector<RID> rids(NUM_CRASH_TABLES);
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  for (int t = 0; t < NUM_CRASH_TABLES; t++) {
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, txn);
+    EXPECT_TRUE(table.InsertTuple(Tuple({ValueFactory::GetIntegerValue(-1)}, &schema), &rids[t], txn));
+    first_page_ids.push_back(table.GetFirstPageId());
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // Scenario: an asynchronous commit returns without waiting for the disk, but is durable within log_timeout.
+  txn = bustub_instance->transaction_manager_->Begin();
+  txn->SetAsyncCommit(true);
+  TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_, bustub_instance->log_manager_,
+                  first_page_ids[0]);
+  EXPECT_TRUE(table.UpdateTuple(Tuple({ValueFactory::GetIntegerValue(0)}, &schema), rids[0], txn));
+  auto start = std::chrono::steady_clock::now();
+  bustub_instance->transaction_manager_->Commit(txn);
+  lsn_t commit_lsn = txn->GetPrevLSN();
+  delete txn;
+  while (bustub_instance->log_manager_->GetPersistentLSN() < commit_lsn &&
+         std::chrono::steady_clock::now() - start < 10 * log_timeout) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto durable_after = std::chrono::steady_clock::now() - start;
+  EXPECT_LE(commit_lsn, bustub_instance->log_manager_->GetPersistentLSN());
+  EXPECT_GT(log_timeout + std::chrono::milliseconds(500), durable_after);
+
+  // Scenario: commit latency of both modes, with the flush thread running.
+  for (bool async_commit : {false, true}) {
+    enable_async_commit = async_commit;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_txns; i++) {
+      UpdatePair(bustub_instance, first_page_ids, rids, 0, 1, i);
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("%s commit: %.1f us per transaction", async_commit ? "async" : "sync ", us / num_txns);
+  }
+  delete bustub_instance;
+
+  // Scenario: crash with asynchronous commits in the log buffer. Without a flush thread, only the evictions of dirty
+  // pages write the log, so the crash loses a tail of the committed transactions. Each transaction updates two
+  // tables; recovery must leave the state of some prefix of the transactions, never half of one.
+  bustub_instance = new BustubInstance("test.db");
+  {
+    LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                             bustub_instance->log_manager_);
+    log_recovery.Redo();
+    log_recovery.Undo();
+  }
+  enable_logging = true;
+  enable_async_commit = true;
+  for (int i = 0; i < num_txns; i++) {
+    UpdatePair(bustub_instance, first_page_ids, rids, i % NUM_CRASH_TABLES, (i + 7) % NUM_CRASH_TABLES, i);
+  }
+  enable_async_commit = false;
+  enable_logging = false;
+  delete bustub_instance;
+
+  bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                           bustub_instance->log_manager_);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  std::vector<int> values;
+  txn = bustub_instance->transaction_manager_->Begin();
+  for (int t = 0; t < NUM_CRASH_TABLES; t++) {
+    TableHeap table(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                    bustub_instance->log_manager_, first_page_ids[t]);
+    Tuple result;
+    EXPECT_TRUE(table.GetTuple(rids[t], &result, txn));
+    values.push_back(result.GetValue(&schema, 0).GetAs<int32_t>());
+  }
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+  // The recovered state is the one left by the transactions up to the last durable one, if any.
+  int durable_txns = -1;
+  for (int n = num_txns; n >= 0 && durable_txns < 0; n--) {
+    std::vector<int> expected(NUM_CRASH_TABLES);
+    for (int t = 0; t < NUM_CRASH_TABLES; t++) {
+      // The last of the first n crash transactions that updated table t, or the value the latency scenario left.
+      expected[t] = t < 2 ? num_txns - 1 : -1;
+      for (int i = 0; i < n; i++) {
+        if (i % NUM_CRASH_TABLES == t || (i + 7) % NUM_CRASH_TABLES == t) {
+          expected[t] = i;
+        }
+      }
+    }
+    if (expected == values) {
+      durable_txns = n;
+    }
+  }
+  EXPECT_LT(0, durable_txns);
+  EXPECT_GT(num_txns, durable_txns);
+  LOG_INFO("%d of %d asynchronous commits survived the crash", durable_txns, num_txns);
+
+  delete bustub_instance;
+  log_timeout = saved_log_timeout;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+}
+
+/** A leaf page entry of IndexRecoveryTest. */
+using IndexEntry = std::pair<int64_t, RID>;
+
+/** Log the insert (or the delete) of the entry with key at slot of a leaf page as part of txn. */
+void LogIndexEntry(BustubInstance *bustub_instance, Transaction *txn, LogRecordType type, page_id_t page_id, int slot,
+                   int64_t key) {
+  IndexEntry entry{key, RID(page_id, static_cast<uint32_t>(key))};
+  LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), type, page_id, slot,
+                       reinterpret_cast<const char *>(&entry), sizeof(IndexEntry));
+  bustub_instance->log_manager_->AppendLogRecord(&log_record, txn, page_id);
+}
+
+/** Add the header of a leaf page holding size entries to an INDEXSMO record. */
+void AddLeafHeader(LogRecord *log_record, page_id_t page_id, int size, page_id_t next_page_id) {
+  char header[LEAF_PAGE_HEADER_SIZE] = {};
+  auto *node = reinterpret_cast<BPlusTreePage *>(header);
+  node->SetPageType(IndexPageType::LEAF_PAGE);
+  node->SetSize(size);
+  node->SetMaxSize((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / sizeof(IndexEntry));
+  node->SetParentPageId(INVALID_PAGE_ID);
+  node->SetPageId(page_id);
+  memcpy(header + LEAF_PAGE_HEADER_SIZE - sizeof(page_id_t), &next_page_id, sizeof(page_id_t));
+  log_record->AddIndexPageWrite(page_id, 0, header, LEAF_PAGE_HEADER_SIZE);
+}
+
+/** @return the keys in the leaf page page_id */
+std::vector<int64_t> ReadLeafKeys(BustubInstance *bustub_instance, page_id_t page_id) {
+  Page *page = bustub_instance->buffer_pool_manager_->FetchPage(page_id);
+  auto *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+  EXPECT_TRUE(node->IsLeafPage());
+  EXPECT_EQ(page_id, node->GetPageId());
+  std::vector<int64_t> keys(node->GetSize());
+  for (size_t i = 0; i < keys.size(); i++) {
+    IndexEntry entry;
+    memcpy(static_cast<void *>(&entry), page->GetData() + LEAF_PAGE_HEADER_SIZE + i * sizeof(IndexEntry),
+           sizeof(IndexEntry));
+    EXPECT_EQ(RID(page_id, static_cast<uint32_t>(entry.first)).GetSlotNum(), entry.second.GetSlotNum());
+    keys[i] = entry.first;
+  }
+  bustub_instance->buffer_pool_manager_->UnpinPage(page_id, false);
+  return keys;
+}
+
+// NOLINTNEXTLINE
+TEST(RecoveryTest, IndexRecoveryTest) {
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  page_id_t leaf_id;
+  page_id_t sibling_id;
+  bustub_instance->buffer_pool_manager_->NewPage(&leaf_id);
+  bustub_instance->buffer_pool_manager_->NewPage(&sibling_id);
+  bustub_instance->buffer_pool_manager_->UnpinPage(leaf_id, false);
+  bustub_instance->buffer_pool_manager_->UnpinPage(sibling_id, false);
+
+  // Scenario: a committed transaction creates a leaf, inserts keys 1 to 6 and deletes key 3.
+  Transaction *txn = bustub_instance->transaction_manager_->Begin();
+  LogRecord create(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::INDEXSMO);
+  AddLeafHeader(&create, leaf_id, 0, INVALID_PAGE_ID);
+  bustub_instance->log_manager_->AppendSharedLogRecord(&create, txn);
+  for (int key = 1; key <= 6; key++) {
+    LogIndexEntry(bustub_instance, txn, LogRecordType::INDEXINSERT, leaf_id, key - 1, key);
+  }
+  LogIndexEntry(bustub_instance, txn, LogRecordType::INDEXDELETE, leaf_id, 2, 3);
+  bustub_instance->transaction_manager_->Commit(txn);
+  delete txn;
+
+  // Scenario: a split moves keys 4 to 6 to the sibling in one record, within a transaction that rolls back. The split
+  // stays, while the insert of key 7 and the delete of key 1 after it are undone.
+  Transaction *loser = bustub_instance->transaction_manager_->Begin();
+  LogRecord split(loser->GetTransactionId(), loser->GetPrevLSN(), LogRecordType::INDEXSMO);
+  std::vector<IndexEntry> moved;
+  for (int key : {4, 5, 6}) {
+    moved.emplace_back(key, RID(sibling_id, key));
+  }
+  AddLeafHeader(&split, sibling_id, moved.size(), INVALID_PAGE_ID);
+  split.AddIndexPageWrite(sibling_id, LEAF_PAGE_HEADER_SIZE, reinterpret_cast<const char *>(moved.data()),
+                          moved.size() * sizeof(IndexEntry));
+  AddLeafHeader(&split, leaf_id, 2, sibling_id);
+  bustub_instance->log_manager_->AppendSharedLogRecord(&split, loser);
+  LogIndexEntry(bustub_instance, loser, LogRecordType::INDEXINSERT, sibling_id, 3, 7);
+  LogIndexEntry(bustub_instance, loser, LogRecordType::INDEXDELETE, leaf_id, 0, 1);
+  bustub_instance->log_manager_->Flush(bustub_instance->log_manager_->PublishPrivateLog(loser));
+  delete loser;
+  delete bustub_instance;
+
+  // Redo rebuilds both leaves from the log alone: neither page ever reached the disk.
+  bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_,
+                           bustub_instance->log_manager_);
+  log_recovery.Redo();
+  EXPECT_EQ((std::vector<int64_t>{2}), ReadLeafKeys(bustub_instance, leaf_id));
+  EXPECT_EQ((std::vector<int64_t>{4, 5, 6, 7}), ReadLeafKeys(bustub_instance, sibling_id));
+  log_recovery.Undo();
+  EXPECT_EQ(2U, log_recovery.GetStats().undone_records_);
+  EXPECT_EQ((std::vector<int64_t>{1, 2}), ReadLeafKeys(bustub_instance, leaf_id));
+  EXPECT_EQ((std::vector<int64_t>{4, 5, 6}), ReadLeafKeys(bustub_instance, sibling_id));
+  Page *page = bustub_instance->buffer_pool_manager_->FetchPage(leaf_id);
+  page_id_t next_page_id;
+  memcpy(&next_page_id, page->GetData() + LEAF_PAGE_HEADER_SIZE - sizeof(page_id_t), sizeof(page_id_t));
+  EXPECT_EQ(sibling_id, next_page_id);
+  bustub_instance->buffer_pool_manager_->UnpinPage(leaf_id, false);
+
+  delete bustub_instance;
+  remove("test.db");
+  DiskManager::RemoveLog("test.db");
 }
 }  // namespace bustub
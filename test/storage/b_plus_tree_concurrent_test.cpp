@@ -142,7 +142,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest1) {
   delete disk_manager;
   delete bpm;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 
 TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest2) {
@@ -194,7 +194,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_InsertTest2) {
   delete disk_manager;
   delete bpm;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 
 TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest1) {
@@ -237,7 +237,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest1) {
   delete disk_manager;
   delete bpm;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 
 TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest2) {
@@ -281,7 +281,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_DeleteTest2) {
   delete disk_manager;
   delete bpm;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 
 TEST(BPlusTreeConcurrentTest, DISABLED_MixTest) {
@@ -327,7 +327,7 @@ TEST(BPlusTreeConcurrentTest, DISABLED_MixTest) {
   delete disk_manager;
   delete bpm;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 
 }  // namespace bustub
@@ -89,7 +89,7 @@ TEST(BPlusTreeTests, DISABLED_DeleteTest1) {
   delete disk_manager;
   delete bpm;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 
 TEST(BPlusTreeTests, DISABLED_DeleteTest2) {
@@ -168,6 +168,6 @@ TEST(BPlusTreeTests, DISABLED_DeleteTest2) {
   delete disk_manager;
   delete bpm;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 }  // namespace bustub
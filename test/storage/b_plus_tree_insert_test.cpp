@@ -68,7 +68,7 @@ TEST(BPlusTreeTests, DISABLED_InsertTest1) {
   delete disk_manager;
   delete bpm;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 
 TEST(BPlusTreeTests, DISABLED_InsertTest2) {
@@ -137,6 +137,6 @@ TEST(BPlusTreeTests, DISABLED_InsertTest2) {
   delete disk_manager;
   delete bpm;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 }  // namespace bustub
@@ -117,6 +117,6 @@ TEST(BptTreeTest, DISABLED_UnitTest) {
   delete transaction;
   delete disk_manager;
   remove("test.db");
-  remove("test.log");
+  DiskManager::RemoveLog("test.db");
 }
 }  // namespace bustub
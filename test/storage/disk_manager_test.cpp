@@ -10,7 +10,10 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
@@ -58,6 +61,80 @@ TEST(DiskManagerTest, ReadWriteLogTest) {
   remove(db_file.c_str());
 }
 
+TEST(DiskManagerTest, LogSegmentTest) {
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  auto dm = DiskManager(db_file);
+  // Three blocks fit in a segment. Block i starts at LSN 100 * i and is filled with i.
+  const int block_size = LOG_SEGMENT_SIZE / 4 + 1;
+  std::vector<char> blocks[2] = {std::vector<char>(block_size), std::vector<char>(block_size)};
+  auto write_block = [&](DiskManager *disk_manager, int i) {
+    // Consecutive log writes must come from different buffers.
+    std::fill(blocks[i % 2].begin(), blocks[i % 2].end(), static_cast<char>(i));
+    disk_manager->WriteLog(blocks[i % 2].data(), block_size, 100 * i);
+  };
+  auto read_block = [&](DiskManager *disk_manager, int i) {
+    char buf[1] = {0};
+    int offset = disk_manager->GetLogSegmentOffset(100 * i) + (i % 3) * block_size;
+    return disk_manager->ReadLog(buf, sizeof(buf), offset) ? buf[0] : -1;
+  };
+
+  // Scenario: blocks that do not fit start a new segment named by their first LSN.
+  for (int i = 0; i < 10; i++) {
+    write_block(&dm, i);
+  }
+  EXPECT_EQ(4U, dm.GetNumLogSegments());
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(i, read_block(&dm, i));
+    EXPECT_EQ(i / 3 * 300, dm.GetLogSegmentLSN(dm.GetLogSegmentOffset(100 * i)));
+  }
+  EXPECT_EQ(dm.GetLogSegmentOffset(300), dm.GetNextLogSegmentOffset(dm.GetLogSegmentOffset(0)));
+  EXPECT_EQ(-1, dm.GetNextLogSegmentOffset(dm.GetLogSegmentOffset(900)));
+
+  // Scenario: truncation recycles the segments before the LSN, and the offsets of the rest stay the same.
+  int offset = dm.GetLogSegmentOffset(600);
+  dm.TruncateLog(650);
+  EXPECT_EQ(2U, dm.GetNumLogSegments());
+  EXPECT_EQ(2U, dm.GetNumSpareLogSegments());
+  EXPECT_EQ(offset, dm.GetLogSegmentOffset(600));
+  EXPECT_EQ(offset, dm.GetLogSegmentOffset(0));
+  char buf[1];
+  EXPECT_FALSE(dm.ReadLog(buf, sizeof(buf), 0));
+  EXPECT_EQ(6, read_block(&dm, 6));
+
+  // Scenario: new segments reuse the spares, and the last segment is never truncated.
+  for (int i = 10; i < 13; i++) {
+    write_block(&dm, i);
+  }
+  EXPECT_EQ(3U, dm.GetNumLogSegments());
+  EXPECT_EQ(1U, dm.GetNumSpareLogSegments());
+  EXPECT_EQ(12, read_block(&dm, 12));
+  dm.TruncateLog(5000);
+  EXPECT_EQ(1U, dm.GetNumLogSegments());
+  EXPECT_EQ(2U, dm.GetNumSpareLogSegments());
+  dm.WriteMasterRecord(1200);
+  dm.ShutDown();
+
+  // Scenario: reopening the database finds the log, and the first write starts a new segment.
+  auto dm2 = DiskManager(db_file);
+  EXPECT_EQ(1U, dm2.GetNumLogSegments());
+  EXPECT_EQ(2U, dm2.GetNumSpareLogSegments());
+  EXPECT_EQ(1200, dm2.ReadMasterRecord());
+  EXPECT_EQ(12, read_block(&dm2, 12));
+  write_block(&dm2, 13);
+  EXPECT_EQ(2U, dm2.GetNumLogSegments());
+  dm2.ShutDown();
+
+  // Scenario: a new database with the same name drops the old log.
+  remove(db_file.c_str());
+  auto dm3 = DiskManager(db_file);
+  EXPECT_EQ(0U, dm3.GetNumLogSegments());
+  EXPECT_EQ(0U, dm3.GetNumSpareLogSegments());
+  EXPECT_EQ(INVALID_LSN, dm3.ReadMasterRecord());
+  dm3.ShutDown();
+  remove(db_file.c_str());
+}
+
 TEST(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 
 }  // namespace bustub